@@ -334,6 +334,26 @@
  *
  */
 
+/**
+ * \page 线程安全说明
+ * \brief 多线程程序使用驱动库的约定
+ *
+ * \section 卡片对象
+ * \brief 每个卡片对象拥有独立的通信连接，通信过程使用的缓存均在每次调用内分配。
+ * 不同卡片对象可在不同线程中同时调用接口函数，同一卡片对象同一时刻只能在一个线程中调用。
+ *
+ * \section 全局配置
+ * \brief 日志开关、日志路径等配置在第一次打开通信连接(card_open/ea_card_connect)时从配置文件读取，之后只读。
+ * 第一次打开通信连接没有加锁，多线程程序应先完成一次打开再并发调用，或使用扩展接口card_open_mt/ea_card_connect_mt。
+ *
+ * \section 错误码
+ * \brief 错误码通过函数返回值和卡片对象的last_err返回，不使用全局错误变量。
+ *
+ * \section 日志
+ * \brief 打开日志后多个线程同时写日志时，日志记录的时间可能不准确，不影响通信。
+ *
+ */
+
 /**
  * \file	pt_card.h
  * \brief	PT系列读写器接口函数
@@ -434,11 +454,19 @@
 /**\addtogroup 数据类型定义
  *  \{
  */
-/* 数据类型 */
-typedef unsigned char Uint8_t;		/**< 1字节无符号数据类型 */
-typedef unsigned short Uint16_t;	/**< 2字节无符号数据类型 */
-typedef unsigned long Uint32_t;		/**< 4字节无符号数据类型 */
-typedef long Int32_t;				/**< 4字节有符号数据类型 */
+/* 数据类型 固定长度，保证64位平台(LP64)结构体布局与32位平台相同 */
+#if defined(_MSC_VER) && _MSC_VER < 1600
+typedef unsigned __int8 Uint8_t;	/**< 1字节无符号数据类型 */
+typedef unsigned __int16 Uint16_t;	/**< 2字节无符号数据类型 */
+typedef unsigned __int32 Uint32_t;	/**< 4字节无符号数据类型 */
+typedef __int32 Int32_t;			/**< 4字节有符号数据类型 */
+#else
+#include <stdint.h>
+typedef uint8_t Uint8_t;			/**< 1字节无符号数据类型 */
+typedef uint16_t Uint16_t;			/**< 2字节无符号数据类型 */
+typedef uint32_t Uint32_t;			/**< 4字节无符号数据类型 */
+typedef int32_t Int32_t;			/**< 4字节有符号数据类型 */
+#endif
 typedef Uint16_t card_err_t;		/**< 错误码数据类型 */
 /**
  *  \}
@@ -897,7 +925,7 @@ card_err_t card_mifare_read(card_obj_t *obj, Uint8_t block_no, Uint8_t *rbuf);
  * \param[in]	tbuf 块数据，长度16字节
  * \retval		CARD_NO_ERR 成功
  */
-card_err_t card_mifare_read(card_obj_t *obj, Uint8_t block_no, Uint8_t *tbuf);
+card_err_t card_mifare_write(card_obj_t *obj, Uint8_t block_no, Uint8_t *tbuf);
 /* 非接触读写器配置 */
 /**
  * \brief		非接触读写器配置设置
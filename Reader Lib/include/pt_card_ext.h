@@ -0,0 +1,1849 @@
+/**
+ * \page 扩展接口说明
+ * \brief 主机端扩展接口函数使用说明
+ *
+ * \section 扩展接口概述
+ * \brief 扩展接口基于驱动库已导出的接口函数实现，源文件位于src目录，使用时与驱动库一同编译链接。
+ * 扩展接口的状态均保存在调用者传入的对象或上下文中，不同对象可在不同线程中同时使用。
+ *
+ * \par 使用扩展接口必须包含以下头文件:
+ * \code
+ * #include "pt_card_ext.h"
+ * \endcode
+ *
+ * \section 扩展接口编译
+ * \brief 使用CMake编译，生成扩展接口动态库、静态库和工具程序。驱动库按目标平台从lib目录自动选择，也可通过PT_CARD_LIBRARY指定。
+ * \code
+ *  cmake -S . -B build
+ *  cmake --build build
+ *  根据编译环境自行替换“[]”内容，交叉编译aarch64等平台:
+ *  cmake -S . -B build-aarch64 -DCMAKE_TOOLCHAIN_FILE=[工具链文件] -DPT_CARD_LIBRARY=[对应平台libpt_card.so路径]
+ * \endcode
+ * \note 数据类型为固定长度，配置结构体在32位和64位平台布局相同。\n
+ * 测试程序(PT_CARD_BUILD_TESTS，ctest运行)和pt_card_bench需要链接驱动库，lib目录没有目标平台的驱动库且未指定
+ * PT_CARD_LIBRARY时不编译，CMake输出警告。
+ *
+ * \section 读写器模拟器
+ * \brief card_sim_create在本机模拟读写器通信协议，无需读写器即可运行和测试主机程序，也可使用tools/pt_reader_sim独立运行。
+ * \code
+ *  card_sim_t *sim;
+ *  card_obj_t obj;
+ *
+ *  card_sim_create(&sim, (Uint8_t *)"127.0.0.1", NULL);
+ *  card_sim_insert(sim, CARD_SIM_7816_T0);
+ *  card_open(&obj, MODEL_P7816, (Uint8_t *)"127.0.0.1");
+ *  card_reset(&obj);
+ * \endcode
+ *
+ * -------------------------------------------------------------------------
+ *    卡片类型         |        说明
+ * --------------------|----------------------------------------------------
+ *	  CARD_SIM_7816_T0  |	接触卡，数据命令返回61XX，GET RESPONSE取数据，GET CHALLENGE(Le=8)的Le错误时返回6CXX
+ *	  CARD_SIM_7816_T1  |	接触卡，直接返回数据
+ *	  CARD_SIM_MIFARE   |	MIFARE Classic 1K，验证后读写，不检查存取控制位
+ *	  CARD_SIM_14443_4  |	非接触CPU卡，RATS后交换APDU
+ *	  CARD_SIM_I2C_EEPROM |	设备地址0x50，2字节地址，页32字节，写周期5毫秒内访问返回0x1038
+ *	  CARD_SIM_SPI_FLASH |	JEDEC ID EF4014，页256字节，支持03/0B/02/20/D8/C7/05/06/04/9F命令
+ *	  CARD_SIM_15693    |	ISO15693标签，64块每块4字节，支持INVENTORY、STAY QUIET、RESET TO READY和单块/多块读写，关闭载波后退出静默
+ *
+ * 除GET RESPONSE、SELECT(A4)和GET CHALLENGE(84)外，APDU卡片回显命令数据并返回9000，只有Le时返回Le字节的递增数据。\n
+ * 注入错误时，非接触命令返回0x2001并使卡片回到未激活状态，接触命令返回0x1009，I2C和SPI命令返回0x1008。
+ *
+ * \section 扩展接口错误码
+ *
+ * -------------------------------------
+ *    错误码     |        说明
+ * --------------|-----------------------
+ *	  0x3014	 |		状态字不符合预期
+ *	  0x3015	 |		命令未执行
+ *	  0x3016	 |		请求队列已满
+ *	  0x3017	 |		连接池已满
+ *	  0x3018	 |		应答数据超过缓存大小
+ *	  0x3019	 |		交换次数超过上限
+ *	  0x301A	 |		等待超时
+ *	  0x301B	 |		回读数据不一致
+ *	  0x301C	 |		SWD粘滞错误
+ *	  0x301D	 |		SWD DPIDR无效
+ *
+ */
+
+/**
+ * \file	pt_card_ext.h
+ * \brief	PT系列读写器扩展接口函数
+ * \details	扩展接口为主机端实现，依赖pt_card.h中的接口函数
+ */
+#ifndef _PT_CARD_EXT_H_
+#define _PT_CARD_EXT_H_
+
+#include "pt_card.h"
+
+/**\addtogroup 扩展宏定义
+ *  \{
+ */
+/* 扩展接口错误编码 */
+#define CARD_ERR_SW_UNEXPECTED	0x3014	/**< 状态字不符合预期 */
+#define CARD_ERR_NOT_EXECUTED	0x3015	/**< 命令未执行 */
+#define CARD_ERR_QUEUE_FULL		0x3016	/**< 请求队列已满 */
+#define CARD_ERR_POOL_FULL		0x3017	/**< 连接池已满 */
+#define CARD_ERR_BUF_SMALL		0x3018	/**< 应答数据超过缓存大小 */
+#define CARD_ERR_XCHG_LIMIT		0x3019	/**< 交换次数超过上限 */
+#define CARD_ERR_TIMEOUT		0x301A	/**< 等待超时 */
+#define CARD_ERR_VERIFY			0x301B	/**< 回读数据不一致 */
+#define CARD_ERR_SWD_STICKY		0x301C	/**< SWD粘滞错误 */
+#define CARD_ERR_SWD_DPIDR		0x301D	/**< SWD DPIDR无效 */
+
+/* 批量APDU标志 */
+#define CARD_BATCH_FLAG_NONE		0x00U	/**< 默认，状态字不符合预期时停止 */
+#define CARD_BATCH_FLAG_IGNORE_SW	0x01U	/**< 不检查状态字，全部执行 */
+#define CARD_BATCH_FLAG_CONTINUE	0x02U	/**< 出错后继续执行，通信错误(0x4XXX)除外 */
+/* 单条APDU最大应答长度，与card_pipe应答长度类型一致 */
+#define CARD_APDU_RESP_MAX		0xFFFF	/**< 单条APDU最大应答长度 */
+/* READ BINARY单条命令最大读取长度，扩展长度Le，应答数据与SW不超过CARD_APDU_RESP_MAX */
+#define CARD_READ_CHUNK_MAX		0xFFFD	/**< READ BINARY单条命令最大读取长度 */
+/* 应答拼接记录耗时的交换次数 */
+#define CARD_XCHG_TIME_MAX		16		/**< 应答拼接记录耗时的交换次数 */
+/* 跟踪文件格式，数值均为小端
+ * 文件头: 标识(4) 版本(2) 保留(2)
+ * 记录:   系统时间微秒(8) 句柄(4) IP地址(16) 命令(1) 方向(1) 错误码(2) 数据原长度(2) 数据保存长度(2) 数据
+ */
+#define CARD_TRACE_MAGIC		0x52545450	/**< 跟踪文件标识"PTTR" */
+#define CARD_TRACE_VERSION		0x0001		/**< 跟踪文件版本 */
+#define CARD_TRACE_FILE_HEAD	8			/**< 跟踪文件头长度 */
+#define CARD_TRACE_RECORD_HEAD	36			/**< 跟踪记录头长度 */
+#define CARD_TRACE_DATA_MAX		272			/**< 单条记录保存的最大数据长度，超出部分截断 */
+#define CARD_TRACE_DIR_TX		0x01U		/**< 主机发送 */
+#define CARD_TRACE_DIR_RX		0x02U		/**< 主机接收 */
+/* 异步请求队列默认深度 */
+#define CARD_ASYNC_DEFAULT_DEPTH	64		/**< 异步请求队列默认深度 */
+/* 多读写器调度 */
+#define CARD_STATION_MAX_READERS	64		/**< 调度器最大读写器个数 */
+#define CARD_STATION_ANY			0xFFFF	/**< 不指定读写器，由调度器选择 */
+#define CARD_STATION_RETRY_MIN		500		/**< 读写器重连最小间隔 单位毫秒 */
+#define CARD_STATION_RETRY_MAX		30000	/**< 读写器重连最大间隔 单位毫秒 */
+#define CARD_READER_CONNECTING		0x00U	/**< 正在连接 */
+#define CARD_READER_ONLINE			0x01U	/**< 在线 */
+#define CARD_READER_OFFLINE			0x02U	/**< 连接失败，等待重连 */
+/* 脚本下载 */
+#define CARD_DEPLOY_PRE			0x01U	/**< 内部解析脚本库，ea_card_addpre */
+#define CARD_DEPLOY_SCRIPT		0x02U	/**< 内部写卡脚本文件，ea_card_addscript */
+#define CARD_DEPLOY_FLAG_FORCE	0x01U	/**< 读写器中已存在时仍重新下载 */
+#define CARD_DEPLOY_FLAG_PRUNE	0x02U	/**< 下载后删除同一名称的其他版本 */
+#define CARD_DEPLOY_HASH_LEN	16		/**< 保存名称中MD5值的十六进制位数 */
+#define CARD_DEPLOY_NAME_MAX	64		/**< 保存名称最大长度，含结束符 */
+#define CARD_DEPLOY_LIST_SIZE	1024	/**< 列出文件名称的初始缓存大小 */
+/* 非接触卡片盘点 */
+#define CARD_INV_FLAG_RATS		0x01U	/**< ISO14443A卡片支持ISO14443-4时读取ATS */
+#define CARD_INV_MAX_TAGS		16		/**< 轮询盘点每次最多记录的卡片个数 */
+#define CARD_TAG_UID_MAX		10		/**< 卡片标识符最大长度 */
+#define CARD_TAG_INFO_MAX		32		/**< 卡片附加信息最大长度 */
+#define CARD_TAG_ARRIVED		0x01U	/**< 卡片进入场区 */
+#define CARD_TAG_DEPARTED		0x02U	/**< 卡片离开场区 */
+/* MIFARE Classic批量读写 */
+#define CARD_MIFARE_SECTORS_MAX		40		/**< 最大扇区个数(4K卡) */
+#define CARD_MIFARE_FLAG_TRAILER	0x10U	/**< 写入扇区尾块(密钥和存取控制位) */
+#define CARD_MIFARE_FLAG_BLOCK0		0x20U	/**< 写入厂商块，仅用于可改写UID的卡片 */
+/* ISO15693和FeliCa批量读写 */
+#define CARD_15693_BLOCK_MAX		32		/**< ISO15693最大块长度 */
+#define CARD_15693_READ_BLOCKS		32		/**< 默认每条READ MULTIPLE BLOCKS命令的块数 */
+#define CARD_15693_WRITE_BLOCKS		4		/**< 默认每条WRITE MULTIPLE BLOCKS命令的块数 */
+#define CARD_FELICA_SERVICES_MAX	16		/**< 每条命令最大服务个数 */
+#define CARD_FELICA_BLOCKS_MAX		15		/**< 每条命令最大块个数 */
+#define CARD_FELICA_READ_BLOCKS		4		/**< 默认每条Read Without Encryption命令的块数 */
+#define CARD_FELICA_WRITE_BLOCKS	1		/**< 默认每条Write Without Encryption命令的块数 */
+/* 会话配置模板 */
+#define CARD_PROFILE_MODEL		0x01U	/**< 设置卡片协议 card_setmodel */
+#define CARD_PROFILE_VCC		0x02U	/**< 设置卡片电压 card_setvcc */
+#define CARD_PROFILE_FREQ		0x04U	/**< 设置读写器频率 card_setfreq */
+#define CARD_PROFILE_CFG		0x08U	/**< 设置接触读写器配置 card_cfg */
+#define CARD_PROFILE_PCFG		0x10U	/**< 设置非接触读写器配置 card_pcfg */
+#define CARD_PROFILE_PPS		0x20U	/**< 复位后PPS card_pps */
+#define CARD_PROFILE_ETU		0x40U	/**< 复位后设置ETU card_etu */
+#define CARD_PROFILE_NAME_MAX	32		/**< 模板名称最大长度，含结束符 */
+#define CARD_PROFILE_SIZE		141		/**< 模板序列化后的长度 */
+/* PPS自动选择 */
+#define CARD_PPS_CACHE_MAX		64		/**< 结果缓存最大ATR个数，满时替换最久未使用的 */
+#define CARD_PPS_FREQS_MAX		8		/**< 候选时钟频率最大个数 */
+#define CARD_PPS_EXPECT_MAX		256		/**< 校验APDU期望应答数据最大长度 */
+/* I2C EEPROM批量读写 */
+#define CARD_I2C_FLAG_VERIFY	0x01U	/**< 写入后回读比较 */
+#define CARD_I2C_POLL_TIMEOUT	3000	/**< 默认ACK轮询超时 单位毫秒 */
+#define CARD_I2C_READ_CHUNK		256		/**< 默认每条命令读取长度 */
+/* SPI Flash批量读写 */
+#define CARD_SPI_FLAG_ERASE		0x01U	/**< 编程前擦除覆盖的扇区 */
+#define CARD_SPI_FLAG_VERIFY	0x02U	/**< 编程后回读比较 */
+#define CARD_SPI_PAGE_SIZE		256		/**< 页长度 */
+#define CARD_SPI_SECTOR_SIZE	4096	/**< 最小擦除扇区长度 */
+#define CARD_SPI_READ_CHUNK		32768	/**< 每条快速读命令读取长度 */
+#define CARD_SPI_FREQ_MAX		20000000	/**< SPI_PARAM_FREQ最大值 单位Hz */
+#define CARD_SPI_PROGRAM_TIMEOUT	100		/**< 页编程超时 单位毫秒 */
+#define CARD_SPI_ERASE_TIMEOUT	3000	/**< 扇区或块擦除超时 单位毫秒 */
+/* SWD MEM-AP批量读写 */
+#define CARD_SWD_DP_REG(a)		((Uint8_t)((a) & 0x0C))			/**< card_swd_dap_read/write的DP寄存器地址 */
+#define CARD_SWD_AP_REG(a)		((Uint8_t)(((a) & 0x0C) | 0x01))	/**< card_swd_dap_read/write的AP寄存器地址(APnDP=1) */
+#define CARD_SWD_FLAG_VERIFY	0x01U	/**< 写入后回读比较 */
+#define CARD_SWD_RETRIES		1		/**< 粘滞错误后每段重试次数 */
+/* 错误分类 */
+#define CARD_ERR_CLASS_NONE		0		/**< 成功 */
+#define CARD_ERR_CLASS_RF		1		/**< 非接触瞬时错误(无应答、CRC、碰撞、NAK等)，重新唤醒后可恢复 */
+#define CARD_ERR_CLASS_CARD		2		/**< 接触瞬时错误(超时、奇偶校验、LRC/CRC等)，重新复位后可恢复 */
+#define CARD_ERR_CLASS_LINK		3		/**< 读写器通信错误(0x4XXX)，重新连接后可恢复 */
+#define CARD_ERR_CLASS_FATAL	4		/**< 不可恢复错误，不重试 */
+/* 错误重试和恢复 */
+#define CARD_RETRY_FLAG_REACTIVATE	0x01U	/**< 非接触错误后重新唤醒和选择卡片 */
+#define CARD_RETRY_FLAG_RESET	0x04U	/**< 接触错误后重新复位卡片，卡片状态丢失 */
+#define CARD_RETRY_FLAG_RECONNECT	0x08U	/**< 通信错误后关闭并重新打开读写器 */
+#define CARD_RETRY_FLAG_REPLAY	0x10U	/**< 恢复后重新执行操作，只能用于幂等操作 */
+/* 通信统计 */
+#define CARD_METRICS_BUCKETS	26		/**< 耗时直方图个数，第i个为不大于2^i微秒，最后一个为超过2^24微秒 */
+#define CARD_METRICS_ERR_GROUPS	5		/**< 错误代码分组个数，第n个为0xnXXX，第0个为其他 */
+#define CARD_METRICS_FMT_PROM	0		/**< Prometheus文本格式 */
+#define CARD_METRICS_FMT_JSON	1		/**< JSON格式 */
+/* 卡片插拔监视 */
+#define CARD_WATCH_MAX			256		/**< 监视器最大卡片对象个数 */
+#define CARD_WATCH_QUEUE		256		/**< 事件队列长度，满时丢弃最早的事件 */
+#define CARD_WATCH_DEFAULT_INTERVAL	100	/**< 默认探测间隔 单位毫秒 */
+#define CARD_WATCH_PROBE_TIMEOUT	500	/**< 每次探测的通信超时 单位毫秒 */
+#define CARD_WATCH_INSERT		0x01U	/**< 卡片插入或进入场区 */
+#define CARD_WATCH_REMOVE		0x02U	/**< 卡片拔出或离开场区 */
+#define CARD_WATCH_ERROR		0x03U	/**< 通信错误 */
+/* 读写器模拟器 */
+#define CARD_SIM_PORT			5600	/**< 驱动库连接读写器使用的端口 */
+#define CARD_SIM_MAX_CONNS		16		/**< 模拟器最大连接个数 */
+/**
+ *  \}
+ */
+
+/**\addtogroup 扩展数据类型定义
+ *  \{
+ */
+/* 命令编号 */
+/** 命令编号，用于跟踪记录和统计 */
+typedef enum card_cmd_id {
+	CARD_CMD_OTHER = 0x00,			/**< 其他命令 */
+	CARD_CMD_PIPE = 0x01,			/**< card_pipe */
+	CARD_CMD_RESET = 0x02,			/**< card_reset */
+	CARD_CMD_WARM_RESET = 0x03,		/**< card_warm_reset */
+	CARD_CMD_OFF = 0x04,			/**< card_off */
+	CARD_CMD_REQA = 0x05,			/**< card_reqa */
+	CARD_CMD_WUPA = 0x06,			/**< card_wupa */
+	CARD_CMD_ANTICOL = 0x07,		/**< card_anticol */
+	CARD_CMD_SELECT = 0x08,			/**< card_select */
+	CARD_CMD_RATS = 0x09,			/**< card_rats */
+	CARD_CMD_MIFARE_READ = 0x0A,	/**< card_mifare_read */
+	CARD_CMD_MIFARE_WRITE = 0x0B,	/**< card_mifare_write */
+	CARD_CMD_I2C_WRITE_READ = 0x0C,	/**< card_i2c_write_read */
+	CARD_CMD_SPI_WRITE_READ = 0x0D,	/**< card_spi_write_read */
+	CARD_CMD_SWD_DAP_READ = 0x0E,	/**< card_swd_dap_read */
+	CARD_CMD_SWD_DAP_WRITE = 0x0F,	/**< card_swd_dap_write */
+	CARD_CMD_RUNPRE = 0x10,			/**< ea_card_runpre */
+	CARD_CMD_MAX,					/**< 命令编号个数 */
+} card_cmd_t;
+
+/* 批量APDU命令 */
+/** 批量APDU命令 */
+typedef struct card_apdu {
+	Uint8_t *tbuf;				/**< 发送APDU数据 */
+	Uint16_t tlen;				/**< 发送APDU长度 */
+	Uint16_t sw_expect;			/**< 期望状态字 SW1<<8|SW2 */
+	Uint16_t sw_mask;			/**< 状态字比较掩码 0:不检查状态字 */
+} card_apdu_t;
+
+/* 批量APDU执行结果 */
+/** 批量APDU执行结果 */
+typedef struct card_apdu_result {
+	Uint8_t *rbuf;				/**< 应答数据缓存(含SW1 SW2)，可为NULL */
+	Uint16_t rsize;				/**< 应答数据缓存大小 */
+	Uint16_t rlen;				/**< 卡片实际应答长度 */
+	Uint8_t sw1;				/**< 卡片返回值SW1 */
+	Uint8_t sw2;				/**< 卡片返回值SW2 */
+	card_err_t err;				/**< 执行结果 */
+	Uint32_t time_us;			/**< 执行耗时 单位微秒 */
+} card_apdu_res_t;
+
+/* 内部写卡记录 */
+/** 内部写卡记录，每张卡片一条 */
+typedef struct card_runpre_record {
+	Uint8_t *user_data;			/**< 用户数据 */
+	Uint32_t user_data_len;		/**< 用户数据长度 */
+	Uint8_t *output_info;		/**< 输出信息缓存 */
+	Uint32_t output_size;		/**< 输出信息缓存大小 */
+	Uint32_t output_len;		/**< 实际输出信息长度 */
+	card_err_t err;				/**< 执行结果 */
+	Uint32_t time_us;			/**< 执行耗时 单位微秒 */
+} card_runpre_rec_t;
+/** 内部写卡记录完成回调函数，index为记录在数组中的序号 */
+typedef void (*card_runpre_cb_t)(void *arg, Uint16_t index, const card_runpre_rec_t *rec);
+
+/* 分散缓存 */
+/** 分散缓存，应答数据按数组顺序依次写入 */
+typedef struct card_iov {
+	Uint8_t *buf;				/**< 缓存 */
+	Uint32_t len;				/**< 缓存大小 */
+} card_iov_t;
+/* 应答拼接统计 */
+/** 应答拼接统计 */
+typedef struct card_xchg_stat {
+	Uint16_t count;				/**< 与卡片交换次数，含第一条命令 */
+	Uint16_t resp;				/**< 61XX后GET RESPONSE次数 */
+	Uint16_t rele;				/**< 6CXX后重发次数 */
+	Uint32_t total_us;			/**< 总耗时 单位微秒 */
+	Uint32_t time_us[CARD_XCHG_TIME_MAX];	/**< 前CARD_XCHG_TIME_MAX次交换各自耗时 单位微秒 */
+} card_xchg_stat_t;
+/** 分段接收回调函数，offset和len为本段数据在分散缓存中的位置 */
+typedef void (*card_stream_cb_t)(void *arg, Uint32_t offset, Uint32_t len);
+
+/* 异步上下文，内部结构 */
+typedef struct card_async card_async_t;	/**< 异步上下文 */
+typedef Uint32_t card_req_t;			/**< 异步请求句柄 */
+/** 异步请求完成回调函数 */
+typedef void (*card_async_cb_t)(card_async_t *ctx, card_req_t req, card_err_t err, void *arg);
+/** 异步执行的自定义函数 */
+typedef card_err_t (*card_async_fn_t)(card_obj_t *obj, void *arg);
+
+/* 异步请求完成信息 */
+/** 异步请求完成信息 */
+typedef struct card_async_done {
+	card_req_t req;				/**< 请求句柄 */
+	card_err_t err;				/**< 执行结果 */
+	Uint32_t time_us;			/**< 执行耗时 单位微秒 */
+	void *arg;					/**< 提交时传入的用户参数 */
+} card_async_done_t;
+
+/* 通信跟踪，内部结构 */
+typedef struct card_trace card_trace_t;	/**< 通信跟踪 */
+
+/* 连接池，内部结构 */
+typedef struct card_pool card_pool_t;	/**< 连接池 */
+
+/* 多读写器调度器，内部结构 */
+typedef struct card_station card_station_t;	/**< 多读写器调度器 */
+/** 任务完成回调函数，reader为执行任务的读写器编号 */
+typedef void (*card_station_cb_t)(card_station_t *st, card_req_t job, Uint16_t reader, card_err_t err, void *arg);
+
+/* 读写器统计 */
+/** 读写器统计 */
+typedef struct card_reader_stat {
+	Uint8_t state;				/**< 连接状态 CARD_READER_XXX */
+	Uint16_t queued;			/**< 队列中的任务个数 */
+	Uint32_t done;				/**< 已执行任务个数 */
+	Uint32_t errors;			/**< 出错任务个数 */
+	Uint32_t stolen;			/**< 从其他读写器队列取得的任务个数 */
+	Uint32_t reconnects;		/**< 重连成功次数 */
+	Uint32_t busy_ms;			/**< 执行任务累计耗时 单位毫秒 */
+	card_err_t last_err;		/**< 最后的错误 */
+} card_reader_stat_t;
+
+/* 脚本下载文件 */
+/** 脚本下载文件 */
+typedef struct card_deploy {
+	Uint8_t type;				/**< 文件类型 CARD_DEPLOY_PRE或CARD_DEPLOY_SCRIPT */
+	Uint8_t flags;				/**< 下载标志 CARD_DEPLOY_FLAG_XXX */
+	Uint8_t *path;				/**< 本地文件路径，NULL时使用buf */
+	Uint8_t *name;				/**< 保存名称，实际保存时在扩展名前附加MD5值 */
+	const Uint8_t *buf;			/**< 文件内容，path为NULL时使用，可为mmap映射区域 */
+	Uint32_t len;				/**< 文件内容长度 */
+} card_deploy_t;
+
+/* 脚本下载结果 */
+/** 脚本下载结果 */
+typedef struct card_deploy_result {
+	Uint8_t md5[16];			/**< 文件MD5值 */
+	Uint8_t stored_name[CARD_DEPLOY_NAME_MAX];	/**< 读写器中的保存名称，用于ea_card_initpre */
+	Uint8_t uploaded;			/**< 1:已传输文件 0:读写器中已存在 */
+	card_err_t err;				/**< 执行结果 */
+	Uint32_t time_us;			/**< 执行耗时 单位微秒 */
+} card_deploy_res_t;
+
+/* 盘点卡片信息 */
+/** 盘点卡片信息 */
+typedef struct card_tag {
+	card_mod_t model;			/**< 卡片模式 */
+	Uint8_t uid[CARD_TAG_UID_MAX];	/**< ISO14443A: UID ISO14443B: PUPI ISO15693: UID(低字节在前) */
+	Uint8_t uid_len;			/**< 标识符长度 */
+	Uint16_t atqa;				/**< ISO14443A请求应答 */
+	Uint8_t sak;				/**< ISO14443A选择确认 */
+	Uint8_t info[CARD_TAG_INFO_MAX];	/**< ISO14443A: ATS ISO14443B: ATQB ISO15693: DSFID */
+	Uint8_t info_len;			/**< 附加信息长度 */
+} card_tag_t;
+/** 卡片进入或离开场区回调函数，返回非0时停止轮询 */
+typedef int (*card_tag_cb_t)(void *arg, Uint8_t event, const card_tag_t *tag);
+
+/* MIFARE扇区密钥 */
+/** MIFARE扇区密钥 */
+typedef struct card_mifare_key {
+	Uint8_t type;				/**< 密钥类型 CARD_MIFARE_KEYA或CARD_MIFARE_KEYB */
+	Uint8_t key[6];				/**< 密钥 */
+} card_mifare_key_t;
+
+/* FeliCa块列表元素 */
+/** FeliCa块列表元素 */
+typedef struct card_felica_block {
+	Uint8_t service;			/**< 服务代码表中的序号 */
+	Uint16_t block;				/**< 块号 */
+} card_felica_block_t;
+
+/* 会话配置模板 */
+/** 会话配置模板 */
+typedef struct card_profile {
+	char name[CARD_PROFILE_NAME_MAX];	/**< 模板名称 */
+	Uint32_t fields;			/**< 包括的项目 CARD_PROFILE_XXX组合 */
+	card_mod_t model;			/**< 卡片协议 */
+	Uint16_t vcc;				/**< 卡片电压 单位mV */
+	Uint16_t freq;				/**< 读写器频率 单位KHz */
+	card_cfg_t cfg;				/**< 接触读写器配置，mask指定更新的参数 */
+	card_pcfg_t pcfg;			/**< 非接触读写器配置，mask指定更新的参数 */
+	Uint8_t pps0;				/**< card_pps参数1 */
+	Uint8_t pps1;				/**< card_pps参数2 */
+	Uint16_t etu;				/**< 卡片时钟周期 */
+} card_profile_t;
+
+/* PPS自动选择参数 */
+/** PPS自动选择参数 */
+typedef struct card_pps_tune {
+	card_apdu_t echo;			/**< 校验APDU，状态字按sw_expect和sw_mask检查 */
+	const Uint8_t *expect;		/**< 校验APDU期望应答数据(不含SW)，NULL为不比较 */
+	Uint16_t expect_len;		/**< 期望应答数据长度 */
+	Uint8_t rounds;				/**< 每个速率的校验次数，0为1次 */
+	const Uint16_t *freqs;		/**< 候选时钟频率 单位KHz，NULL为只使用当前频率 */
+	Uint8_t freqs_n;			/**< 候选时钟频率个数 */
+} card_pps_tune_t;
+
+/* PPS自动选择结果 */
+/** PPS自动选择结果 */
+typedef struct card_pps_result {
+	Uint8_t pps0;				/**< card_pps参数1，0为未进行PPS */
+	Uint8_t pps1;				/**< card_pps参数2 (Fi<<4|Di) */
+	Uint16_t freq;				/**< 时钟频率 单位KHz */
+	Uint32_t baud;				/**< 通信速率 单位bit/s */
+	Uint8_t cached;				/**< 1为使用缓存中的结果 */
+} card_pps_result_t;
+
+/* PPS结果缓存，内部结构 */
+typedef struct card_pps_cache card_pps_cache_t;	/**< PPS结果缓存 */
+
+/* I2C EEPROM读写参数 */
+/** I2C EEPROM读写参数 */
+typedef struct card_i2c_prog {
+	Uint16_t dev;				/**< 设备地址，如0x50 */
+	Uint8_t addr_bytes;			/**< 存储地址字节数，1字节地址时高3位地址放在设备地址低3位 */
+	Uint16_t page_size;			/**< 页长度，2的幂，读取时不使用 */
+	Uint32_t addr;				/**< 起始存储地址 */
+	Uint32_t poll_timeout_ms;	/**< 写周期ACK轮询超时，0为CARD_I2C_POLL_TIMEOUT */
+	Uint16_t read_chunk;		/**< 每条命令读取长度，0为CARD_I2C_READ_CHUNK */
+	Uint8_t flags;				/**< CARD_I2C_FLAG_XXX组合 */
+} card_i2c_prog_t;
+
+/* SPI Flash器件信息 */
+/** SPI Flash器件信息 */
+typedef struct card_spi_flash {
+	Uint8_t jedec[3];			/**< JEDEC ID 厂商、类型、容量 */
+	Uint32_t size;				/**< 容量 单位字节 */
+	Uint16_t page_size;			/**< 页长度，2的幂 */
+	Uint32_t sector_size;		/**< 最小擦除扇区长度，2的幂 */
+} card_spi_flash_t;
+
+/* 错误重试策略 */
+/** 错误重试策略，各类错误的重试次数相互独立 */
+typedef struct card_retry_policy {
+	Uint8_t rf_retries;			/**< CARD_ERR_CLASS_RF最大重试次数 */
+	Uint8_t card_retries;		/**< CARD_ERR_CLASS_CARD最大重试次数 */
+	Uint8_t link_retries;		/**< CARD_ERR_CLASS_LINK最大重试次数 */
+	Uint32_t backoff_ms;		/**< 第一次重试前等待时间，之后每次加倍，0为不等待 单位毫秒 */
+	Uint32_t backoff_max_ms;	/**< 最大等待时间，0为不限制 单位毫秒 */
+	Uint8_t flags;				/**< CARD_RETRY_FLAG_XXX组合 */
+} card_retry_policy_t;
+
+/* 错误重试策略对象，内部结构 */
+typedef struct card_retry card_retry_t;	/**< 错误重试策略对象 */
+
+/* 错误重试统计 */
+/** 错误重试统计 */
+typedef struct card_retry_stat {
+	Uint32_t calls;				/**< 调用次数 */
+	Uint32_t rf_retries;		/**< 非接触错误重试次数 */
+	Uint32_t card_retries;		/**< 接触错误重试次数 */
+	Uint32_t link_retries;		/**< 通信错误重试次数 */
+	Uint32_t reactivations;		/**< 重新唤醒次数 */
+	Uint32_t resets;			/**< 重新复位次数 */
+	Uint32_t reconnects;		/**< 重新连接成功次数 */
+	Uint32_t recovered;			/**< 重试后成功的调用次数 */
+	Uint32_t failed;			/**< 最终失败的调用次数 */
+} card_retry_stat_t;
+
+/* 通信统计，内部结构 */
+typedef struct card_metrics card_metrics_t;	/**< 通信统计 */
+
+/* 命令统计 */
+/** 命令统计 */
+typedef struct card_cmd_stat {
+	unsigned long long count;	/**< 执行次数 */
+	unsigned long long errors;	/**< 出错次数 */
+	unsigned long long total_ms;	/**< 累计耗时 单位毫秒 */
+	Uint32_t max_us;			/**< 最大耗时 单位微秒 */
+	unsigned long long buckets[CARD_METRICS_BUCKETS];	/**< 耗时直方图，非累计 */
+} card_cmd_stat_t;
+
+/* 卡片对象统计 */
+/** 卡片对象统计 */
+typedef struct card_stats {
+	Int32_t handle;				/**< 最后一次重连后的句柄 */
+	card_mod_t model;			/**< 卡片对象类型 */
+	Uint8_t addr[MAX_ADDR_SIZE];	/**< 读写器地址 */
+	unsigned long long tx_bytes;	/**< 发送字节数 */
+	unsigned long long rx_bytes;	/**< 接收字节数 */
+	unsigned long long reconnects;	/**< 重连次数 */
+	unsigned long long err_groups[CARD_METRICS_ERR_GROUPS];	/**< 按错误代码最高位分组的错误次数 */
+	card_cmd_stat_t cmds[CARD_CMD_MAX];	/**< 按命令编号CARD_CMD_XXX的统计 */
+} card_stats_t;
+
+/* 卡片插拔监视器，内部结构 */
+typedef struct card_watch card_watch_t;	/**< 卡片插拔监视器 */
+
+/* 卡片插拔事件 */
+/** 卡片插拔事件 */
+typedef struct card_watch_event {
+	Uint16_t id;				/**< card_watch_add返回的编号 */
+	card_obj_t *obj;			/**< 卡片对象 */
+	void *arg;					/**< card_watch_add传入的用户参数 */
+	Uint8_t event;				/**< 事件 CARD_WATCH_XXX */
+	card_err_t err;				/**< CARD_WATCH_ERROR时的错误码 */
+} card_watch_evt_t;
+/** 卡片插拔事件回调函数 */
+typedef void (*card_watch_cb_t)(card_watch_t *w, const card_watch_evt_t *evt, void *arg);
+
+/* 模拟卡片类型 */
+/** 模拟卡片类型 */
+typedef enum card_sim_card {
+	CARD_SIM_NONE = 0x00,			/**< 无卡 */
+	CARD_SIM_7816_T0 = 0x01,		/**< ISO7816 T=0回显卡 */
+	CARD_SIM_7816_T1 = 0x02,		/**< ISO7816 T=1回显卡，支持扩展长度 */
+	CARD_SIM_MIFARE = 0x03,			/**< MIFARE Classic 1K存储卡 */
+	CARD_SIM_14443_4 = 0x04,		/**< ISO14443-4 APDU卡，支持扩展长度 */
+	CARD_SIM_I2C_EEPROM = 0x05,		/**< I2C EEPROM 24C64 */
+	CARD_SIM_SPI_FLASH = 0x06,		/**< SPI Flash 25系列 1MB */
+	CARD_SIM_15693 = 0x07,			/**< ISO15693标签 256字节 */
+} card_sim_card_t;
+
+/* 模拟器配置 */
+/** 模拟器配置，概率单位为百万分之一 */
+typedef struct card_sim_config {
+	Uint16_t port;				/**< 监听端口，0使用CARD_SIM_PORT */
+	Uint32_t latency_us;		/**< 每条命令固定延时 单位微秒 */
+	Uint32_t jitter_us;			/**< 每条命令随机延时上限 单位微秒 */
+	Uint32_t byte_ns;			/**< 每字节传输延时 单位纳秒 */
+	Uint32_t err_ppm;			/**< 返回错误应答的概率 */
+	card_err_t err_code;		/**< 注入的错误码，0按命令类型选择 */
+	Uint32_t crc_ppm;			/**< 应答CRC错误的概率 */
+	Uint32_t mute_ppm;			/**< 不应答的概率 */
+	Uint32_t drop_ppm;			/**< 断开连接的概率 */
+	Uint32_t seed;				/**< 随机数种子，相同种子注入结果相同 */
+} card_sim_cfg_t;
+
+/* 读写器模拟器，内部结构 */
+typedef struct card_sim card_sim_t;		/**< 读写器模拟器 */
+/**
+ *  \}
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*---------------------------------------------------------
+			多线程打开接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 多线程打开接口函数
+ *  \{
+ */
+/**
+ * \brief		可在多个线程中同时调用的card_open
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	model 卡片模式
+ * \param[in]	addr IP地址，如"192.168.1.1"
+ * \retval		CARD_NO_ERR 成功
+ * \note		驱动库初始化完成前串行执行，之后直接调用card_open。
+ * \see			card_open
+ */
+card_err_t card_open_mt(card_obj_t *obj, card_mod_t model, Uint8_t *addr);
+/**
+ * \brief		可在多个线程中同时调用的ea_card_connect
+ * \see			ea_card_connect card_open_mt
+ */
+card_err_t ea_card_connect_mt(card_obj_t *obj, Uint8_t *addr);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			连接池接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 连接池接口函数
+ *  \{
+ */
+/**
+ * \brief		创建连接池
+ * \param[out]	pool 连接池
+ * \param[in]	max_conns 最大连接个数
+ * \param[in]	keepalive_ms 保活检查间隔 单位毫秒，0不检查
+ * \retval		CARD_NO_ERR 成功
+ * \note		keepalive_ms不为0时，内部线程定期用card_getinfo检查空闲连接，失败的连接关闭，下次获取时重新打开。
+ */
+card_err_t card_pool_create(card_pool_t **pool, Uint16_t max_conns, Uint32_t keepalive_ms);
+/**
+ * \brief		销毁连接池，关闭全部连接
+ * \param[in]	pool 连接池
+ * \retval		CARD_NO_ERR 成功
+ */
+card_err_t card_pool_destroy(card_pool_t *pool);
+/**
+ * \brief		从连接池获取会话
+ * \param[in]	pool 连接池
+ * \param[in]	addr IP地址，如"192.168.1.1"
+ * \param[in]	model 卡片模式
+ * \param[out]	obj 会话卡片对象
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_POOL_FULL 连接个数已达上限且无空闲连接
+ * \note		同一IP的会话共用一个通信连接，连接不存在时调用card_open打开。\n
+ *				非接触会话的卡片模式与连接当前模式不同时调用card_setmodel。\n
+ *				会话使用结束调用card_pool_release，不能调用card_close。
+ */
+card_err_t card_pool_acquire(card_pool_t *pool, Uint8_t *addr, card_mod_t model, card_obj_t *obj);
+/**
+ * \brief		释放会话
+ * \param[in]	pool 连接池
+ * \param[in]	obj 会话卡片对象
+ * \retval		CARD_NO_ERR 成功
+ * \note		会话last_err为通信层错误(0x4XXX)时，连接在全部会话释放后关闭。
+ */
+card_err_t card_pool_release(card_pool_t *pool, card_obj_t *obj);
+/**
+ * \brief		锁定会话所在的通信连接
+ * \param[in]	pool 连接池
+ * \param[in]	obj 会话卡片对象
+ * \retval		CARD_NO_ERR 成功
+ * \retval		其他 card_setmodel返回的错误，连接未锁定
+ * \note		共用连接的多个会话在不同线程中使用时，每组操作前后调用card_pool_lock/card_pool_unlock。\n
+ *				非接触会话的卡片模式与连接当前模式不同时调用card_setmodel。
+ */
+card_err_t card_pool_lock(card_pool_t *pool, card_obj_t *obj);
+/**
+ * \brief		解锁会话所在的通信连接
+ * \see			card_pool_lock
+ */
+card_err_t card_pool_unlock(card_pool_t *pool, card_obj_t *obj);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			通信跟踪接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 通信跟踪接口函数
+ *  \{
+ */
+/**
+ * \brief		创建通信跟踪
+ * \param[out]	trace 通信跟踪
+ * \param[in]	slots 内存缓存记录个数，向上取2的幂
+ * \param[in]	path 跟踪文件路径
+ * \retval		CARD_NO_ERR 成功
+ * \note		记录时只复制数据到内存缓存，不加锁，不访问文件。内部线程每10毫秒将记录写入跟踪文件。\n
+ *				跟踪文件可用tools/pt_trace_dump转换为与驱动库日志相同格式的文本。\n
+ *				长期记录时可在配置文件中关闭驱动库通信日志(CommLogSwitch)。
+ */
+card_err_t card_trace_create(card_trace_t **trace, Uint32_t slots, Uint8_t *path);
+/**
+ * \brief		写入剩余记录并销毁通信跟踪
+ * \param[in]	trace 通信跟踪
+ * \retval		CARD_NO_ERR 成功
+ */
+card_err_t card_trace_destroy(card_trace_t *trace);
+/**
+ * \brief		立即将内存缓存中的记录写入跟踪文件
+ * \param[in]	trace 通信跟踪
+ * \retval		CARD_NO_ERR 成功
+ */
+card_err_t card_trace_flush(card_trace_t *trace);
+/**
+ * \brief		获取因缓存已满丢弃的记录个数
+ * \param[in]	trace 通信跟踪
+ * \retval		丢弃的记录个数
+ */
+Uint32_t card_trace_dropped(card_trace_t *trace);
+/**
+ * \brief		添加一条跟踪记录
+ * \param[in]	trace 通信跟踪，为NULL时不记录
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	cmd 命令编号 CARD_CMD_XXX
+ * \param[in]	dir 方向 CARD_TRACE_DIR_TX/CARD_TRACE_DIR_RX
+ * \param[in]	err 错误码
+ * \param[in]	data 数据，可为NULL
+ * \param[in]	len 数据长度
+ * \note		可在多个线程中同时调用。
+ */
+void card_trace_record(card_trace_t *trace, const card_obj_t *obj, Uint8_t cmd, Uint8_t dir, card_err_t err, const Uint8_t *data, Uint16_t len);
+/**
+ * \brief		记录发送和接收数据的card_pipe
+ * \see			card_pipe card_trace_record
+ */
+card_err_t card_trace_pipe(card_trace_t *trace, card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen);
+/**
+ * \brief		记录ATR的card_reset
+ * \see			card_reset card_trace_record
+ */
+card_err_t card_trace_reset(card_trace_t *trace, card_obj_t *obj);
+/**
+ * \brief		记录发送和接收数据的card_i2c_write_read
+ * \see			card_i2c_write_read card_trace_record
+ */
+card_err_t card_trace_i2c_write_read(card_trace_t *trace, card_obj_t *obj, Uint16_t address, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen);
+/**
+ * \brief		记录发送和接收数据的card_spi_write_read
+ * \see			card_spi_write_read card_trace_record
+ */
+card_err_t card_trace_spi_write_read(card_trace_t *trace, card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			批量数据交换接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 批量数据交换接口函数
+ *  \{
+ */
+/**
+ * \brief		按顺序执行一组APDU
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	cmds APDU命令数组
+ * \param[in]	n APDU命令个数
+ * \param[out]	results 执行结果数组，长度不小于n
+ * \param[in]	flags 批量标志 CARD_BATCH_FLAG_XXX
+ * \retval		CARD_NO_ERR 全部执行成功
+ * \retval		CARD_ERR_SW_UNEXPECTED 状态字不符合预期
+ * \retval		其他 第一个出错命令的错误代码
+ * \note		状态字满足(SW & sw_mask) == (sw_expect & sw_mask)时视为符合预期。\n
+ *				应答数据超过rsize时截断复制，rlen仍为实际长度。\n
+ *				默认出错后停止；CARD_BATCH_FLAG_CONTINUE时卡片错误和状态字不符合预期后继续执行，
+ *				通信错误(0x4XXX)仍停止。各命令的结果见results[i].err，
+ *				未执行的命令结果err为CARD_ERR_NOT_EXECUTED。
+ */
+card_err_t card_pipe_batch(card_obj_t *obj, const card_apdu_t *cmds, Uint16_t n, card_apdu_res_t *results, Uint8_t flags);
+/**
+ * \brief		按顺序执行一组内部写卡记录
+ * \param[in]	obj 卡片对象结构体，已调用ea_card_initpre
+ * \param[in,out]	recs 内部写卡记录数组，执行后填写output_len、err、time_us
+ * \param[in]	n 记录个数
+ * \param[in]	flags 批量标志，CARD_BATCH_FLAG_CONTINUE时单张卡片出错不停止
+ * \param[in]	cb 每条记录执行后调用，可为NULL
+ * \param[in]	arg 回调函数参数
+ * \retval		CARD_NO_ERR 全部执行成功
+ * \retval		其他 第一条出错记录的错误码
+ * \note		每条记录调用一次ea_card_runpre，上一张卡片完成后立即执行下一条，
+ *				输出信息通过回调函数逐条返回，无需等待整批完成。\n
+ *				通信错误时停止执行，未执行的记录err为CARD_ERR_NOT_EXECUTED。
+ */
+card_err_t card_runpre_batch(card_obj_t *obj, card_runpre_rec_t *recs, Uint16_t n, Uint8_t flags, card_runpre_cb_t cb, void *arg);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			扩展长度数据交换接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 扩展长度数据交换接口函数
+ *  \{
+ */
+/**
+ * \brief		数据交换，应答写入分散缓存
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	tbuf 发送APDU，可为扩展长度
+ * \param[in]	tlen 发送APDU长度
+ * \param[out]	iov 分散缓存数组
+ * \param[in]	iov_cnt 分散缓存个数
+ * \param[out]	rlen 应答数据长度，不含SW1 SW2
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_BUF_SMALL 应答数据超过分散缓存总大小，已截断复制，rlen为实际长度
+ * \note		应答数据不含状态字，状态字在obj->sw1、obj->sw2中。\n
+ *				调用者无需预留CARD_APDU_RESP_MAX大小的接收缓存。
+ */
+card_err_t card_pipe_iov(card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, const card_iov_t *iov, Uint32_t iov_cnt, Uint32_t *rlen);
+/**
+ * \brief		分段读取当前透明文件
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	cla READ BINARY命令CLA
+ * \param[in]	offset 文件偏移，超过0x7FFF时使用奇数INS(B1)
+ * \param[in]	len 读取长度，0为读到文件尾或分散缓存写满
+ * \param[in]	chunk 单条命令读取长度，0为CARD_READ_CHUNK_MAX
+ * \param[out]	iov 分散缓存数组
+ * \param[in]	iov_cnt 分散缓存个数
+ * \param[in]	cb 每段数据写入缓存后调用，可为NULL
+ * \param[in]	arg 回调函数参数
+ * \param[out]	rlen 已读取长度
+ * \retval		CARD_NO_ERR 成功，读到文件尾时rlen小于len
+ * \retval		CARD_ERR_SW_UNEXPECTED 状态字错误，状态字在obj->sw1、obj->sw2中
+ * \note		chunk大于256时使用扩展长度Le，单条命令读取数据，比短长度减少命令个数。\n
+ *				卡片返回6700时自动改为256字节，6CXX时按卡片给出的长度重发(每段一次)，
+ *				61XX时用GET RESPONSE(行业间CLA，保留逻辑通道)取回剩余数据。\n
+ *				状态字6282，或读取中途返回6B00、6A82、6A86时视为文件结束，出错时rlen为出错前已读取的长度。
+ */
+card_err_t card_read_binary(card_obj_t *obj, Uint8_t cla, Uint32_t offset, Uint32_t len, Uint16_t chunk,
+	const card_iov_t *iov, Uint32_t iov_cnt, card_stream_cb_t cb, void *arg, Uint32_t *rlen);
+/**
+ * \brief		数据交换，拼接61XX应答并处理6CXX
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	tbuf 发送APDU
+ * \param[in]	tlen 发送APDU长度
+ * \param[out]	rbuf 拼接后的应答数据，末尾为最后一次的SW1 SW2
+ * \param[in]	rsize 应答缓存大小，可超过CARD_APDU_RESP_MAX
+ * \param[out]	rlen 拼接后的应答长度
+ * \param[in]	max_xchg 最大交换次数，0为不限制
+ * \param[out]	stat 交换次数和耗时，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_XCHG_LIMIT 交换次数达到max_xchg，rbuf为已取回的数据和最后的61XX
+ * \retval		CARD_ERR_BUF_SMALL 应答超过rsize，已截断，rlen为实际长度
+ * \note		主机端执行GET RESPONSE，每次交换耗时可见并可限制次数，适用于需要诊断长时间无应答的T=0卡片。\n
+ *				读写器端自动应答(card_cfg的auto_resp、auto_rele)不返回内部交换次数，启用时本函数只有一次交换。\n
+ *				GET RESPONSE使用行业间CLA并保留逻辑通道，私有CLA(bit8为1)时使用0x00。
+ */
+card_err_t card_pipe_chain(card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint32_t rsize, Uint32_t *rlen,
+	Uint16_t max_xchg, card_xchg_stat_t *stat);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			异步接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 异步接口函数
+ *  \{
+ */
+/**
+ * \brief		创建卡片对象的异步上下文
+ * \param[out]	ctx 异步上下文
+ * \param[in]	obj 已打开的卡片对象结构体
+ * \param[in]	depth 未完成请求的最大个数，0使用CARD_ASYNC_DEFAULT_DEPTH
+ * \retval		CARD_NO_ERR 成功
+ * \note		异步上下文存在期间，卡片对象只能通过card_submit_XXX操作。\n
+ *				不是事件循环：每个异步上下文创建一个内部线程，在线程中调用阻塞接口，
+ *				同一卡片对象的请求按提交顺序执行，完成后通过card_async_fd(Windows为card_async_event)通知。
+ *				每个读卡器占用一个线程。
+ */
+card_err_t card_async_create(card_async_t **ctx, card_obj_t *obj, Uint16_t depth);
+/**
+ * \brief		销毁异步上下文
+ * \param[in]	ctx 异步上下文
+ * \retval		CARD_NO_ERR 成功
+ * \note		等待正在执行的请求完成，未执行的请求丢弃，不调用回调函数。\n
+ *				不关闭卡片对象。
+ */
+card_err_t card_async_destroy(card_async_t *ctx);
+#ifdef WIN32
+/**
+ * \brief		获取完成通知事件句柄
+ * \param[in]	ctx 异步上下文
+ * \retval		事件句柄(HANDLE)，有请求完成时为有信号状态
+ * \note		可用于WaitForMultipleObjects，收到信号后调用card_async_poll。
+ */
+void *card_async_event(card_async_t *ctx);
+#else
+/**
+ * \brief		获取完成通知文件描述符
+ * \param[in]	ctx 异步上下文
+ * \retval		文件描述符，有请求完成时可读
+ * \note		可用于select/poll/epoll，可读后调用card_async_poll。
+ */
+int card_async_fd(card_async_t *ctx);
+#endif
+/**
+ * \brief		获取已完成的请求
+ * \param[in]	ctx 异步上下文
+ * \param[out]	done 完成信息数组，可为NULL
+ * \param[in]	max 完成信息数组长度
+ * \param[out]	count 本次取出的完成请求个数，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \note		不阻塞。提交时设置了回调函数的请求在调用线程中回调，不写入done数组。
+ */
+card_err_t card_async_poll(card_async_t *ctx, card_async_done_t *done, Uint16_t max, Uint16_t *count);
+/**
+ * \brief		提交卡片复位请求
+ * \param[in]	ctx 异步上下文
+ * \param[in]	cb 完成回调函数，可为NULL
+ * \param[in]	arg 用户参数
+ * \param[out]	req 请求句柄，可为NULL
+ * \retval		CARD_NO_ERR 提交成功
+ * \retval		CARD_ERR_QUEUE_FULL 未完成请求已达上限
+ * \see			card_reset
+ */
+card_err_t card_submit_reset(card_async_t *ctx, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ * \brief		提交卡片热复位请求
+ * \see			card_warm_reset card_submit_reset
+ */
+card_err_t card_submit_warm_reset(card_async_t *ctx, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ * \brief		提交卡片下电请求
+ * \see			card_off card_submit_reset
+ */
+card_err_t card_submit_off(card_async_t *ctx, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ * \brief		提交数据交换请求
+ * \param[in]	ctx 异步上下文
+ * \param[in]	tbuf 发送数据缓存
+ * \param[in]	tlen 发送数据长度
+ * \param[out]	rbuf 接收数据缓存
+ * \param[out]	rlen 接收数据长度
+ * \param[in]	cb 完成回调函数，可为NULL
+ * \param[in]	arg 用户参数
+ * \param[out]	req 请求句柄，可为NULL
+ * \retval		CARD_NO_ERR 提交成功
+ * \note		tbuf/rbuf/rlen在请求完成前必须保持有效。
+ * \see			card_pipe
+ */
+card_err_t card_submit_pipe(card_async_t *ctx, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ * \brief		提交批量数据交换请求
+ * \note		cmds/results在请求完成前必须保持有效。
+ * \see			card_pipe_batch card_submit_pipe
+ */
+card_err_t card_submit_pipe_batch(card_async_t *ctx, const card_apdu_t *cmds, Uint16_t n, card_apdu_res_t *results, Uint8_t flags, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ * \brief		提交reqa请求
+ * \see			card_reqa card_submit_reset
+ */
+card_err_t card_submit_reqa(card_async_t *ctx, Uint16_t *atqa, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ * \brief		提交唤醒请求
+ * \see			card_wupa card_submit_reset
+ */
+card_err_t card_submit_wupa(card_async_t *ctx, Uint16_t *atqa, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ * \brief		提交请求应答选择请求
+ * \see			card_rats card_submit_reset
+ */
+card_err_t card_submit_rats(card_async_t *ctx, Uint8_t *ats, Uint16_t *ats_len, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ * \brief		提交I2C写后读请求
+ * \see			card_i2c_write_read card_submit_pipe
+ */
+card_err_t card_submit_i2c_write_read(card_async_t *ctx, Uint16_t address, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ * \brief		提交SPI写后读请求
+ * \see			card_spi_write_read card_submit_pipe
+ */
+card_err_t card_submit_spi_write_read(card_async_t *ctx, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ * \brief		提交自定义函数请求
+ * \param[in]	ctx 异步上下文
+ * \param[in]	fn 在内部线程中执行的函数，参数为卡片对象和fn_arg
+ * \param[in]	fn_arg 函数参数
+ * \param[in]	cb 完成回调函数，可为NULL
+ * \param[in]	arg 用户参数
+ * \param[out]	req 请求句柄，可为NULL
+ * \retval		CARD_NO_ERR 提交成功
+ * \note		用于异步执行未单独提供提交函数的接口或组合操作。
+ */
+card_err_t card_submit_call(card_async_t *ctx, card_async_fn_t fn, void *fn_arg, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ * \brief		提交内部写卡请求
+ * \param[in]	ctx 异步上下文
+ * \param[in,out]	rec 内部写卡记录
+ * \param[in]	cb 完成回调函数，可为NULL
+ * \param[in]	arg 用户参数
+ * \param[out]	req 请求句柄，可为NULL
+ * \retval		CARD_NO_ERR 提交成功
+ * \note		rec在请求完成前必须保持有效。\n
+ *				ea_card_initpre后连续提交多条记录，内部线程逐张执行，
+ *				调用者只需在完成后补充提交，保持队列不为空。
+ * \see			ea_card_runpre card_runpre_batch
+ */
+card_err_t card_submit_runpre(card_async_t *ctx, card_runpre_rec_t *rec, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ * \brief		提交批量内部写卡请求
+ * \param[in]	rec_cb 每条记录执行后在内部线程中调用，可为NULL
+ * \param[in]	rec_arg 记录回调函数参数
+ * \note		recs在请求完成前必须保持有效。rec_cb不应阻塞，以免延迟下一张卡片。
+ * \see			card_runpre_batch card_submit_runpre
+ */
+card_err_t card_submit_runpre_batch(card_async_t *ctx, card_runpre_rec_t *recs, Uint16_t n, Uint8_t flags, card_runpre_cb_t rec_cb, void *rec_arg, card_async_cb_t cb, void *arg, card_req_t *req);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			多读写器调度接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 多读写器调度接口函数
+ *  \{
+ */
+/**
+ * \brief		创建多读写器调度器
+ * \param[out]	st 调度器
+ * \param[in]	model 打开读写器使用的卡片模式
+ * \param[in]	depth 每个读写器队列的最大任务个数，0使用CARD_ASYNC_DEFAULT_DEPTH
+ * \retval		CARD_NO_ERR 成功
+ */
+card_err_t card_station_create(card_station_t **st, card_mod_t model, Uint16_t depth);
+/**
+ * \brief		添加读写器
+ * \param[in]	st 调度器
+ * \param[in]	addr 读写器IP地址
+ * \param[out]	reader 读写器编号，按添加顺序从0开始，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_POOL_FULL 已达CARD_STATION_MAX_READERS
+ * \note		每个读写器一个内部线程，添加后立即在该线程中连接，连接失败不影响其他读写器。
+ */
+card_err_t card_station_add(card_station_t *st, Uint8_t *addr, Uint16_t *reader);
+/**
+ * \brief		提交任务
+ * \param[in]	st 调度器
+ * \param[in]	reader 读写器编号，CARD_STATION_ANY由调度器选择
+ * \param[in]	fn 任务函数，在读写器线程中以已打开的卡片对象调用
+ * \param[in]	fn_arg 任务函数参数
+ * \param[in]	cb 完成回调函数，可为NULL
+ * \param[in]	arg 回调函数参数
+ * \param[out]	job 任务句柄，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_QUEUE_FULL 队列已满，调用者应等待任务完成后重新提交
+ * \note		CARD_STATION_ANY的任务放入在线读写器中任务最少的队列，空闲读写器从最长的队列末尾取走这类任务。\n
+ *				指定读写器的任务只在该读写器执行，读写器重连失败时以连接错误完成。\n
+ *				任务返回0x4XXX通信错误时关闭并重连该读写器，任务本身不重试。\n
+ *				回调函数在读写器线程中调用，不持有内部锁，可在回调中提交新任务。
+ */
+card_err_t card_station_submit(card_station_t *st, Uint16_t reader, card_async_fn_t fn, void *fn_arg,
+	card_station_cb_t cb, void *arg, card_req_t *job);
+/**
+ * \brief		等待已提交的任务全部完成
+ * \param[in]	st 调度器
+ * \param[in]	timeout_ms 超时时间 单位毫秒，0为一直等待
+ * \retval		CARD_NO_ERR 全部完成，含回调函数返回
+ * \retval		CARD_ERR_TIMEOUT 超时
+ */
+card_err_t card_station_wait(card_station_t *st, Uint32_t timeout_ms);
+/**
+ * \brief		获取读写器统计
+ * \param[in]	st 调度器
+ * \param[in]	reader 读写器编号
+ * \param[out]	stat 统计
+ * \retval		CARD_NO_ERR 成功
+ */
+card_err_t card_station_stat(card_station_t *st, Uint16_t reader, card_reader_stat_t *stat);
+/**
+ * \brief		销毁调度器，关闭全部读写器
+ * \param[in]	st 调度器
+ * \retval		CARD_NO_ERR 成功
+ * \note		等待正在执行的任务完成，未执行的任务丢弃，不调用回调函数。
+ */
+card_err_t card_station_destroy(card_station_t *st);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			脚本下载接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 脚本下载接口函数
+ *  \{
+ */
+/**
+ * \brief		计算文件MD5值
+ * \param[in]	path 文件路径
+ * \param[out]	md5 MD5值(长度16字节)
+ * \retval		CARD_NO_ERR 成功
+ */
+card_err_t card_md5_file(Uint8_t *path, Uint8_t *md5);
+/**
+ * \brief		计算内存数据MD5值
+ * \param[in]	buf 数据
+ * \param[in]	len 数据长度
+ * \param[out]	md5 MD5值(长度16字节)
+ */
+void card_md5(const Uint8_t *buf, Uint32_t len, Uint8_t *md5);
+/**
+ * \brief		从内存下载内部解析脚本库程序
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	buf 库程序内容，可为mmap映射区域
+ * \param[in]	len 库程序内容长度
+ * \param[in]	name 保存名称
+ * \param[out]	md5 下载成功返回库程序MD5值(长度16字节)
+ * \param[in]	force 同ea_card_addpre
+ * \retval		CARD_NO_ERR 成功
+ * \note		驱动库只接受文件路径，内容写入临时文件后调用ea_card_addpre，返回前删除。
+ *				Linux临时文件位于/dev/shm，不可用时使用TMPDIR或/tmp。
+ * \see			ea_card_addpre card_deploy_file
+ */
+card_err_t card_addpre_buf(card_obj_t *obj, const Uint8_t *buf, Uint32_t len, Uint8_t *name, Uint8_t *md5, Uint8_t force);
+/**
+ * \brief		从内存下载内部写卡脚本文件
+ * \see			ea_card_addscript card_addpre_buf
+ */
+card_err_t card_addscript_buf(card_obj_t *obj, const Uint8_t *buf, Uint32_t len, Uint8_t *name, Uint8_t *md5, Uint8_t force);
+/**
+ * \brief		查询读写器中是否存在文件
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	type 文件类型 CARD_DEPLOY_PRE或CARD_DEPLOY_SCRIPT
+ * \param[in]	name 保存名称，card_deploy_file返回的stored_name
+ * \param[out]	present 1:存在 0:不存在
+ * \retval		CARD_NO_ERR 成功
+ * \note		一次ea_card_listpre或ea_card_listscript，不传输文件内容。
+ */
+card_err_t card_deploy_probe(card_obj_t *obj, Uint8_t type, Uint8_t *name, Uint8_t *present);
+/**
+ * \brief		按内容下载脚本文件，读写器中已存在相同内容时跳过
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	d 下载文件
+ * \param[out]	res 下载结果
+ * \retval		CARD_NO_ERR 成功
+ * \retval		0x3012 读写器返回的MD5值与本地文件不同
+ * \note		保存名称为name在扩展名前附加"_"和MD5值前CARD_DEPLOY_HASH_LEN位，
+ *				例如"pre.so"保存为"pre_0123456789abcdef.so"，内容不变时名称不变。\n
+ *				ea_card_initpre应使用res->stored_name。下载中断时读写器不保留该名称，重新调用即可。\n
+ *				d->path为NULL时MD5值由内存数据计算，读写器中已存在时不产生临时文件。
+ */
+card_err_t card_deploy_file(card_obj_t *obj, const card_deploy_t *d, card_deploy_res_t *res);
+/**
+ * \brief		向调度器中的读写器并行下载脚本文件
+ * \param[in]	st 调度器
+ * \param[in]	d 下载文件
+ * \param[out]	results 下载结果数组，按读写器编号排列
+ * \param[in]	n 读写器个数，编号0到n-1
+ * \retval		CARD_NO_ERR 全部成功
+ * \retval		其他 第一个失败读写器的错误码
+ * \note		每个读写器在各自线程中执行card_deploy_file，已有该文件的读写器不传输。\n
+ *				函数等待调度器中全部任务完成后返回。
+ */
+card_err_t card_station_deploy(card_station_t *st, const card_deploy_t *d, card_deploy_res_t *results, Uint16_t n);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			非接触卡片盘点接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 非接触卡片盘点接口函数
+ *  \{
+ */
+/**
+ * \brief		盘点场区内的全部非接触卡片
+ * \param[in]	obj 卡片对象结构体，模式为ISO14443A、MIFARE、ISO14443B或ISO15693
+ * \param[in]	flags 盘点标志 CARD_INV_FLAG_XXX
+ * \param[in]	afi ISO15693应用族标识，0为全部卡片
+ * \param[out]	tags 卡片信息数组
+ * \param[in]	max 卡片信息数组长度
+ * \param[out]	count 盘点到的卡片个数
+ * \retval		CARD_NO_ERR 成功，场区内无卡片时count为0
+ * \retval		CARD_ERR_BUF_SMALL 卡片个数超过max，tags为前max张
+ * \note		ISO14443A: WUPA、防冲突、选择后HALTA，重复REQA直到无卡片应答。\n
+ *				ISO14443B: WUPB后HALTB，重复REQB，AFI和时隙数使用card_pcfg设置的afi、slot_no。\n
+ *				ISO15693: 关闭并重新开启载波使静默的卡片回到就绪状态，单时隙INVENTORY，
+ *				碰撞时按UID逐位扩展掩码，取得UID后STAY QUIET。\n
+ *				盘点后卡片处于暂停(静默)状态，操作其中一张卡片需重新唤醒并按UID选择。\n
+ *				只有无应答和未解决的碰撞结束盘点，其他读写器或卡片错误返回错误代码。
+ */
+card_err_t card_inventory(card_obj_t *obj, Uint8_t flags, Uint8_t afi, card_tag_t *tags, Uint16_t max, Uint16_t *count);
+/**
+ * \brief		轮询盘点，卡片进入或离开场区时回调
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	flags 盘点标志 CARD_INV_FLAG_XXX
+ * \param[in]	afi ISO15693应用族标识
+ * \param[in]	interval_ms 两次盘点之间的间隔 单位毫秒，0为连续盘点
+ * \param[in]	cb 回调函数，event为CARD_TAG_ARRIVED或CARD_TAG_DEPARTED
+ * \param[in]	arg 回调函数参数
+ * \retval		CARD_NO_ERR 回调函数返回非0
+ * \retval		其他 card_inventory返回的错误
+ * \note		在调用线程中阻塞执行。一次盘点中未出现的卡片即视为离开。\n
+ *				每次盘点最多记录CARD_INV_MAX_TAGS张卡片。
+ */
+card_err_t card_inventory_poll(card_obj_t *obj, Uint8_t flags, Uint8_t afi, Uint32_t interval_ms, card_tag_cb_t cb, void *arg);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			MIFARE批量读写接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup MIFARE批量读写接口函数
+ *  \{
+ */
+/**
+ * \brief		按扇区读取MIFARE Classic卡片
+ * \param[in]	obj 卡片对象结构体，卡片已选择
+ * \param[in]	uid 卡片UID，4字节
+ * \param[in]	keys 扇区密钥表，keys[i]用于扇区first_sector+i
+ * \param[in]	nkeys 密钥个数，1为全部扇区使用同一密钥，否则不小于nsectors
+ * \param[in]	first_sector 起始扇区
+ * \param[in]	nsectors 扇区个数
+ * \param[out]	rbuf 数据，按块顺序存放，大小为card_mifare_sectors_size
+ * \param[in]	flags CARD_BATCH_FLAG_CONTINUE时扇区出错后继续读取其他扇区
+ * \param[out]	sector_err 各扇区执行结果，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		其他 第一个出错扇区的错误码
+ * \note		每个扇区认证一次后读取全部块，扇区尾块中不可读的密钥返回为0。\n
+ *				认证失败后卡片停止应答，继续时以WUPA和SELECT重新选择卡片。
+ */
+card_err_t card_mifare_read_sectors(card_obj_t *obj, Uint8_t *uid, const card_mifare_key_t *keys, Uint8_t nkeys,
+	Uint8_t first_sector, Uint8_t nsectors, Uint8_t *rbuf, Uint8_t flags, card_err_t *sector_err);
+/**
+ * \brief		按扇区写入MIFARE Classic卡片
+ * \param[in]	tbuf 数据，布局与card_mifare_read_sectors相同
+ * \param[in]	flags CARD_BATCH_FLAG_CONTINUE、CARD_MIFARE_FLAG_TRAILER、CARD_MIFARE_FLAG_BLOCK0组合
+ * \note		默认跳过厂商块和扇区尾块，tbuf中对应数据忽略，读取-修改-写回不会改变密钥。
+ * \see			card_mifare_read_sectors
+ */
+card_err_t card_mifare_write_sectors(card_obj_t *obj, Uint8_t *uid, const card_mifare_key_t *keys, Uint8_t nkeys,
+	Uint8_t first_sector, Uint8_t nsectors, const Uint8_t *tbuf, Uint8_t flags, card_err_t *sector_err);
+/**
+ * \brief		计算扇区范围的数据长度
+ * \param[in]	first_sector 起始扇区
+ * \param[in]	nsectors 扇区个数
+ * \retval		数据长度，扇区0-31每扇区64字节，扇区32-39每扇区256字节
+ */
+Uint32_t card_mifare_sectors_size(Uint8_t first_sector, Uint8_t nsectors);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			ISO15693和FeliCa批量读写接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup ISO15693和FeliCa批量读写接口函数
+ *  \{
+ */
+/**
+ * \brief		读取ISO15693标签的连续块
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	uid 标签UID，8字节，低字节在前，NULL时使用非寻址模式
+ * \param[in]	first 起始块号
+ * \param[in]	count 块个数，first+count不大于256
+ * \param[in]	block_size 块长度，由标签型号决定，常见为4
+ * \param[in]	max_blocks 每条命令的块数，标签限制的上限，0为CARD_15693_READ_BLOCKS
+ * \param[out]	rbuf 数据，大小为count*block_size
+ * \param[in]	cb 每条命令完成后回调，offset和len为本次数据在rbuf中的位置，可为NULL
+ * \param[in]	arg 回调函数参数
+ * \param[out]	rlen 已读取的数据长度，出错时为出错前的长度，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_SW_UNEXPECTED 标签返回错误，应答标志在obj->sw1，错误码在obj->sw2
+ * \retval		其他 失败
+ * \note		使用READ MULTIPLE BLOCKS命令，不请求块安全状态。
+ */
+card_err_t card_15693_read_blocks(card_obj_t *obj, Uint8_t *uid, Uint8_t first, Uint16_t count, Uint8_t block_size,
+	Uint8_t max_blocks, Uint8_t *rbuf, card_stream_cb_t cb, void *arg, Uint32_t *rlen);
+/**
+ * \brief		写入ISO15693标签的连续块
+ * \param[in]	max_blocks 每条命令的块数，1为逐块WRITE SINGLE BLOCK，0为CARD_15693_WRITE_BLOCKS
+ * \param[in]	tbuf 数据，大小为count*block_size
+ * \param[out]	wlen 已写入的数据长度，可为NULL
+ * \note		标签不支持WRITE MULTIPLE BLOCKS时自动改为逐块写入。\n
+ *				需要选项标志的标签(如部分TI标签)请使用card_pipe。
+ * \see			card_15693_read_blocks
+ */
+card_err_t card_15693_write_blocks(card_obj_t *obj, Uint8_t *uid, Uint8_t first, Uint16_t count, Uint8_t block_size,
+	Uint8_t max_blocks, const Uint8_t *tbuf, card_stream_cb_t cb, void *arg, Uint32_t *wlen);
+/**
+ * \brief		轮询FeliCa卡片，取得IDm
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	cfg 读写器协议配置，使用其中的system_code，NULL时为0xFFFF
+ * \param[out]	idm 卡片IDm，8字节
+ * \param[out]	pmm 卡片PMm，8字节，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		其他 失败
+ * \see			card_pcfg
+ */
+card_err_t card_felica_poll(card_obj_t *obj, const card_pcfg_t *cfg, Uint8_t *idm, Uint8_t *pmm);
+/**
+ * \brief		读取FeliCa卡片的多个块(Read Without Encryption)
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	idm 卡片IDm，8字节
+ * \param[in]	services 服务代码表，每条命令均发送全部服务代码
+ * \param[in]	nsvc 服务个数，不大于CARD_FELICA_SERVICES_MAX
+ * \param[in]	blocks 块列表，可以包括不同服务的块
+ * \param[in]	nblocks 块个数，不限长度，按max_blocks分段
+ * \param[in]	max_blocks 每条命令的块数，0为CARD_FELICA_READ_BLOCKS，不大于CARD_FELICA_BLOCKS_MAX
+ * \param[out]	rbuf 数据，按块列表顺序存放，大小为nblocks*16
+ * \param[in]	cb 每条命令完成后回调，可为NULL
+ * \param[in]	arg 回调函数参数
+ * \param[out]	rlen 已读取的数据长度，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_SW_UNEXPECTED 卡片返回错误，状态标志1、2在obj->sw1、obj->sw2
+ * \retval		其他 失败
+ * \note		命令帧包括长度字节，直接通过card_pipe发送。
+ */
+card_err_t card_felica_read(card_obj_t *obj, Uint8_t *idm, const Uint16_t *services, Uint8_t nsvc,
+	const card_felica_block_t *blocks, Uint16_t nblocks, Uint8_t max_blocks, Uint8_t *rbuf,
+	card_stream_cb_t cb, void *arg, Uint32_t *rlen);
+/**
+ * \brief		写入FeliCa卡片的多个块(Write Without Encryption)
+ * \param[in]	max_blocks 每条命令的块数，0为CARD_FELICA_WRITE_BLOCKS，命令总长不能超过255字节
+ * \param[in]	tbuf 数据，大小为nblocks*16
+ * \param[out]	wlen 已写入的数据长度，可为NULL
+ * \see			card_felica_read
+ */
+card_err_t card_felica_write(card_obj_t *obj, Uint8_t *idm, const Uint16_t *services, Uint8_t nsvc,
+	const card_felica_block_t *blocks, Uint16_t nblocks, Uint8_t max_blocks, const Uint8_t *tbuf,
+	card_stream_cb_t cb, void *arg, Uint32_t *wlen);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			会话配置模板接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 会话配置模板接口函数
+ *  \{
+ */
+/**
+ * \brief		设置模板中的全部项目
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	p 配置模板
+ * \param[in,out]	cur 读写器当前配置，与模板相同的读写器级别项目不再发送，成功设置的项目记录到其中，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		其他 第一个失败项目的错误码，之前的项目已生效
+ * \note		按协议、电压、频率、card_cfg、card_pcfg、PPS、ETU的顺序设置。\n
+ *				PPS和ETU属于单张卡片，每次都发送。\n
+ *				cur初始化为0，重新连接读写器或其他方式修改配置后需重新初始化。
+ */
+card_err_t card_profile_apply(card_obj_t *obj, const card_profile_t *p, card_profile_t *cur);
+/**
+ * \brief		按模板配置读写器后复位卡片
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	p 配置模板
+ * \param[in,out]	cur 读写器当前配置，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		其他 失败
+ * \note		代替card_reset，复位成功后执行模板中的PPS和ETU。
+ * \see			card_profile_apply card_reset
+ */
+card_err_t card_profile_reset(card_obj_t *obj, const card_profile_t *p, card_profile_t *cur);
+/**
+ * \brief		序列化配置模板
+ * \param[in]	p 配置模板
+ * \param[out]	buf 数据缓存
+ * \param[in]	size 缓存大小，不小于CARD_PROFILE_SIZE
+ * \param[out]	len 数据长度，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_BUF_SMALL 缓存不足
+ * \note		各字段按小端序保存，不同平台之间可以交换。
+ */
+card_err_t card_profile_save(const card_profile_t *p, Uint8_t *buf, Uint32_t size, Uint32_t *len);
+/**
+ * \brief		读取序列化的配置模板
+ * \param[out]	p 配置模板
+ * \param[in]	buf 数据
+ * \param[in]	len 数据长度
+ * \retval		CARD_NO_ERR 成功
+ * \retval		0x3007 格式或版本错误
+ * \see			card_profile_save
+ */
+card_err_t card_profile_load(card_profile_t *p, const Uint8_t *buf, Uint32_t len);
+/**
+ * \brief		按名称查找配置模板
+ * \param[in]	profiles 模板数组
+ * \param[in]	n 模板个数
+ * \param[in]	name 名称
+ * \retval		找到的模板，没有时为NULL
+ */
+const card_profile_t *card_profile_find(const card_profile_t *profiles, Uint16_t n, const char *name);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			PPS自动选择接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup PPS自动选择接口函数
+ *  \{
+ */
+/**
+ * \brief		创建PPS结果缓存
+ * \param[out]	cache 缓存
+ * \retval		CARD_NO_ERR 成功
+ * \note		缓存可由多个线程的card_pps_tune共用。
+ */
+card_err_t card_pps_cache_create(card_pps_cache_t **cache);
+/**
+ * \brief		销毁PPS结果缓存
+ * \param[in]	cache 缓存
+ * \retval		CARD_NO_ERR 成功
+ */
+card_err_t card_pps_cache_destroy(card_pps_cache_t *cache);
+/**
+ * \brief		选择接触卡片可以稳定通信的最高速率
+ * \param[in]	obj 卡片对象结构体，已执行card_reset
+ * \param[in]	cfg 选择参数
+ * \param[in]	cache 结果缓存，可为NULL
+ * \param[out]	result 选择结果，可为NULL
+ * \retval		CARD_NO_ERR 成功，卡片已按结果复位并完成PPS
+ * \retval		其他 默认速率下校验仍失败或通信错误
+ * \note		候选速率为ATR中TA1的Fi和不超过卡片Di的各D值，与不超过卡片最大时钟的各候选频率组合，
+ *				按速率从高到低尝试，每次复位、PPS后发送校验APDU。奇偶校验、CRC等错误时尝试下一个。\n
+ *				全部失败时以原时钟和默认速率复位。缓存中有相同ATR时直接使用，校验失败后重新选择。\n
+ *				读写器自动PPS(card_cfg_t.auto_pps)需关闭。
+ */
+card_err_t card_pps_tune(card_obj_t *obj, const card_pps_tune_t *cfg, card_pps_cache_t *cache, card_pps_result_t *result);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			I2C EEPROM批量读写接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup I2C EEPROM批量读写接口函数
+ *  \{
+ */
+/**
+ * \brief		计算CRC32(IEEE 802.3)
+ * \param[in]	crc 上一段数据的结果，第一段为0
+ * \param[in]	buf 数据
+ * \param[in]	len 数据长度
+ * \retval		CRC32值
+ */
+Uint32_t card_crc32(Uint32_t crc, const Uint8_t *buf, Uint32_t len);
+/**
+ * \brief		写入I2C EEPROM映像
+ * \param[in]	obj 卡片对象结构体，已执行card_i2c_on
+ * \param[in]	p 读写参数
+ * \param[in]	image 映像数据
+ * \param[in]	len 映像长度，不限于页长度
+ * \param[in]	cb 每页写入后回调，offset和len为本页在映像中的位置，可为NULL
+ * \param[in]	arg 回调函数参数
+ * \param[out]	crc 成功时映像的CRC32，校验时为回读数据的CRC32，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_VERIFY 回读数据与映像不一致
+ * \retval		其他 失败
+ * \note		按页边界拆分，每页一条命令。写周期内设备不应答(0x1008)或忙(0x1038)时重发，
+ *				直到poll_timeout_ms，读写器写后等待参数I2C_PARAM_WRITE_READ_INTERVAL可设为0。\n
+ *				设备地址宽度按I2C_PARAM_ADDRESS_WIDTH设置。
+ */
+card_err_t card_i2c_eeprom_write(card_obj_t *obj, const card_i2c_prog_t *p, const Uint8_t *image, Uint32_t len,
+	card_stream_cb_t cb, void *arg, Uint32_t *crc);
+/**
+ * \brief		读取I2C EEPROM
+ * \param[out]	rbuf 数据，大小为len
+ * \param[out]	crc 读取数据的CRC32，可为NULL
+ * \see			card_i2c_eeprom_write
+ */
+card_err_t card_i2c_eeprom_read(card_obj_t *obj, const card_i2c_prog_t *p, Uint8_t *rbuf, Uint32_t len,
+	card_stream_cb_t cb, void *arg, Uint32_t *crc);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			SPI Flash批量读写接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup SPI Flash批量读写接口函数
+ *  \{
+ */
+/**
+ * \brief		读取JEDEC ID并取得器件信息
+ * \param[in]	obj 卡片对象结构体，已执行card_spi_on
+ * \param[in]	freq SCLK频率 单位Hz，0为不修改，最大CARD_SPI_FREQ_MAX
+ * \param[out]	f 器件信息，容量按JEDEC ID容量代码计算，页和扇区为通用值，可由调用者修改
+ * \retval		CARD_NO_ERR 成功
+ * \retval		0x1008 无器件应答或ID无效
+ * \note		只支持3字节地址(不大于16MB)的器件。
+ */
+card_err_t card_spi_flash_probe(card_obj_t *obj, Uint32_t freq, card_spi_flash_t *f);
+/**
+ * \brief		擦除SPI Flash
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	f 器件信息
+ * \param[in]	addr 起始地址，按扇区向下对齐
+ * \param[in]	len 长度，结束地址按扇区向上对齐
+ * \param[in]	cb 每次擦除后回调，offset为擦除地址，可为NULL
+ * \param[in]	arg 回调函数参数
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_TIMEOUT 擦除超时
+ * \retval		0x3007 sector_size为0或不是2的幂
+ * \note		64KB对齐的部分使用块擦除，其他使用扇区擦除。
+ */
+card_err_t card_spi_flash_erase(card_obj_t *obj, const card_spi_flash_t *f, Uint32_t addr, Uint32_t len,
+	card_stream_cb_t cb, void *arg);
+/**
+ * \brief		编程SPI Flash映像
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	f 器件信息
+ * \param[in]	addr 起始地址
+ * \param[in]	image 映像数据
+ * \param[in]	len 映像长度
+ * \param[in]	flags CARD_SPI_FLAG_XXX组合
+ * \param[in]	cb 每页完成后回调，offset和len为本页在映像中的位置，可为NULL
+ * \param[in]	arg 回调函数参数
+ * \param[out]	crc 映像的CRC32，校验时为回读数据的CRC32，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_VERIFY 回读数据与映像不一致
+ * \retval		CARD_ERR_TIMEOUT 编程或擦除超时
+ * \note		CARD_SPI_FLAG_ERASE擦除整个扇区，扇区内映像范围以外的数据同时被擦除。\n
+ *				数据全为0xFF的页不编程。
+ */
+card_err_t card_spi_flash_program(card_obj_t *obj, const card_spi_flash_t *f, Uint32_t addr, const Uint8_t *image,
+	Uint32_t len, Uint8_t flags, card_stream_cb_t cb, void *arg, Uint32_t *crc);
+/**
+ * \brief		读取SPI Flash
+ * \param[out]	rbuf 数据，大小为len
+ * \param[out]	crc 读取数据的CRC32，可为NULL
+ * \note		使用快速读命令(0B)，每条命令读取CARD_SPI_READ_CHUNK字节。
+ * \see			card_spi_flash_program
+ */
+card_err_t card_spi_flash_read(card_obj_t *obj, const card_spi_flash_t *f, Uint32_t addr, Uint8_t *rbuf, Uint32_t len,
+	card_stream_cb_t cb, void *arg, Uint32_t *crc);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			SWD MEM-AP批量读写接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup SWD MEM-AP批量读写接口函数
+ *  \{
+ */
+/**
+ * \brief		通过MEM-AP读取目标内存
+ * \param[in]	obj 卡片对象结构体，已执行card_swd_connect并使能调试电源
+ * \param[in]	ap MEM-AP编号(APSEL)，Cortex-M一般为0
+ * \param[in]	addr 起始地址，4字节对齐
+ * \param[out]	rbuf 数据，小端序，大小为len
+ * \param[in]	len 长度，4的倍数
+ * \param[in]	cb 每1KB段完成后回调，可为NULL
+ * \param[in]	arg 回调函数参数
+ * \param[out]	crc 数据的CRC32，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_SWD_STICKY 重试后仍有粘滞错误
+ * \retval		CARD_ERR_SWD_DPIDR DPIDR的RAO位、设计者或版本无效，未写入任何寄存器
+ * \retval		其他 失败
+ * \note		32位访问，TAR自动递增，每个字一次DRW访问，每1KB重新设置TAR并检查CTRL/STAT。\n
+ *				出错时以card_swd_clr_error清除粘滞错误后重试本段CARD_SWD_RETRIES次。\n
+ *				寄存器地址按CARD_SWD_DP_REG/CARD_SWD_AP_REG编码(APnDP为位0，A[3:2]为位2-3)，
+ *				读写器文档未说明该编码，开始前读CARD_SWD_DP_REG(0)检查DPIDR。
+ */
+card_err_t card_swd_mem_read(card_obj_t *obj, Uint8_t ap, Uint32_t addr, Uint8_t *rbuf, Uint32_t len,
+	card_stream_cb_t cb, void *arg, Uint32_t *crc);
+/**
+ * \brief		通过MEM-AP写入目标内存
+ * \param[in]	tbuf 数据，小端序
+ * \param[in]	flags CARD_SWD_FLAG_XXX组合
+ * \param[out]	crc 数据的CRC32，校验时为回读数据的CRC32，可为NULL
+ * \retval		CARD_ERR_VERIFY 回读数据不一致
+ * \note		用于向RAM装载Flash编程算法和数据块。
+ * \see			card_swd_mem_read
+ */
+card_err_t card_swd_mem_write(card_obj_t *obj, Uint8_t ap, Uint32_t addr, const Uint8_t *tbuf, Uint32_t len,
+	Uint8_t flags, card_stream_cb_t cb, void *arg, Uint32_t *crc);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			错误重试和恢复接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 错误重试和恢复接口函数
+ *  \{
+ */
+/**
+ * \brief		取得错误分类
+ * \param[in]	err 错误代码
+ * \return		CARD_ERR_CLASS_XXX
+ * \note		扩展接口的错误代码(0x3XXX)和卡片状态字错误均为CARD_ERR_CLASS_FATAL。
+ */
+Uint8_t card_err_class(card_err_t err);
+/**
+ * \brief		取得默认重试策略
+ * \param[out]	policy 重试策略
+ * \note		非接触错误重试2次，接触错误重试1次，通信错误重试2次，等待10ms起最大1000ms，
+ *				重新唤醒和重新连接，不重新复位接触卡片，不重放操作。
+ */
+void card_retry_policy_default(card_retry_policy_t *policy);
+/**
+ * \brief		创建错误重试策略对象
+ * \param[out]	r 策略对象
+ * \param[in]	policy 重试策略，NULL为默认策略
+ * \retval		CARD_NO_ERR 成功
+ * \note		一个策略对象可由多个线程同时用于不同的卡片对象，统计为全部卡片对象的合计。
+ */
+card_err_t card_retry_create(card_retry_t **r, const card_retry_policy_t *policy);
+/**
+ * \brief		销毁错误重试策略对象
+ * \param[in]	r 策略对象
+ * \retval		CARD_NO_ERR 成功
+ * \note		不能有正在执行的card_retry_call。
+ */
+card_err_t card_retry_destroy(card_retry_t *r);
+/**
+ * \brief		按策略执行操作，失败时恢复连接或卡片，设置CARD_RETRY_FLAG_REPLAY时再重试
+ * \param[in]	r 策略对象
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	fn 操作函数，设置CARD_RETRY_FLAG_REPLAY时以相同参数再次调用
+ * \param[in]	arg 操作函数参数
+ * \retval		CARD_NO_ERR 成功
+ * \retval		其他 最后一次操作或恢复操作的错误代码
+ * \note		按card_err_class分类，失败后执行恢复操作，重连失败时按指数退避再次重连:\n
+ *				CARD_ERR_CLASS_RF: A型和Mifare卡片WUPA、防冲突和选择，A型卡片SAK支持ISO14443-4时RATS，
+ *				B型卡片WUPB和ATTRIB;\n
+ *				CARD_ERR_CLASS_CARD: 接触卡片card_reset(需要CARD_RETRY_FLAG_RESET);\n
+ *				CARD_ERR_CLASS_LINK: card_close后以原地址card_open_mt并恢复超时设置，再恢复卡片。\n
+ *				默认(未设置CARD_RETRY_FLAG_REPLAY)只恢复一次后返回原错误，不等待、不重新执行fn，
+ *				也不计入重试次数，策略中该类重试次数为0时不恢复。
+ *				设置时按指数退避等待后重新执行，每类错误不超过策略中的重试次数。\n
+ *				只能重放幂等操作: 重新激活或复位后卡片的应用选择和安全状态丢失，
+ *				接收超时(0x1008)或无应答(0x2001)时卡片可能已经执行了命令。
+ */
+card_err_t card_retry_call(card_retry_t *r, card_obj_t *obj, card_async_fn_t fn, void *arg);
+/**
+ * \brief		按策略发送数据到卡片，失败时恢复，设置CARD_RETRY_FLAG_REPLAY时重发
+ * \param[in]	tbuf 发送数据
+ * \param[in]	tlen 发送数据长度
+ * \param[out]	rbuf 应答数据
+ * \param[out]	rlen 应答数据长度
+ * \note		以card_pipe为操作函数调用card_retry_call。默认只恢复不重发，出错返回后由调用者决定是否重发；
+ *				设置CARD_RETRY_FLAG_REPLAY时自动重发，只能用于幂等命令。
+ * \see			card_retry_call
+ */
+card_err_t card_retry_pipe(card_retry_t *r, card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen);
+/**
+ * \brief		取得重试统计
+ * \param[in]	r 策略对象
+ * \param[out]	stat 统计
+ * \retval		CARD_NO_ERR 成功
+ */
+card_err_t card_retry_stat(card_retry_t *r, card_retry_stat_t *stat);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			通信统计接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 通信统计接口函数
+ *  \{
+ */
+/**
+ * \brief		创建通信统计
+ * \param[out]	m 通信统计
+ * \param[in]	max 最大卡片对象个数
+ * \retval		CARD_NO_ERR 成功
+ * \note		每个卡片对象第一次记录时占用一个槽位，槽位用完后新的卡片对象不再统计。
+ */
+card_err_t card_metrics_create(card_metrics_t **m, Uint16_t max);
+/**
+ * \brief		销毁通信统计
+ * \param[in]	m 通信统计
+ * \retval		CARD_NO_ERR 成功
+ */
+card_err_t card_metrics_destroy(card_metrics_t *m);
+/**
+ * \brief		删除卡片对象的统计并释放槽位
+ * \param[in]	m 通信统计
+ * \param[in]	obj 卡片对象结构体
+ * \retval		CARD_NO_ERR 成功
+ * \retval		0x3007 没有该卡片对象的统计
+ * \note		卡片对象不再使用时调用，不能与该卡片对象的记录同时执行。
+ */
+card_err_t card_metrics_remove(card_metrics_t *m, const card_obj_t *obj);
+/**
+ * \brief		记录一条命令
+ * \param[in]	m 通信统计，NULL时不记录
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	cmd 命令编号 CARD_CMD_XXX
+ * \param[in]	err 命令返回的错误代码
+ * \param[in]	tx 发送字节数
+ * \param[in]	rx 接收字节数
+ * \param[in]	us 耗时 单位微秒
+ * \note		只在第一次记录占用槽位时加锁，其余只使用原子操作，可由多个线程同时调用。计数按64位累加。
+ */
+void card_metrics_record(card_metrics_t *m, const card_obj_t *obj, Uint8_t cmd, card_err_t err,
+	Uint32_t tx, Uint32_t rx, Uint32_t us);
+/**
+ * \brief		记录一次重连
+ * \param[in]	m 通信统计，NULL时不记录
+ * \param[in]	obj 重新打开后的卡片对象结构体
+ * \note		同时更新统计中的句柄。
+ */
+void card_metrics_reconnect(card_metrics_t *m, const card_obj_t *obj);
+/**
+ * \brief		执行操作并记录耗时
+ * \param[in]	m 通信统计
+ * \param[in]	obj 卡片对象结构体
+ * \param[in]	cmd 记录的命令编号 CARD_CMD_XXX
+ * \param[in]	fn 操作函数
+ * \param[in]	arg 操作函数参数
+ * \return		操作函数的返回值
+ * \note		不记录收发字节数。
+ */
+card_err_t card_metrics_call(card_metrics_t *m, card_obj_t *obj, Uint8_t cmd, card_async_fn_t fn, void *arg);
+/**
+ * \brief		发送数据到卡片并记录
+ * \see			card_pipe card_metrics_record
+ */
+card_err_t card_metrics_pipe(card_metrics_t *m, card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen);
+/**
+ * \brief		复位卡片并记录，接收字节数为ATR长度
+ * \see			card_reset card_metrics_record
+ */
+card_err_t card_metrics_reset(card_metrics_t *m, card_obj_t *obj);
+/**
+ * \brief		REQA并记录
+ * \see			card_reqa card_metrics_record
+ */
+card_err_t card_metrics_reqa(card_metrics_t *m, card_obj_t *obj, Uint16_t *atqa);
+/**
+ * \brief		运行内部写卡并记录，发送和接收字节数为用户数据和输出信息长度
+ * \see			ea_card_runpre card_metrics_record
+ */
+card_err_t card_metrics_runpre(card_metrics_t *m, card_obj_t *obj, Uint8_t *user_data, Uint32_t user_data_len,
+	Uint8_t *output_info, Uint32_t *output_info_len);
+/**
+ * \brief		取得卡片对象的统计
+ * \param[in]	m 通信统计
+ * \param[in]	obj 卡片对象结构体
+ * \param[out]	stats 统计
+ * \retval		CARD_NO_ERR 成功
+ * \retval		0x3007 没有该卡片对象的统计
+ * \note		各项分别读取，与同时进行的记录之间不保证一致。
+ */
+card_err_t card_get_stats(card_metrics_t *m, const card_obj_t *obj, card_stats_t *stats);
+/**
+ * \brief		导出全部卡片对象的统计
+ * \param[in]	m 通信统计
+ * \param[in]	fmt 格式 CARD_METRICS_FMT_XXX
+ * \param[out]	buf 文本缓存，以0结束，可为NULL
+ * \param[in]	size 缓存大小
+ * \param[out]	len 文本长度(不含结束符)，缓存不足时为需要的长度减1，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_BUF_SMALL 缓存不足
+ * \note		Prometheus格式的指标为card_cmd_latency_seconds(直方图)、card_cmd_errors_total、
+ *				card_errors_total、card_bytes_sent_total、card_bytes_received_total和card_reconnects_total，
+ *				标签为addr、model以及cmd或class，只输出执行过的命令。\n
+ *				JSON格式为{"readers":[{addr,model,handle,tx_bytes,rx_bytes,reconnects,errors,commands}]}，
+ *				commands中buckets为非累计的直方图，耗时单位为微秒。
+ */
+card_err_t card_metrics_export(card_metrics_t *m, Uint8_t fmt, Uint8_t *buf, Uint32_t size, Uint32_t *len);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			卡片插拔监视接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 卡片插拔监视接口函数
+ *  \{
+ */
+/**
+ * \brief		创建卡片插拔监视器
+ * \param[out]	w 监视器
+ * \param[in]	interval_ms 每个卡片对象的探测间隔 单位毫秒，0使用CARD_WATCH_DEFAULT_INTERVAL
+ * \param[in]	cb 事件回调函数，在内部线程中调用，NULL时事件放入队列
+ * \param[in]	arg 回调函数参数
+ * \retval		CARD_NO_ERR 成功
+ * \note		一个监视器使用一个内部线程，依次探测全部卡片对象，探测间隔对每个对象单独计算。\n
+ *				探测时卡片对象的超时临时改为CARD_WATCH_PROBE_TIMEOUT，无应答的读写器使其他对象的事件
+ *				最多延迟(无应答对象个数 x CARD_WATCH_PROBE_TIMEOUT)，对延迟敏感时每个读写器使用单独的监视器。\n
+ *				cb为NULL时通过card_watch_fd(Windows为card_watch_event)等待，再调用card_watch_poll取出事件，
+ *				一个线程可用epoll同时等待多个监视器和其他文件描述符。
+ */
+card_err_t card_watch_create(card_watch_t **w, Uint32_t interval_ms, card_watch_cb_t cb, void *arg);
+/**
+ * \brief		销毁卡片插拔监视器
+ * \param[in]	w 监视器
+ * \retval		CARD_NO_ERR 成功
+ * \note		不关闭卡片对象。
+ */
+card_err_t card_watch_destroy(card_watch_t *w);
+/**
+ * \brief		添加卡片对象
+ * \param[in]	w 监视器
+ * \param[in]	obj 已打开的卡片对象结构体
+ * \param[in]	arg 用户参数，随事件返回
+ * \param[out]	id 编号，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		CARD_ERR_POOL_FULL 已达CARD_WATCH_MAX
+ * \note		探测方式按卡片模式选择: ISO14443A/MIFARE为WUPA后HALTA，ISO14443B为WUPB后HALTB，
+ *				ISO15693为不带STAY QUIET的单时隙INVENTORY(卡片保持就绪状态)，
+ *				其他模式为card_getdetect。\n
+ *				监视期间内部线程使用该对象，调用者使用前需card_watch_pause。\n
+ *				添加时已存在的卡片产生CARD_WATCH_INSERT事件。通信错误恢复后与上次报告的状态比较，
+ *				错误期间拔出的卡片产生CARD_WATCH_REMOVE事件。
+ */
+card_err_t card_watch_add(card_watch_t *w, card_obj_t *obj, void *arg, Uint16_t *id);
+/**
+ * \brief		暂停或恢复探测卡片对象
+ * \param[in]	w 监视器
+ * \param[in]	id 编号
+ * \param[in]	pause 1:暂停 0:恢复
+ * \retval		CARD_NO_ERR 成功
+ * \note		返回时该对象的探测已结束，调用者可直接操作卡片。恢复后立即探测，
+ *				收到CARD_WATCH_INSERT后应暂停，操作完成并暂停(HALT)或下电卡片后再恢复，以检测拔出。
+ */
+card_err_t card_watch_pause(card_watch_t *w, Uint16_t id, Uint8_t pause);
+/**
+ * \brief		移除卡片对象
+ * \param[in]	w 监视器
+ * \param[in]	id 编号
+ * \retval		CARD_NO_ERR 成功
+ * \note		返回时该对象的探测已结束，不关闭卡片对象。
+ */
+card_err_t card_watch_remove(card_watch_t *w, Uint16_t id);
+#ifdef WIN32
+/**
+ * \brief		获取事件通知句柄
+ * \param[in]	w 监视器
+ * \retval		事件句柄(HANDLE)，有事件时为有信号状态
+ */
+void *card_watch_event(card_watch_t *w);
+#else
+/**
+ * \brief		获取事件通知文件描述符
+ * \param[in]	w 监视器
+ * \retval		文件描述符，有事件时可读
+ */
+int card_watch_fd(card_watch_t *w);
+#endif
+/**
+ * \brief		取出事件
+ * \param[in]	w 监视器
+ * \param[out]	evts 事件数组
+ * \param[in]	max 事件数组长度
+ * \param[out]	count 取出的事件个数，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \note		不阻塞。仍有事件未取出时通知保持可读。\n
+ *				通信错误只报告一次，恢复后按当时的卡片状态重新报告CARD_WATCH_INSERT。
+ */
+card_err_t card_watch_poll(card_watch_t *w, card_watch_evt_t *evts, Uint16_t max, Uint16_t *count);
+/**
+ *  \}
+ */
+/*---------------------------------------------------------
+			读写器模拟器接口函数
+ ---------------------------------------------------------*/
+/**\addtogroup 读写器模拟器接口函数
+ *  \{
+ */
+/**
+ * \brief		创建读写器模拟器
+ * \param[out]	sim 读写器模拟器
+ * \param[in]	addr 监听IP地址，为NULL时使用"127.0.0.1"
+ * \param[in]	cfg 延时和错误注入配置，可为NULL
+ * \retval		CARD_NO_ERR 成功
+ * \retval		0x4004 监听端口失败
+ * \note		驱动库固定连接CARD_SIM_PORT端口，多个模拟器使用不同的本机地址，如127.0.0.1、127.0.0.2。\n
+ *				创建后为无卡状态，调用card_sim_insert放入卡片。\n
+ *				内部线程按顺序执行全部连接的命令，注入的延时按连接计时，到期后发送应答，
+ *				延时期间继续处理其他连接的命令，同一连接的下一条命令在应答发送后接收。\n
+ *				错误注入只作用于卡片命令，不影响card_open等读写器命令。
+ */
+card_err_t card_sim_create(card_sim_t **sim, Uint8_t *addr, const card_sim_cfg_t *cfg);
+/**
+ * \brief		销毁读写器模拟器，断开全部连接
+ * \param[in]	sim 读写器模拟器
+ * \retval		CARD_NO_ERR 成功
+ */
+card_err_t card_sim_destroy(card_sim_t *sim);
+/**
+ * \brief		放入新卡片
+ * \param[in]	sim 读写器模拟器
+ * \param[in]	card 卡片类型，CARD_SIM_NONE为取出卡片
+ * \retval		CARD_NO_ERR 成功
+ * \note		卡片内容为出厂状态: MIFARE密钥全0xFF，EEPROM、Flash和ISO15693标签数据全0xFF，UID由随机数种子生成。
+ */
+card_err_t card_sim_insert(card_sim_t *sim, card_sim_card_t card);
+/**
+ * \brief		修改延时和错误注入配置
+ * \param[in]	sim 读写器模拟器
+ * \param[in]	cfg 配置，port和seed不修改
+ * \retval		CARD_NO_ERR 成功
+ */
+card_err_t card_sim_config(card_sim_t *sim, const card_sim_cfg_t *cfg);
+/**
+ * \brief		获取已处理的命令个数
+ * \param[in]	sim 读写器模拟器
+ * \retval		命令个数
+ */
+Uint32_t card_sim_count(card_sim_t *sim);
+/**
+ *  \}
+ */
+#ifdef __cplusplus
+}
+#endif
+
+#endif
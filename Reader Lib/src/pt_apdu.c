@@ -0,0 +1,363 @@
+/**
+ * \file	pt_apdu.c
+ * \brief	扩展长度APDU和分散缓存接收接口函数
+ * \details	card_pipe应答直接写入调用者缓存且不检查长度，这里使用内部缓存接收后按分散缓存复制。
+ *			T=1和ISO14443-4的分块链接由读写器完成，单条APDU命令和应答最长为card_pipe长度上限。
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+static Uint32_t iov_size(const card_iov_t *iov, Uint32_t iov_cnt)
+{
+	Uint32_t i, size = 0;
+
+	for (i = 0; i < iov_cnt; i++)
+		size += iov[i].len;
+	return size;
+}
+
+/* 从分散缓存的pos位置开始复制，返回实际复制长度 */
+static Uint32_t iov_put(const card_iov_t *iov, Uint32_t iov_cnt, Uint32_t pos, const Uint8_t *data, Uint32_t len)
+{
+	Uint32_t i, n, done = 0;
+
+	for (i = 0; i < iov_cnt && done < len; i++) {
+		if (pos >= iov[i].len) {
+			pos -= iov[i].len;
+			continue;
+		}
+		n = iov[i].len - pos;
+		if (n > len - done)
+			n = len - done;
+		memcpy(iov[i].buf + pos, data + done, n);
+		done += n;
+		pos = 0;
+	}
+	return done;
+}
+
+card_err_t card_pipe_iov(card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, const card_iov_t *iov, Uint32_t iov_cnt, Uint32_t *rlen)
+{
+	Uint8_t *rbuf;
+	Uint16_t len = 0;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (tbuf == NULL || tlen == 0 || rlen == NULL || (iov == NULL && iov_cnt > 0)) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	rbuf = (Uint8_t *)malloc(CARD_APDU_RESP_MAX);
+	if (rbuf == NULL) {
+		obj->last_err = 0x4012;
+		return obj->last_err;
+	}
+
+	*rlen = 0;
+	ret = card_pipe(obj, tbuf, tlen, rbuf, &len);
+	if (ret == CARD_NO_ERR && len >= 2) {
+		len -= 2;
+		*rlen = len;
+		if (iov_put(iov, iov_cnt, 0, rbuf, len) < len) {
+			ret = CARD_ERR_BUF_SMALL;
+			obj->last_err = ret;
+		}
+	}
+
+	free(rbuf);
+	return ret;
+}
+
+/* 奇数INS应答为偏移数据对象53，取出其中数据 */
+static Uint16_t strip_do53(Uint8_t *rbuf, Uint16_t len)
+{
+	Uint32_t vlen, hlen;
+
+	if (len < 2 || rbuf[0] != 0x53)
+		return 0;
+	if (rbuf[1] < 0x80) {
+		vlen = rbuf[1];
+		hlen = 2;
+	} else if (rbuf[1] == 0x81 && len >= 3) {
+		vlen = rbuf[2];
+		hlen = 3;
+	} else if (rbuf[1] == 0x82 && len >= 4) {
+		vlen = ((Uint32_t)rbuf[2] << 8) | rbuf[3];
+		hlen = 4;
+	} else {
+		return 0;
+	}
+	if (hlen + vlen > len)
+		vlen = len - hlen;
+	memmove(rbuf, rbuf + hlen, vlen);
+	return (Uint16_t)vlen;
+}
+
+/* 组装READ BINARY命令，偏移超过15位时使用奇数INS */
+/* GET RESPONSE使用行业间CLA，保留逻辑通道 */
+static Uint8_t resp_cla(Uint8_t cla)
+{
+	if (cla & 0x80)
+		return 0x00;
+	return (Uint8_t)(cla & ((cla & 0x40) ? 0x4F : 0x03));
+}
+
+static Uint16_t build_read(Uint8_t *cmd, Uint8_t cla, Uint32_t offset, Uint32_t le)
+{
+	Uint16_t n = 0;
+
+	cmd[n++] = cla;
+	if (offset <= 0x7FFF) {
+		cmd[n++] = 0xB0;
+		cmd[n++] = (Uint8_t)(offset >> 8);
+		cmd[n++] = (Uint8_t)offset;
+		if (le > 256) {
+			cmd[n++] = 0x00;
+			cmd[n++] = (Uint8_t)(le >> 8);
+			cmd[n++] = (Uint8_t)le;
+		} else {
+			cmd[n++] = (Uint8_t)le;
+		}
+		return n;
+	}
+
+	cmd[n++] = 0xB1;
+	cmd[n++] = 0x00;
+	cmd[n++] = 0x00;
+	if (le > 256) {
+		cmd[n++] = 0x00;
+		cmd[n++] = 0x00;
+	}
+	cmd[n++] = 0x05;
+	cmd[n++] = 0x54;
+	cmd[n++] = 0x03;
+	cmd[n++] = (Uint8_t)(offset >> 16);
+	cmd[n++] = (Uint8_t)(offset >> 8);
+	cmd[n++] = (Uint8_t)offset;
+	if (le > 256) {
+		cmd[n++] = (Uint8_t)(le >> 8);
+		cmd[n++] = (Uint8_t)le;
+	} else {
+		cmd[n++] = (Uint8_t)le;
+	}
+	return n;
+}
+
+card_err_t card_read_binary(card_obj_t *obj, Uint8_t cla, Uint32_t offset, Uint32_t len, Uint16_t chunk,
+	const card_iov_t *iov, Uint32_t iov_cnt, card_stream_cb_t cb, void *arg, Uint32_t *rlen)
+{
+	Uint8_t cmd[16], *rbuf;
+	Uint16_t clen, n, glen;
+	Uint32_t cap, pos = 0, want, le;
+	card_err_t ret = CARD_NO_ERR;
+	int odd, rele = 0;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (iov == NULL || iov_cnt == 0 || rlen == NULL || offset > 0xFFFFFF) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	if (chunk == 0 || chunk > CARD_READ_CHUNK_MAX)
+		chunk = CARD_READ_CHUNK_MAX;
+	cap = iov_size(iov, iov_cnt);
+	if (len == 0 || len > cap)
+		want = cap;
+	else
+		want = len;
+	rbuf = (Uint8_t *)malloc(CARD_APDU_RESP_MAX);
+	if (rbuf == NULL) {
+		obj->last_err = 0x4012;
+		return obj->last_err;
+	}
+
+	*rlen = 0;
+	le = 0;
+	while (pos < want) {
+		if (le == 0)
+			le = want - pos < chunk ? want - pos : chunk;
+		odd = offset + pos > 0x7FFF;
+		clen = build_read(cmd, cla, offset + pos, le);
+		n = 0;
+		ret = card_pipe(obj, cmd, clen, rbuf, &n);
+		if (ret != CARD_NO_ERR)
+			break;
+		if (n < 2) {
+			ret = 0x2006;
+			obj->last_err = ret;
+			break;
+		}
+		n -= 2;
+
+		if (n == 0 && le > 256 && obj->sw1 == 0x67) {
+			/* 卡片不支持扩展长度，改为短长度 */
+			chunk = 256;
+			le = 0;
+			continue;
+		}
+		if (n == 0 && le <= 256 && obj->sw1 == 0x6C && !rele) {
+			/* Le错误，按卡片给出的长度重发，每段只重发一次 */
+			le = obj->sw2 != 0 ? obj->sw2 : 256;
+			rele = 1;
+			continue;
+		}
+		/* T=0卡片剩余数据用GET RESPONSE取回 */
+		while (obj->sw1 == 0x61 && n + 258 <= CARD_APDU_RESP_MAX) {
+			cmd[0] = resp_cla(cla);
+			cmd[1] = 0xC0;
+			cmd[2] = 0x00;
+			cmd[3] = 0x00;
+			cmd[4] = obj->sw2;
+			glen = 0;
+			ret = card_pipe(obj, cmd, 5, rbuf + n, &glen);
+			if (ret != CARD_NO_ERR)
+				break;
+			if (glen < 2) {
+				ret = 0x2006;
+				obj->last_err = ret;
+				break;
+			}
+			n = (Uint16_t)(n + glen - 2);
+		}
+		if (ret != CARD_NO_ERR)
+			break;
+		if (pos > 0 && ((obj->sw1 == 0x6B && obj->sw2 == 0x00) || (obj->sw1 == 0x6A && (obj->sw2 == 0x82 || obj->sw2 == 0x86))))
+			break;	/* 偏移超出文件，已读到文件尾 */
+		if (!(obj->sw1 == 0x90 && obj->sw2 == 0x00) && !(obj->sw1 == 0x62 && obj->sw2 == 0x82)) {
+			ret = CARD_ERR_SW_UNEXPECTED;
+			obj->last_err = ret;
+			break;
+		}
+		if (odd)
+			n = strip_do53(rbuf, n);
+		if (n > want - pos)
+			n = (Uint16_t)(want - pos);
+		iov_put(iov, iov_cnt, pos, rbuf, n);
+		if (cb != NULL && n > 0)
+			cb(arg, pos, n);
+		pos += n;
+		le = 0;
+		rele = 0;
+		/* 文件结束 */
+		if (n == 0 || obj->sw1 == 0x62)
+			break;
+	}
+
+	*rlen = pos;
+	free(rbuf);
+	return ret;
+}
+
+static void stat_add(card_xchg_stat_t *stat, Uint32_t time_us)
+{
+	if (stat == NULL)
+		return;
+	if (stat->count < CARD_XCHG_TIME_MAX)
+		stat->time_us[stat->count] = time_us;
+	stat->count++;
+	stat->total_us += time_us;
+}
+
+card_err_t card_pipe_chain(card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint32_t rsize, Uint32_t *rlen,
+	Uint16_t max_xchg, card_xchg_stat_t *stat)
+{
+	Uint8_t *cmd, *buf;
+	Uint16_t clen, n, xchg = 0;
+	Uint32_t pos = 0, copy;
+	int rele = 0;
+	unsigned long long start;
+	card_err_t ret = CARD_NO_ERR;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (tbuf == NULL || tlen < 4 || rbuf == NULL || rsize < 2 || rlen == NULL) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	if (stat != NULL)
+		memset(stat, 0, sizeof(*stat));
+	cmd = (Uint8_t *)malloc((Uint32_t)tlen + 1);
+	buf = (Uint8_t *)malloc(CARD_APDU_RESP_MAX);
+	if (cmd == NULL || buf == NULL) {
+		free(cmd);
+		free(buf);
+		obj->last_err = 0x4012;
+		return obj->last_err;
+	}
+	memcpy(cmd, tbuf, tlen);
+	clen = tlen;
+
+	*rlen = 0;
+	for (;;) {
+		if (max_xchg != 0 && xchg >= max_xchg) {
+			ret = CARD_ERR_XCHG_LIMIT;
+			obj->last_err = ret;
+			break;
+		}
+		n = 0;
+		start = pt_os_time_us();
+		ret = card_pipe(obj, cmd, clen, buf, &n);
+		stat_add(stat, (Uint32_t)(pt_os_time_us() - start));
+		xchg++;
+		if (ret != CARD_NO_ERR)
+			break;
+		if (n < 2) {
+			ret = 0x2006;
+			obj->last_err = ret;
+			break;
+		}
+		n -= 2;
+
+		if (obj->sw1 == 0x6C && n == 0 && !rele && (clen <= 5 || cmd[4] != 0)) {
+			/* 用卡片给出的Le重发当前命令，每条命令只重发一次 */
+			if (clen == 5 || (clen > 5 && clen == 6 + cmd[4]))
+				cmd[clen - 1] = obj->sw2;
+			else
+				cmd[clen++] = obj->sw2;
+			rele = 1;
+			if (stat != NULL)
+				stat->rele++;
+			continue;
+		}
+
+		/* 累计本次应答数据 */
+		copy = pos < rsize - 2 ? rsize - 2 - pos : 0;
+		if (copy > n)
+			copy = n;
+		memcpy(rbuf + pos, buf, copy);
+		pos += n;
+		if (obj->sw1 != 0x61)
+			break;
+
+		cmd[0] = resp_cla(tbuf[0]);
+		cmd[1] = 0xC0;
+		cmd[2] = 0x00;
+		cmd[3] = 0x00;
+		cmd[4] = obj->sw2;
+		clen = 5;
+		rele = 0;
+		if (stat != NULL)
+			stat->resp++;
+	}
+
+	if (ret == CARD_NO_ERR || ret == CARD_ERR_XCHG_LIMIT) {
+		/* 应答末尾为最后一次的状态字，与card_pipe相同 */
+		*rlen = pos + 2;
+		if (pos > rsize - 2) {
+			pos = rsize - 2;
+			if (ret == CARD_NO_ERR) {
+				ret = CARD_ERR_BUF_SMALL;
+				obj->last_err = ret;
+			}
+		}
+		rbuf[pos] = obj->sw1;
+		rbuf[pos + 1] = obj->sw2;
+	}
+
+	free(cmd);
+	free(buf);
+	return ret;
+}
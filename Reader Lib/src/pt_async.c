@@ -0,0 +1,452 @@
+/**
+ * \file	pt_async.c
+ * \brief	异步接口函数
+ * \details	不是事件循环：每个读卡器（异步上下文）对应一个内部线程，
+ *			在该线程中按提交顺序调用原有的阻塞接口，驱动库和连接本身仍是同步的。
+ *			完成信息放入完成队列，并通过可poll的完成通知（Linux为管道fd，Windows为事件）
+ *			唤醒调用线程；N个读卡器需要N个线程。
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+/* 请求类型 */
+enum {
+	ASYNC_OP_RESET = 1,
+	ASYNC_OP_WARM_RESET,
+	ASYNC_OP_OFF,
+	ASYNC_OP_PIPE,
+	ASYNC_OP_PIPE_BATCH,
+	ASYNC_OP_REQA,
+	ASYNC_OP_WUPA,
+	ASYNC_OP_RATS,
+	ASYNC_OP_I2C_WRITE_READ,
+	ASYNC_OP_SPI_WRITE_READ,
+	ASYNC_OP_CALL,
+	ASYNC_OP_RUNPRE,
+	ASYNC_OP_RUNPRE_BATCH,
+};
+
+typedef struct async_op {
+	Uint8_t type;
+	card_req_t req;
+	card_async_cb_t cb;
+	void *arg;
+	card_err_t err;
+	Uint32_t time_us;
+	union {
+		struct {
+			Uint8_t *tbuf;
+			Uint16_t tlen;
+			Uint8_t *rbuf;
+			Uint16_t *rlen;
+			Uint16_t address;
+		} xfer;
+		struct {
+			const card_apdu_t *cmds;
+			Uint16_t n;
+			card_apdu_res_t *results;
+			Uint8_t flags;
+		} batch;
+		struct {
+			card_async_fn_t fn;
+			void *fn_arg;
+		} call;
+		struct {
+			card_runpre_rec_t *recs;
+			Uint16_t n;
+			Uint8_t flags;
+			card_runpre_cb_t cb;
+			void *arg;
+		} runpre;
+		Uint16_t *atqa;
+	} u;
+} async_op_t;
+
+/* 环形队列 */
+typedef struct async_ring {
+	async_op_t *ops;
+	Uint16_t head;
+	Uint16_t count;
+} async_ring_t;
+
+struct card_async {
+	card_obj_t *obj;
+	Uint16_t depth;
+	Uint16_t outstanding;		/* 已提交但未被poll取出的请求个数 */
+	card_req_t next_req;
+	int stop;
+	async_ring_t pending;
+	async_ring_t done;
+	pt_mutex_t lock;
+	pt_cond_t cond;
+	pt_notify_t notify;
+	pt_thread_t thread;
+};
+
+static void ring_push(async_ring_t *ring, Uint16_t depth, const async_op_t *op)
+{
+	ring->ops[(ring->head + ring->count) % depth] = *op;
+	ring->count++;
+}
+
+static void ring_pop(async_ring_t *ring, Uint16_t depth, async_op_t *op)
+{
+	*op = ring->ops[ring->head];
+	ring->head = (Uint16_t)((ring->head + 1) % depth);
+	ring->count--;
+}
+
+static card_err_t async_execute(card_obj_t *obj, async_op_t *op)
+{
+	switch (op->type) {
+	case ASYNC_OP_RESET:
+		return card_reset(obj);
+	case ASYNC_OP_WARM_RESET:
+		return card_warm_reset(obj);
+	case ASYNC_OP_OFF:
+		return card_off(obj);
+	case ASYNC_OP_PIPE:
+		return card_pipe(obj, op->u.xfer.tbuf, op->u.xfer.tlen, op->u.xfer.rbuf, op->u.xfer.rlen);
+	case ASYNC_OP_PIPE_BATCH:
+		return card_pipe_batch(obj, op->u.batch.cmds, op->u.batch.n, op->u.batch.results, op->u.batch.flags);
+	case ASYNC_OP_REQA:
+		return card_reqa(obj, op->u.atqa);
+	case ASYNC_OP_WUPA:
+		return card_wupa(obj, op->u.atqa);
+	case ASYNC_OP_RATS:
+		return card_rats(obj, op->u.xfer.rbuf, op->u.xfer.rlen);
+	case ASYNC_OP_I2C_WRITE_READ:
+		return card_i2c_write_read(obj, op->u.xfer.address, op->u.xfer.tbuf, op->u.xfer.tlen, op->u.xfer.rbuf, op->u.xfer.rlen);
+	case ASYNC_OP_SPI_WRITE_READ:
+		return card_spi_write_read(obj, op->u.xfer.tbuf, op->u.xfer.tlen, op->u.xfer.rbuf, op->u.xfer.rlen);
+	case ASYNC_OP_CALL:
+		return op->u.call.fn(obj, op->u.call.fn_arg);
+	case ASYNC_OP_RUNPRE:
+	case ASYNC_OP_RUNPRE_BATCH:
+		return card_runpre_batch(obj, op->u.runpre.recs, op->u.runpre.n, op->u.runpre.flags, op->u.runpre.cb, op->u.runpre.arg);
+	default:
+		return 0x3007;
+	}
+}
+
+static void async_worker(void *p)
+{
+	card_async_t *ctx = (card_async_t *)p;
+	async_op_t op;
+	unsigned long long start;
+
+	pt_mutex_lock(&ctx->lock);
+	for (;;) {
+		while (!ctx->stop && ctx->pending.count == 0)
+			pt_cond_wait(&ctx->cond, &ctx->lock);
+		if (ctx->stop)
+			break;
+		ring_pop(&ctx->pending, ctx->depth, &op);
+		pt_mutex_unlock(&ctx->lock);
+
+		start = pt_os_time_us();
+		op.err = async_execute(ctx->obj, &op);
+		op.time_us = (Uint32_t)(pt_os_time_us() - start);
+
+		pt_mutex_lock(&ctx->lock);
+		ring_push(&ctx->done, ctx->depth, &op);
+		pt_notify_set(&ctx->notify);
+	}
+	pt_mutex_unlock(&ctx->lock);
+}
+
+static card_err_t async_submit(card_async_t *ctx, async_op_t *op, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	if (ctx == NULL)
+		return 0x3007;
+
+	op->cb = cb;
+	op->arg = arg;
+	op->err = CARD_ERR_NOT_EXECUTED;
+	op->time_us = 0;
+
+	pt_mutex_lock(&ctx->lock);
+	if (ctx->outstanding >= ctx->depth) {
+		pt_mutex_unlock(&ctx->lock);
+		return CARD_ERR_QUEUE_FULL;
+	}
+	/* 请求句柄从1开始，0保留 */
+	if (++ctx->next_req == 0)
+		ctx->next_req = 1;
+	op->req = ctx->next_req;
+	ring_push(&ctx->pending, ctx->depth, op);
+	ctx->outstanding++;
+	pt_cond_broadcast(&ctx->cond);
+	pt_mutex_unlock(&ctx->lock);
+
+	if (req != NULL)
+		*req = op->req;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_async_create(card_async_t **ctx, card_obj_t *obj, Uint16_t depth)
+{
+	card_async_t *c;
+
+	if (ctx == NULL || obj == NULL)
+		return 0x3007;
+	if (depth == 0)
+		depth = CARD_ASYNC_DEFAULT_DEPTH;
+
+	c = (card_async_t *)calloc(1, sizeof(card_async_t));
+	if (c == NULL)
+		return 0x4012;
+	c->obj = obj;
+	c->depth = depth;
+	c->pending.ops = (async_op_t *)calloc(depth, sizeof(async_op_t));
+	c->done.ops = (async_op_t *)calloc(depth, sizeof(async_op_t));
+	if (c->pending.ops == NULL || c->done.ops == NULL)
+		goto err_free;
+	if (pt_notify_init(&c->notify) != 0)
+		goto err_free;
+	pt_mutex_init(&c->lock);
+	pt_cond_init(&c->cond);
+	if (pt_thread_create(&c->thread, async_worker, c) != 0) {
+		pt_cond_destroy(&c->cond);
+		pt_mutex_destroy(&c->lock);
+		pt_notify_destroy(&c->notify);
+		goto err_free;
+	}
+
+	*ctx = c;
+	return CARD_NO_ERR;
+
+err_free:
+	free(c->pending.ops);
+	free(c->done.ops);
+	free(c);
+	return 0x4012;
+}
+
+card_err_t card_async_destroy(card_async_t *ctx)
+{
+	if (ctx == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&ctx->lock);
+	ctx->stop = 1;
+	pt_cond_broadcast(&ctx->cond);
+	pt_mutex_unlock(&ctx->lock);
+	pt_thread_join(ctx->thread);
+
+	pt_cond_destroy(&ctx->cond);
+	pt_mutex_destroy(&ctx->lock);
+	pt_notify_destroy(&ctx->notify);
+	free(ctx->pending.ops);
+	free(ctx->done.ops);
+	free(ctx);
+	return CARD_NO_ERR;
+}
+
+#ifdef WIN32
+void *card_async_event(card_async_t *ctx)
+{
+	return ctx == NULL ? NULL : (void *)ctx->notify;
+}
+#else
+int card_async_fd(card_async_t *ctx)
+{
+	return ctx == NULL ? -1 : ctx->notify.fds[0];
+}
+#endif
+
+card_err_t card_async_poll(card_async_t *ctx, card_async_done_t *done, Uint16_t max, Uint16_t *count)
+{
+	async_op_t op;
+	Uint16_t n = 0;
+
+	if (ctx == NULL)
+		return 0x3007;
+
+	pt_notify_clear(&ctx->notify);
+	for (;;) {
+		pt_mutex_lock(&ctx->lock);
+		if (ctx->done.count == 0) {
+			pt_mutex_unlock(&ctx->lock);
+			break;
+		}
+		/* 无回调的请求需写入done数组，数组已满时保留在队列中 */
+		if (ctx->done.ops[ctx->done.head].cb == NULL && (done == NULL || n >= max)) {
+			pt_notify_set(&ctx->notify);
+			pt_mutex_unlock(&ctx->lock);
+			break;
+		}
+		ring_pop(&ctx->done, ctx->depth, &op);
+		ctx->outstanding--;
+		pt_mutex_unlock(&ctx->lock);
+
+		if (op.cb != NULL) {
+			op.cb(ctx, op.req, op.err, op.arg);
+		} else {
+			done[n].req = op.req;
+			done[n].err = op.err;
+			done[n].time_us = op.time_us;
+			done[n].arg = op.arg;
+			n++;
+		}
+	}
+
+	if (count != NULL)
+		*count = n;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_submit_reset(card_async_t *ctx, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_RESET;
+	return async_submit(ctx, &op, cb, arg, req);
+}
+
+card_err_t card_submit_warm_reset(card_async_t *ctx, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_WARM_RESET;
+	return async_submit(ctx, &op, cb, arg, req);
+}
+
+card_err_t card_submit_off(card_async_t *ctx, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_OFF;
+	return async_submit(ctx, &op, cb, arg, req);
+}
+
+card_err_t card_submit_pipe(card_async_t *ctx, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_PIPE;
+	op.u.xfer.tbuf = tbuf;
+	op.u.xfer.tlen = tlen;
+	op.u.xfer.rbuf = rbuf;
+	op.u.xfer.rlen = rlen;
+	return async_submit(ctx, &op, cb, arg, req);
+}
+
+card_err_t card_submit_pipe_batch(card_async_t *ctx, const card_apdu_t *cmds, Uint16_t n, card_apdu_res_t *results, Uint8_t flags, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_PIPE_BATCH;
+	op.u.batch.cmds = cmds;
+	op.u.batch.n = n;
+	op.u.batch.results = results;
+	op.u.batch.flags = flags;
+	return async_submit(ctx, &op, cb, arg, req);
+}
+
+card_err_t card_submit_reqa(card_async_t *ctx, Uint16_t *atqa, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_REQA;
+	op.u.atqa = atqa;
+	return async_submit(ctx, &op, cb, arg, req);
+}
+
+card_err_t card_submit_wupa(card_async_t *ctx, Uint16_t *atqa, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_WUPA;
+	op.u.atqa = atqa;
+	return async_submit(ctx, &op, cb, arg, req);
+}
+
+card_err_t card_submit_rats(card_async_t *ctx, Uint8_t *ats, Uint16_t *ats_len, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_RATS;
+	op.u.xfer.rbuf = ats;
+	op.u.xfer.rlen = ats_len;
+	return async_submit(ctx, &op, cb, arg, req);
+}
+
+card_err_t card_submit_i2c_write_read(card_async_t *ctx, Uint16_t address, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_I2C_WRITE_READ;
+	op.u.xfer.address = address;
+	op.u.xfer.tbuf = tbuf;
+	op.u.xfer.tlen = tlen;
+	op.u.xfer.rbuf = rbuf;
+	op.u.xfer.rlen = rlen;
+	return async_submit(ctx, &op, cb, arg, req);
+}
+
+card_err_t card_submit_spi_write_read(card_async_t *ctx, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_SPI_WRITE_READ;
+	op.u.xfer.tbuf = tbuf;
+	op.u.xfer.tlen = tlen;
+	op.u.xfer.rbuf = rbuf;
+	op.u.xfer.rlen = rlen;
+	return async_submit(ctx, &op, cb, arg, req);
+}
+
+card_err_t card_submit_call(card_async_t *ctx, card_async_fn_t fn, void *fn_arg, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	if (fn == NULL)
+		return 0x3007;
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_CALL;
+	op.u.call.fn = fn;
+	op.u.call.fn_arg = fn_arg;
+	return async_submit(ctx, &op, cb, arg, req);
+}
+
+card_err_t card_submit_runpre(card_async_t *ctx, card_runpre_rec_t *rec, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	if (rec == NULL)
+		return 0x3007;
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_RUNPRE;
+	op.u.runpre.recs = rec;
+	op.u.runpre.n = 1;
+	return async_submit(ctx, &op, cb, arg, req);
+}
+
+card_err_t card_submit_runpre_batch(card_async_t *ctx, card_runpre_rec_t *recs, Uint16_t n, Uint8_t flags, card_runpre_cb_t rec_cb, void *rec_arg, card_async_cb_t cb, void *arg, card_req_t *req)
+{
+	async_op_t op;
+
+	if (recs == NULL || n == 0)
+		return 0x3007;
+	memset(&op, 0, sizeof(op));
+	op.type = ASYNC_OP_RUNPRE_BATCH;
+	op.u.runpre.recs = recs;
+	op.u.runpre.n = n;
+	op.u.runpre.flags = flags;
+	op.u.runpre.cb = rec_cb;
+	op.u.runpre.arg = rec_arg;
+	return async_submit(ctx, &op, cb, arg, req);
+}
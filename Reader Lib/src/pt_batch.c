@@ -0,0 +1,113 @@
+/**
+ * \file	pt_batch.c
+ * \brief	批量数据交换接口函数
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+static int sw_matched(const card_apdu_t *cmd, Uint8_t sw1, Uint8_t sw2)
+{
+	Uint16_t sw = (Uint16_t)((sw1 << 8) | sw2);
+
+	return (sw & cmd->sw_mask) == (cmd->sw_expect & cmd->sw_mask);
+}
+
+card_err_t card_pipe_batch(card_obj_t *obj, const card_apdu_t *cmds, Uint16_t n, card_apdu_res_t *results, Uint8_t flags)
+{
+	Uint8_t *rbuf;
+	Uint16_t rlen, i;
+	unsigned long long start;
+	card_err_t ret, first = CARD_NO_ERR;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (cmds == NULL || results == NULL || n == 0) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	for (i = 0; i < n; i++) {
+		results[i].rlen = 0;
+		results[i].sw1 = 0;
+		results[i].sw2 = 0;
+		results[i].err = CARD_ERR_NOT_EXECUTED;
+		results[i].time_us = 0;
+	}
+	rbuf = (Uint8_t *)malloc(CARD_APDU_RESP_MAX);
+	if (rbuf == NULL) {
+		obj->last_err = 0x4012;
+		return obj->last_err;
+	}
+
+	for (i = 0; i < n; i++) {
+		rlen = 0;
+		start = pt_os_time_us();
+		ret = card_pipe(obj, cmds[i].tbuf, cmds[i].tlen, rbuf, &rlen);
+		results[i].time_us = (Uint32_t)(pt_os_time_us() - start);
+		if (ret == CARD_NO_ERR) {
+			results[i].rlen = rlen;
+			results[i].sw1 = obj->sw1;
+			results[i].sw2 = obj->sw2;
+			if (results[i].rbuf != NULL)
+				memcpy(results[i].rbuf, rbuf, rlen < results[i].rsize ? rlen : results[i].rsize);
+			if (!(flags & CARD_BATCH_FLAG_IGNORE_SW) && !sw_matched(&cmds[i], obj->sw1, obj->sw2))
+				ret = CARD_ERR_SW_UNEXPECTED;
+		}
+		results[i].err = ret;
+		if (ret == CARD_NO_ERR)
+			continue;
+
+		if (first == CARD_NO_ERR)
+			first = ret;
+		/* 通信错误时后续命令无法执行 */
+		if (!(flags & CARD_BATCH_FLAG_CONTINUE) || card_err_class(ret) == CARD_ERR_CLASS_LINK)
+			break;
+	}
+
+	free(rbuf);
+	obj->last_err = first;
+	return first;
+}
+
+card_err_t card_runpre_batch(card_obj_t *obj, card_runpre_rec_t *recs, Uint16_t n, Uint8_t flags, card_runpre_cb_t cb, void *arg)
+{
+	Uint16_t i;
+	unsigned long long start;
+	card_err_t ret, first = CARD_NO_ERR;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (recs == NULL || n == 0) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	for (i = 0; i < n; i++) {
+		recs[i].output_len = 0;
+		recs[i].err = CARD_ERR_NOT_EXECUTED;
+		recs[i].time_us = 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		recs[i].output_len = recs[i].output_size;
+		start = pt_os_time_us();
+		ret = ea_card_runpre(obj, recs[i].user_data, recs[i].user_data_len, recs[i].output_info, &recs[i].output_len);
+		recs[i].time_us = (Uint32_t)(pt_os_time_us() - start);
+		recs[i].err = ret;
+		if (ret != CARD_NO_ERR)
+			recs[i].output_len = 0;
+		if (cb != NULL)
+			cb(arg, i, &recs[i]);
+		if (ret == CARD_NO_ERR)
+			continue;
+
+		if (first == CARD_NO_ERR)
+			first = ret;
+		/* 通信错误时后续记录无法执行 */
+		if (!(flags & CARD_BATCH_FLAG_CONTINUE) || card_err_class(ret) == CARD_ERR_CLASS_LINK)
+			break;
+	}
+
+	obj->last_err = first;
+	return first;
+}
@@ -0,0 +1,439 @@
+/**
+ * \file	pt_deploy.c
+ * \brief	脚本下载接口函数
+ * \details	读写器保存的文件名称附加内容MD5值，名称相同即内容相同。
+ *			下载前列出读写器中的文件名称，已存在时不再传输文件。
+ *			驱动库只接受文件路径，内存数据需要传输时写入临时文件。
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+/*---- MD5 (RFC 1321) ----*/
+typedef struct md5_ctx {
+	Uint32_t state[4];
+	Uint32_t count[2];
+	Uint8_t buf[64];
+} md5_ctx_t;
+
+static const Uint32_t md5_k[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const Uint8_t md5_r[64] = {
+	7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+	5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+	4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+	6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+static void md5_block(Uint32_t *state, const Uint8_t *p)
+{
+	Uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+	Uint32_t w[16], f, t;
+	int i, g;
+
+	for (i = 0; i < 16; i++)
+		w[i] = (Uint32_t)p[i * 4] | ((Uint32_t)p[i * 4 + 1] << 8) | ((Uint32_t)p[i * 4 + 2] << 16) | ((Uint32_t)p[i * 4 + 3] << 24);
+	for (i = 0; i < 64; i++) {
+		if (i < 16) {
+			f = (b & c) | (~b & d);
+			g = i;
+		} else if (i < 32) {
+			f = (d & b) | (~d & c);
+			g = (5 * i + 1) & 15;
+		} else if (i < 48) {
+			f = b ^ c ^ d;
+			g = (3 * i + 5) & 15;
+		} else {
+			f = c ^ (b | ~d);
+			g = (7 * i) & 15;
+		}
+		t = a + f + md5_k[i] + w[g];
+		a = d;
+		d = c;
+		c = b;
+		b = b + ((t << md5_r[i]) | (t >> (32 - md5_r[i])));
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+}
+
+static void md5_init(md5_ctx_t *ctx)
+{
+	ctx->state[0] = 0x67452301;
+	ctx->state[1] = 0xefcdab89;
+	ctx->state[2] = 0x98badcfe;
+	ctx->state[3] = 0x10325476;
+	ctx->count[0] = 0;
+	ctx->count[1] = 0;
+}
+
+static void md5_update(md5_ctx_t *ctx, const Uint8_t *p, Uint32_t len)
+{
+	Uint32_t used = ctx->count[0] & 63, n;
+
+	if ((ctx->count[0] += len) < len)
+		ctx->count[1]++;
+	if (used != 0) {
+		n = 64 - used < len ? 64 - used : len;
+		memcpy(ctx->buf + used, p, n);
+		p += n;
+		len -= n;
+		if (used + n < 64)
+			return;
+		md5_block(ctx->state, ctx->buf);
+	}
+	for (; len >= 64; p += 64, len -= 64)
+		md5_block(ctx->state, p);
+	memcpy(ctx->buf, p, len);
+}
+
+static void md5_final(md5_ctx_t *ctx, Uint8_t *md5)
+{
+	static const Uint8_t pad[64] = { 0x80 };
+	Uint8_t bits[8];
+	Uint32_t lo = ctx->count[0] << 3, hi = (ctx->count[1] << 3) | (ctx->count[0] >> 29);
+	Uint32_t used = ctx->count[0] & 63;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		bits[i] = (Uint8_t)(lo >> (i * 8));
+		bits[i + 4] = (Uint8_t)(hi >> (i * 8));
+	}
+	md5_update(ctx, pad, used < 56 ? 56 - used : 120 - used);
+	md5_update(ctx, bits, 8);
+	for (i = 0; i < 16; i++)
+		md5[i] = (Uint8_t)(ctx->state[i / 4] >> ((i % 4) * 8));
+}
+
+/*---- 文件名称 ----*/
+/* name_HHHHHHHHHHHHHHHH.ext，扩展名保留在末尾 */
+static card_err_t stored_name(const Uint8_t *name, const Uint8_t *md5, Uint8_t *out)
+{
+	static const char hex[] = "0123456789abcdef";
+	const char *dot = strrchr((const char *)name, '.');
+	size_t base = dot != NULL ? (size_t)(dot - (const char *)name) : strlen((const char *)name);
+	size_t ext = strlen((const char *)name) - base;
+	Uint8_t *p;
+	int i;
+
+	if (base == 0 || base + 1 + CARD_DEPLOY_HASH_LEN + ext >= CARD_DEPLOY_NAME_MAX)
+		return 0x3007;
+	memcpy(out, name, base);
+	p = out + base;
+	*p++ = '_';
+	for (i = 0; i < CARD_DEPLOY_HASH_LEN / 2; i++) {
+		*p++ = (Uint8_t)hex[md5[i] >> 4];
+		*p++ = (Uint8_t)hex[md5[i] & 0x0F];
+	}
+	memcpy(p, name + base, ext + 1);
+	return CARD_NO_ERR;
+}
+
+/* 同一名称的其他版本: 相同的name_、16位十六进制、相同的扩展名 */
+static int same_family(const char *item, const char *stored)
+{
+	const char *ext = strrchr(stored, '.');
+	size_t len = strlen(stored), base, i;
+
+	if (ext == NULL)
+		ext = stored + len;
+	base = (size_t)(ext - stored) - CARD_DEPLOY_HASH_LEN;
+	if (strlen(item) != len || memcmp(item, stored, base) != 0 || strcmp(item + (ext - stored), ext) != 0)
+		return 0;
+	for (i = base; i < base + CARD_DEPLOY_HASH_LEN; i++) {
+		if (!((item[i] >= '0' && item[i] <= '9') || (item[i] >= 'a' && item[i] <= 'f')))
+			return 0;
+	}
+	return 1;
+}
+
+static card_err_t list_files(card_obj_t *obj, Uint8_t type, char **list)
+{
+	Uint32_t size = CARD_DEPLOY_LIST_SIZE, len;
+	char *buf = NULL, *p;
+	card_err_t ret;
+
+	for (;;) {
+		p = (char *)realloc(buf, size + 1);
+		if (p == NULL) {
+			free(buf);
+			obj->last_err = 0x4012;
+			return obj->last_err;
+		}
+		buf = p;
+		len = 0;
+		if (type == CARD_DEPLOY_PRE)
+			ret = ea_card_listpre(obj, (Uint8_t *)buf, size, &len);
+		else
+			ret = ea_card_listscript(obj, (Uint8_t *)buf, size, &len);
+		if (ret != CARD_NO_ERR) {
+			free(buf);
+			return ret;
+		}
+		if (len <= size)
+			break;
+		size = len;
+	}
+	buf[len] = '\0';
+	*list = buf;
+	return CARD_NO_ERR;
+}
+
+static int list_has(const char *list, const char *name)
+{
+	size_t n = strlen(name);
+	const char *p = list, *e;
+
+	while (*p != '\0') {
+		e = strchr(p, ',');
+		if (e == NULL)
+			e = p + strlen(p);
+		if ((size_t)(e - p) == n && memcmp(p, name, n) == 0)
+			return 1;
+		p = *e == ',' ? e + 1 : e;
+	}
+	return 0;
+}
+
+static void prune_family(card_obj_t *obj, Uint8_t type, char *list, const char *stored)
+{
+	char *p = list, *e;
+	int last;
+
+	while (*p != '\0') {
+		e = strchr(p, ',');
+		last = e == NULL;
+		if (last)
+			e = p + strlen(p);
+		*e = '\0';
+		if (strcmp(p, stored) != 0 && same_family(p, stored)) {
+			if (type == CARD_DEPLOY_PRE)
+				ea_card_delpre(obj, (Uint8_t *)p);
+			else
+				ea_card_delscript(obj, (Uint8_t *)p);
+		}
+		if (last)
+			break;
+		p = e + 1;
+	}
+}
+
+/* 驱动库下载接口，path为NULL时经临时文件传递内存数据 */
+static card_err_t add_file(card_obj_t *obj, Uint8_t type, Uint8_t *path, const Uint8_t *buf, Uint32_t len,
+	Uint8_t *name, Uint8_t *md5, Uint8_t force)
+{
+	char tmp[PT_PATH_MAX];
+	card_err_t ret;
+
+	if (path == NULL) {
+		if (pt_temp_write(tmp, buf, len) != 0) {
+			obj->last_err = 0x3009;
+			return obj->last_err;
+		}
+		path = (Uint8_t *)tmp;
+	}
+	if (type == CARD_DEPLOY_PRE)
+		ret = ea_card_addpre(obj, path, name, md5, force);
+	else
+		ret = ea_card_addscript(obj, path, name, md5, force);
+	if (path == (Uint8_t *)tmp)
+		pt_temp_remove(tmp);
+	return ret;
+}
+
+void card_md5(const Uint8_t *buf, Uint32_t len, Uint8_t *md5)
+{
+	md5_ctx_t ctx;
+
+	md5_init(&ctx);
+	md5_update(&ctx, buf, len);
+	md5_final(&ctx, md5);
+}
+
+card_err_t card_md5_file(Uint8_t *path, Uint8_t *md5)
+{
+	md5_ctx_t ctx;
+	Uint8_t buf[4096];
+	size_t n;
+	FILE *fp;
+
+	if (path == NULL || md5 == NULL)
+		return 0x3007;
+	fp = fopen((const char *)path, "rb");
+	if (fp == NULL)
+		return 0x3009;
+	md5_init(&ctx);
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		md5_update(&ctx, buf, (Uint32_t)n);
+	if (ferror(fp)) {
+		fclose(fp);
+		return 0x3009;
+	}
+	fclose(fp);
+	md5_final(&ctx, md5);
+	return CARD_NO_ERR;
+}
+
+card_err_t card_deploy_probe(card_obj_t *obj, Uint8_t type, Uint8_t *name, Uint8_t *present)
+{
+	char *list;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (name == NULL || present == NULL || (type != CARD_DEPLOY_PRE && type != CARD_DEPLOY_SCRIPT)) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	ret = list_files(obj, type, &list);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	*present = (Uint8_t)list_has(list, (const char *)name);
+	free(list);
+	return CARD_NO_ERR;
+}
+
+card_err_t card_deploy_file(card_obj_t *obj, const card_deploy_t *d, card_deploy_res_t *res)
+{
+	Uint8_t md5[16];
+	char *list = NULL;
+	unsigned long long start = pt_os_time_us();
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (d == NULL || res == NULL || d->name == NULL || (d->path == NULL && d->buf == NULL)
+		|| (d->type != CARD_DEPLOY_PRE && d->type != CARD_DEPLOY_SCRIPT)) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	memset(res, 0, sizeof(*res));
+
+	ret = CARD_NO_ERR;
+	if (d->path != NULL)
+		ret = card_md5_file(d->path, res->md5);
+	else
+		card_md5(d->buf, d->len, res->md5);
+	if (ret == CARD_NO_ERR)
+		ret = stored_name(d->name, res->md5, res->stored_name);
+	if (ret != CARD_NO_ERR)
+		goto done;
+
+	ret = list_files(obj, d->type, &list);
+	if (ret != CARD_NO_ERR)
+		goto done;
+	if ((d->flags & CARD_DEPLOY_FLAG_FORCE) || !list_has(list, (const char *)res->stored_name)) {
+		ret = add_file(obj, d->type, d->path, d->buf, d->len, res->stored_name, md5, 1);
+		if (ret != CARD_NO_ERR)
+			goto done;
+		/* 读写器计算的MD5值与本地文件不同时，文件可能在传输期间被修改 */
+		if (memcmp(md5, res->md5, sizeof(md5)) != 0) {
+			ret = 0x3012;
+			goto done;
+		}
+		res->uploaded = 1;
+	}
+	if (d->flags & CARD_DEPLOY_FLAG_PRUNE)
+		prune_family(obj, d->type, list, (const char *)res->stored_name);
+
+done:
+	free(list);
+	res->err = ret;
+	res->time_us = (Uint32_t)(pt_os_time_us() - start);
+	obj->last_err = ret;
+	return ret;
+}
+
+card_err_t card_addpre_buf(card_obj_t *obj, const Uint8_t *buf, Uint32_t len, Uint8_t *name, Uint8_t *md5, Uint8_t force)
+{
+	if (obj == NULL)
+		return 0x3007;
+	if (buf == NULL || name == NULL || md5 == NULL) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	return add_file(obj, CARD_DEPLOY_PRE, NULL, buf, len, name, md5, force);
+}
+
+card_err_t card_addscript_buf(card_obj_t *obj, const Uint8_t *buf, Uint32_t len, Uint8_t *name, Uint8_t *md5, Uint8_t force)
+{
+	if (obj == NULL)
+		return 0x3007;
+	if (buf == NULL || name == NULL || md5 == NULL) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	return add_file(obj, CARD_DEPLOY_SCRIPT, NULL, buf, len, name, md5, force);
+}
+
+/*---- 多读写器下载 ----*/
+typedef struct deploy_job {
+	const card_deploy_t *d;
+	card_deploy_res_t *res;
+} deploy_job_t;
+
+static card_err_t deploy_fn(card_obj_t *obj, void *arg)
+{
+	deploy_job_t *job = (deploy_job_t *)arg;
+
+	return card_deploy_file(obj, job->d, job->res);
+}
+
+static void deploy_done(card_station_t *st, card_req_t id, Uint16_t reader, card_err_t err, void *arg)
+{
+	deploy_job_t *job = (deploy_job_t *)arg;
+
+	(void)st;
+	(void)id;
+	(void)reader;
+	/* 读写器未连接时任务函数未执行 */
+	job->res->err = err;
+}
+
+card_err_t card_station_deploy(card_station_t *st, const card_deploy_t *d, card_deploy_res_t *results, Uint16_t n)
+{
+	deploy_job_t *jobs;
+	card_err_t ret = CARD_NO_ERR;
+	Uint16_t i;
+
+	if (st == NULL || d == NULL || results == NULL || n == 0)
+		return 0x3007;
+	jobs = (deploy_job_t *)calloc(n, sizeof(deploy_job_t));
+	if (jobs == NULL)
+		return 0x4012;
+
+	for (i = 0; i < n; i++) {
+		memset(&results[i], 0, sizeof(results[i]));
+		results[i].err = CARD_ERR_NOT_EXECUTED;
+		jobs[i].d = d;
+		jobs[i].res = &results[i];
+	}
+	/* 每个读写器一个指定读写器的任务，各读写器线程并行下载 */
+	for (i = 0; i < n; i++) {
+		ret = card_station_submit(st, i, deploy_fn, &jobs[i], deploy_done, &jobs[i], NULL);
+		if (ret != CARD_NO_ERR)
+			results[i].err = ret;
+	}
+	card_station_wait(st, 0);
+
+	ret = CARD_NO_ERR;
+	for (i = 0; i < n; i++) {
+		if (results[i].err != CARD_NO_ERR && ret == CARD_NO_ERR)
+			ret = results[i].err;
+	}
+	free(jobs);
+	return ret;
+}
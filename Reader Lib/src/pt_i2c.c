@@ -0,0 +1,183 @@
+/**
+ * \file	pt_i2c.c
+ * \brief	I2C EEPROM批量读写接口函数
+ * \details	读写器只提供单次写后读命令，按页拆分映像后逐页写入。写周期内的ACK轮询
+ *			与下一页的写入合并，设备忙时重发下一页，不单独等待写周期。
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+#define ERR_RX_TIMEOUT		0x1008		/* 设备无应答(NAK) */
+#define ERR_BUSY			0x1038		/* 设备忙 */
+#define POLL_INTERVAL_MS	1			/* ACK轮询间隔，与读写器默认值相同 */
+
+/* 半字节查表，CRC32多项式0xEDB88320 */
+static const Uint32_t crc_nibble[16] = {
+	0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+	0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL, 0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL
+};
+
+Uint32_t card_crc32(Uint32_t crc, const Uint8_t *buf, Uint32_t len)
+{
+	Uint32_t i;
+
+	crc = ~crc;
+	for (i = 0; i < len; i++) {
+		crc ^= buf[i];
+		crc = crc_nibble[crc & 0x0F] ^ (crc >> 4);
+		crc = crc_nibble[crc & 0x0F] ^ (crc >> 4);
+	}
+	return ~crc;
+}
+
+/* 设备地址和地址字节，1字节地址的器件高位地址在设备地址低3位 */
+static Uint8_t i2c_addr(const card_i2c_prog_t *p, Uint32_t addr, Uint16_t *dev, Uint8_t *abuf)
+{
+	Uint8_t i, n = p->addr_bytes;
+
+	*dev = p->dev;
+	if (n == 1)
+		*dev = (Uint16_t)(p->dev | ((addr >> 8) & 0x07));
+	for (i = 0; i < n; i++)
+		abuf[i] = (Uint8_t)(addr >> (8 * (n - 1 - i)));
+	return n;
+}
+
+/* 发送一条写后读命令，写周期内设备不应答时重发，直到ACK轮询超时 */
+static card_err_t i2c_xfer(card_obj_t *obj, const card_i2c_prog_t *p, Uint16_t dev, Uint8_t *tbuf, Uint16_t tlen,
+	Uint8_t *rbuf, Uint16_t *rlen)
+{
+	unsigned long long deadline = 0;
+	Uint16_t want = *rlen;
+	Uint32_t timeout = p->poll_timeout_ms != 0 ? p->poll_timeout_ms : CARD_I2C_POLL_TIMEOUT;
+	card_err_t ret;
+
+	for (;;) {
+		*rlen = want;
+		ret = card_i2c_write_read(obj, dev, tbuf, tlen, rbuf, rlen);
+		if (ret != ERR_BUSY && ret != ERR_RX_TIMEOUT)
+			return ret;
+		if (deadline == 0)
+			deadline = pt_os_time_us() + (unsigned long long)timeout * 1000ULL;
+		else if (pt_os_time_us() >= deadline)
+			return ret;
+		pt_sleep_ms(POLL_INTERVAL_MS);
+	}
+}
+
+static card_err_t check_prog(card_obj_t *obj, const card_i2c_prog_t *p, const Uint8_t *buf, Uint32_t len)
+{
+	if (p == NULL || buf == NULL || len == 0 || p->addr_bytes == 0 || p->addr_bytes > 4
+		|| (p->addr_bytes < 4 && p->addr + len - 1 >= (1UL << (8 * p->addr_bytes + (p->addr_bytes == 1 ? 3 : 0))))) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	return CARD_NO_ERR;
+}
+
+card_err_t card_i2c_eeprom_read(card_obj_t *obj, const card_i2c_prog_t *p, Uint8_t *rbuf, Uint32_t len,
+	card_stream_cb_t cb, void *arg, Uint32_t *crc)
+{
+	Uint8_t abuf[4];
+	Uint16_t dev, n, rl, chunk;
+	Uint32_t done = 0, c = 0;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	ret = check_prog(obj, p, rbuf, len);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	chunk = p->read_chunk != 0 ? p->read_chunk : CARD_I2C_READ_CHUNK;
+
+	while (done < len) {
+		n = (Uint16_t)(len - done < chunk ? len - done : chunk);
+		/* 1字节地址的器件不跨越256字节块，设备地址随块变化 */
+		if (p->addr_bytes == 1 && ((p->addr + done) & 0xFF) + n > 0x100)
+			n = (Uint16_t)(0x100 - ((p->addr + done) & 0xFF));
+		i2c_addr(p, p->addr + done, &dev, abuf);
+		rl = n;
+		ret = i2c_xfer(obj, p, dev, abuf, p->addr_bytes, rbuf + done, &rl);
+		if (ret == CARD_NO_ERR && rl != n) {
+			obj->last_err = 0x1022;
+			ret = obj->last_err;
+		}
+		if (ret != CARD_NO_ERR)
+			return ret;
+		c = card_crc32(c, rbuf + done, n);
+		if (cb != NULL)
+			cb(arg, done, n);
+		done += n;
+	}
+
+	if (crc != NULL)
+		*crc = c;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_i2c_eeprom_write(card_obj_t *obj, const card_i2c_prog_t *p, const Uint8_t *image, Uint32_t len,
+	card_stream_cb_t cb, void *arg, Uint32_t *crc)
+{
+	Uint8_t *tbuf, *vbuf, dummy[1];
+	Uint16_t dev, n, rl, page;
+	Uint32_t done = 0, addr, c;
+	card_err_t ret = CARD_NO_ERR;
+
+	if (obj == NULL)
+		return 0x3007;
+	ret = check_prog(obj, p, image, len);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	if (p->page_size == 0 || (p->page_size & (p->page_size - 1)) != 0) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	page = p->page_size;
+	tbuf = (Uint8_t *)malloc((size_t)page + 4);
+	if (tbuf == NULL) {
+		obj->last_err = 0x4012;
+		return obj->last_err;
+	}
+
+	/* 页写入不能跨页，第一页从起始地址写到页尾 */
+	while (done < len) {
+		addr = p->addr + done;
+		n = (Uint16_t)(page - (addr & (page - 1)));
+		if (n > len - done)
+			n = (Uint16_t)(len - done);
+		rl = i2c_addr(p, addr, &dev, tbuf);
+		memcpy(tbuf + rl, image + done, n);
+		rl = 0;
+		ret = i2c_xfer(obj, p, dev, tbuf, (Uint16_t)(p->addr_bytes + n), dummy, &rl);
+		if (ret != CARD_NO_ERR)
+			break;
+		if (cb != NULL)
+			cb(arg, done, n);
+		done += n;
+	}
+	free(tbuf);
+	if (ret != CARD_NO_ERR)
+		return ret;
+
+	c = card_crc32(0, image, len);
+	if (p->flags & CARD_I2C_FLAG_VERIFY) {
+		vbuf = (Uint8_t *)malloc(len);
+		if (vbuf == NULL) {
+			obj->last_err = 0x4012;
+			return obj->last_err;
+		}
+		/* 回读的第一条命令同时等待最后一页的写周期 */
+		ret = card_i2c_eeprom_read(obj, p, vbuf, len, NULL, NULL, &c);
+		if (ret == CARD_NO_ERR && memcmp(vbuf, image, len) != 0) {
+			obj->last_err = CARD_ERR_VERIFY;
+			ret = obj->last_err;
+		}
+		free(vbuf);
+	}
+
+	if (ret == CARD_NO_ERR && crc != NULL)
+		*crc = c;
+	return ret;
+}
@@ -0,0 +1,313 @@
+/**
+ * \file	pt_inventory.c
+ * \brief	非接触卡片盘点接口函数
+ * \details	读写器没有盘点命令，由主机按防冲突流程逐张选择并暂停卡片，
+ *			暂停的卡片不响应后续请求，直到没有卡片应答。
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+#define ERR_NO_RESP		0x2001		/* 无应答 */
+#define ERR_CRC			0x2002		/* CRC或奇偶校验错误 */
+#define ERR_COLLISION	0x2003		/* 发生碰撞 */
+#define FIELD_RESET_MS	5			/* ISO15693关闭和重新开启载波后的等待时间 */
+
+/* 无卡应答或碰撞未解决时结束盘点，其他错误返回 */
+static card_err_t end_of_field(card_err_t err)
+{
+	return err == ERR_NO_RESP || err == ERR_COLLISION ? CARD_NO_ERR : err;
+}
+
+static int find_uid(const card_tag_t *tags, Uint16_t n, const Uint8_t *uid, Uint8_t uid_len)
+{
+	Uint16_t i;
+
+	for (i = 0; i < n; i++) {
+		if (tags[i].uid_len == uid_len && memcmp(tags[i].uid, uid, uid_len) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+static card_err_t inventory_a(card_obj_t *obj, Uint8_t flags, card_tag_t *tags, Uint16_t max, Uint16_t *count)
+{
+	card_tag_t *t;
+	Uint16_t atqa, uid_len, n = 0, ats_len;
+	Uint8_t uid[CARD_TAG_UID_MAX], sak, status, ats[256];
+	card_err_t ret;
+
+	for (;;) {
+		/* 第一次WUPA包括上次盘点后仍处于暂停状态的卡片，之后REQA只有未暂停的卡片应答 */
+		ret = n == 0 ? card_wupa(obj, &atqa) : card_reqa(obj, &atqa);
+		if (ret != CARD_NO_ERR)
+			break;
+		uid_len = 0;
+		ret = card_anticol(obj, uid, &uid_len, &sak, &status);
+		if (ret == CARD_NO_ERR && (uid_len == 0 || uid_len > CARD_TAG_UID_MAX))
+			ret = 0x2006;
+		if (ret == CARD_NO_ERR)
+			ret = card_select(obj, uid, uid_len, &sak);
+		/* 碰撞未能解决时本次盘点结束 */
+		if (ret != CARD_NO_ERR)
+			break;
+		if (n >= max) {
+			card_halta(obj);
+			ret = CARD_ERR_BUF_SMALL;
+			break;
+		}
+
+		t = &tags[n++];
+		memset(t, 0, sizeof(*t));
+		t->model = obj->model;
+		memcpy(t->uid, uid, uid_len);
+		t->uid_len = (Uint8_t)uid_len;
+		t->atqa = atqa;
+		t->sak = sak;
+		/* 支持ISO14443-4的卡片取得ATS后DESELECT，同样进入暂停状态 */
+		if ((flags & CARD_INV_FLAG_RATS) && (sak & 0x20)) {
+			ats_len = 0;
+			ret = card_rats(obj, ats, &ats_len);
+			if (ret == CARD_NO_ERR) {
+				t->info_len = (Uint8_t)(ats_len < CARD_TAG_INFO_MAX ? ats_len : CARD_TAG_INFO_MAX);
+				memcpy(t->info, ats, t->info_len);
+				ret = card_deselect(obj);
+				if (ret == CARD_NO_ERR)
+					continue;
+			}
+			if (card_err_class(ret) == CARD_ERR_CLASS_LINK)
+				break;
+		}
+		ret = card_halta(obj);
+		if (card_err_class(ret) == CARD_ERR_CLASS_LINK)
+			break;
+	}
+
+	*count = n;
+	return end_of_field(ret);
+}
+
+static card_err_t inventory_b(card_obj_t *obj, card_tag_t *tags, Uint16_t max, Uint16_t *count)
+{
+	card_tag_t *t;
+	Uint8_t atqb[256], atqb_len;
+	Uint16_t n = 0;
+	card_err_t ret;
+
+	for (;;) {
+		atqb_len = 0;
+		ret = n == 0 ? card_wupb(obj, atqb, &atqb_len) : card_reqb(obj, atqb, &atqb_len);
+		if (ret != CARD_NO_ERR)
+			break;
+		/* ATQB: 50 PUPI(4) 应用数据(4) 协议信息(3或4) */
+		if (atqb_len < 5 || atqb_len > CARD_TAG_INFO_MAX || atqb[0] != 0x50) {
+			ret = CARD_NO_ERR;
+			break;
+		}
+		if (n >= max) {
+			card_haltb(obj);
+			ret = CARD_ERR_BUF_SMALL;
+			break;
+		}
+
+		t = &tags[n++];
+		memset(t, 0, sizeof(*t));
+		t->model = obj->model;
+		memcpy(t->uid, atqb + 1, 4);
+		t->uid_len = 4;
+		memcpy(t->info, atqb, atqb_len);
+		t->info_len = atqb_len;
+		ret = card_haltb(obj);
+		if (card_err_class(ret) == CARD_ERR_CLASS_LINK)
+			break;
+	}
+
+	*count = n;
+	return end_of_field(ret);
+}
+
+/* 静默状态的卡片只处理寻址命令，关闭载波使全部卡片回到就绪状态 */
+static card_err_t field_reset(card_obj_t *obj)
+{
+	card_err_t ret;
+
+	ret = card_off(obj);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	pt_sleep_ms(FIELD_RESET_MS);
+	ret = card_on(obj);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	pt_sleep_ms(FIELD_RESET_MS);
+	return CARD_NO_ERR;
+}
+
+/* ISO15693 单时隙INVENTORY，碰撞时按UID低位逐位增加掩码 */
+static card_err_t inventory_15693(card_obj_t *obj, Uint8_t afi, card_tag_t *tags, Uint16_t max, Uint16_t *count)
+{
+	Uint8_t mask[8 * 66], mask_len[66];	/* 待查询的掩码栈，每个8字节，每次碰撞深度加1 */
+	Uint8_t tbuf[13], *rbuf;
+	Uint16_t rlen, tlen, n = 0;
+	int top = 0, bytes, i;
+	card_err_t ret;
+	card_tag_t *t;
+
+	*count = 0;
+	/* 上次盘点后处于静默状态的卡片不应答INVENTORY */
+	ret = field_reset(obj);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	/* card_pipe不检查应答长度 */
+	rbuf = (Uint8_t *)malloc(CARD_APDU_RESP_MAX);
+	if (rbuf == NULL)
+		return 0x4012;
+
+	memset(mask, 0, 8);
+	mask_len[top++] = 0;
+	while (top > 0) {
+		top--;
+		bytes = (mask_len[top] + 7) / 8;
+		tlen = 0;
+		tbuf[tlen++] = (Uint8_t)(0x26 | (afi != 0 ? 0x10 : 0x00));	/* 高速率、INVENTORY、单时隙 */
+		tbuf[tlen++] = 0x01;
+		if (afi != 0)
+			tbuf[tlen++] = afi;
+		tbuf[tlen++] = mask_len[top];
+		for (i = 0; i < bytes; i++)
+			tbuf[tlen++] = mask[top * 8 + i];
+		rlen = 0;
+		ret = card_pipe(obj, tbuf, tlen, rbuf, &rlen);
+		if (ret == ERR_COLLISION || ret == ERR_CRC) {
+			/* 掩码已达64位仍碰撞时无法区分，放弃该分支 */
+			if (mask_len[top] >= 64) {
+				ret = ERR_COLLISION;
+				continue;
+			}
+			memcpy(&mask[(top + 1) * 8], &mask[top * 8], 8);
+			mask[(top + 1) * 8 + mask_len[top] / 8] |= (Uint8_t)(1U << (mask_len[top] % 8));
+			mask_len[top + 1] = (Uint8_t)(mask_len[top] + 1);
+			mask_len[top]++;
+			top += 2;
+			continue;
+		}
+		if (ret == ERR_NO_RESP) {
+			ret = CARD_NO_ERR;
+			continue;
+		}
+		if (ret != CARD_NO_ERR)
+			break;
+		/* 应答: 标志 DSFID UID(8，低字节在前) */
+		if (rlen < 10 || (rbuf[0] & 0x01) || find_uid(tags, n, rbuf + 2, 8))
+			continue;
+		if (n >= max) {
+			ret = CARD_ERR_BUF_SMALL;
+			break;
+		}
+
+		t = &tags[n++];
+		memset(t, 0, sizeof(*t));
+		t->model = obj->model;
+		memcpy(t->uid, rbuf + 2, 8);
+		t->uid_len = 8;
+		t->info[0] = rbuf[1];
+		t->info_len = 1;
+
+		/* STAY QUIET，寻址模式，卡片不应答 */
+		tbuf[0] = 0x22;
+		tbuf[1] = 0x02;
+		memcpy(tbuf + 2, t->uid, 8);
+		rlen = 0;
+		ret = card_pipe(obj, tbuf, 10, rbuf, &rlen);
+		if (card_err_class(ret) == CARD_ERR_CLASS_LINK)
+			break;
+		ret = CARD_NO_ERR;
+		/* 同一掩码下可能还有其他卡片 */
+		top++;
+	}
+
+	free(rbuf);
+	*count = n;
+	return end_of_field(ret);
+}
+
+card_err_t card_inventory(card_obj_t *obj, Uint8_t flags, Uint8_t afi, card_tag_t *tags, Uint16_t max, Uint16_t *count)
+{
+	Uint16_t n = 0;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (tags == NULL || count == NULL) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+
+	switch (obj->model) {
+	case MODEL_P14443A:
+	case MODEL_PMIFARE:
+		ret = inventory_a(obj, flags, tags, max, &n);
+		break;
+	case MODEL_P14443B:
+		ret = inventory_b(obj, tags, max, &n);
+		break;
+	case MODEL_P15693:
+		ret = inventory_15693(obj, afi, tags, max, &n);
+		break;
+	default:
+		ret = 0x3007;
+		break;
+	}
+
+	*count = n;
+	obj->last_err = ret;
+	return ret;
+}
+
+card_err_t card_inventory_poll(card_obj_t *obj, Uint8_t flags, Uint8_t afi, Uint32_t interval_ms, card_tag_cb_t cb, void *arg)
+{
+	card_tag_t *buf, *prev, *cur, *tmp;
+	Uint16_t nprev = 0, ncur, i;
+	card_err_t ret;
+	int stop = 0;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (cb == NULL) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	buf = (card_tag_t *)malloc(2 * CARD_INV_MAX_TAGS * sizeof(card_tag_t));
+	if (buf == NULL) {
+		obj->last_err = 0x4012;
+		return obj->last_err;
+	}
+	prev = buf;
+	cur = buf + CARD_INV_MAX_TAGS;
+
+	while (!stop) {
+		ret = card_inventory(obj, flags, afi, cur, CARD_INV_MAX_TAGS, &ncur);
+		if (ret != CARD_NO_ERR && ret != CARD_ERR_BUF_SMALL)
+			break;
+		for (i = 0; i < nprev && !stop; i++) {
+			if (!find_uid(cur, ncur, prev[i].uid, prev[i].uid_len))
+				stop = cb(arg, CARD_TAG_DEPARTED, &prev[i]);
+		}
+		for (i = 0; i < ncur && !stop; i++) {
+			if (!find_uid(prev, nprev, cur[i].uid, cur[i].uid_len))
+				stop = cb(arg, CARD_TAG_ARRIVED, &cur[i]);
+		}
+		tmp = prev;
+		prev = cur;
+		cur = tmp;
+		nprev = ncur;
+		if (!stop && interval_ms != 0)
+			pt_sleep_ms(interval_ms);
+	}
+
+	free(buf);
+	if (stop)
+		ret = CARD_NO_ERR;
+	obj->last_err = ret;
+	return ret;
+}
@@ -0,0 +1,564 @@
+/**
+ * \file	pt_metrics.c
+ * \brief	通信统计接口函数
+ * \details	每个卡片对象占用一个统计槽位，按命令编号记录次数、错误、耗时直方图和收发字节数。
+ *			记录只使用原子操作，只有第一次记录占用槽位时加锁；导出时逐项读取，不保证各项之间严格一致。
+ *			Windows和32位系统的long为32位，计数分为高低两部分累加，合计为64位。
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+/* 槽位状态 */
+#define SLOT_FREE			0
+#define SLOT_BUSY			1
+#define SLOT_USED			2
+
+/* 低位超过该值时进位，多个线程同时进位前低位也不超出32位long */
+#define WIDE_CARRY			0x1000000L
+
+/* 64位计数，合计 = hi * WIDE_CARRY + lo，进位时lo可能暂时为负 */
+typedef struct wide {
+	volatile long lo;
+	volatile long hi;
+} wide_t;
+
+typedef struct cmd_slot {
+	wide_t count;
+	wide_t errors;
+	wide_t sum_us;
+	volatile long max_us;
+	wide_t buckets[CARD_METRICS_BUCKETS];
+} cmd_slot_t;
+
+typedef struct obj_slot {
+	volatile long state;
+	const card_obj_t *obj;
+	Int32_t handle;
+	card_mod_t model;
+	Uint8_t addr[MAX_ADDR_SIZE];
+	wide_t tx_bytes;
+	wide_t rx_bytes;
+	wide_t reconnects;
+	wide_t err_groups[CARD_METRICS_ERR_GROUPS];
+	cmd_slot_t cmds[CARD_CMD_MAX];
+} obj_slot_t;
+
+struct card_metrics {
+	obj_slot_t *slots;
+	Uint16_t max;
+	pt_mutex_t lock;			/* 占用槽位 */
+};
+
+/* 导出缓存，超出大小时只计算长度 */
+typedef struct out_buf {
+	Uint8_t *buf;
+	Uint32_t size;
+	Uint32_t pos;
+} out_buf_t;
+
+/* 命令名称，按CARD_CMD_XXX索引 */
+static const char *const cmd_names[CARD_CMD_MAX] = {
+	"other", "pipe", "reset", "warm_reset", "off", "reqa", "wupa", "anticol", "select", "rats",
+	"mifare_read", "mifare_write", "i2c_write_read", "spi_write_read", "swd_dap_read", "swd_dap_write", "runpre"
+};
+
+card_err_t card_metrics_create(card_metrics_t **m, Uint16_t max)
+{
+	card_metrics_t *c;
+
+	if (m == NULL || max == 0)
+		return 0x3007;
+	c = (card_metrics_t *)calloc(1, sizeof(card_metrics_t));
+	if (c == NULL)
+		return 0x4012;
+	c->slots = (obj_slot_t *)calloc(max, sizeof(obj_slot_t));
+	if (c->slots == NULL) {
+		free(c);
+		return 0x4012;
+	}
+	c->max = max;
+	pt_mutex_init(&c->lock);
+	*m = c;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_metrics_destroy(card_metrics_t *m)
+{
+	if (m == NULL)
+		return 0x3007;
+	pt_mutex_destroy(&m->lock);
+	free(m->slots);
+	free(m);
+	return CARD_NO_ERR;
+}
+
+static void wide_add(wide_t *w, Uint32_t v)
+{
+	if (v >= (Uint32_t)WIDE_CARRY)
+		pt_atomic_add(&w->hi, (long)(v / WIDE_CARRY));
+	if (pt_atomic_add(&w->lo, (long)(v % WIDE_CARRY)) >= WIDE_CARRY) {
+		pt_atomic_add(&w->lo, -WIDE_CARRY);
+		pt_atomic_add(&w->hi, 1);
+	}
+}
+
+static unsigned long long wide_load(wide_t *w)
+{
+	long long sum = (long long)pt_atomic_load(&w->hi) * WIDE_CARRY + pt_atomic_load(&w->lo);
+
+	return sum > 0 ? (unsigned long long)sum : 0;
+}
+
+static obj_slot_t *slot_find(card_metrics_t *m, const card_obj_t *obj)
+{
+	Uint16_t i;
+
+	for (i = 0; i < m->max; i++) {
+		if (pt_atomic_load(&m->slots[i].state) == SLOT_USED && m->slots[i].obj == obj)
+			return &m->slots[i];
+	}
+	return NULL;
+}
+
+/* 取得卡片对象的槽位，第一次记录时占用空闲槽位，槽位用完时返回NULL */
+static obj_slot_t *slot_get(card_metrics_t *m, const card_obj_t *obj)
+{
+	obj_slot_t *s;
+	Uint16_t i;
+
+	s = slot_find(m, obj);
+	if (s != NULL)
+		return s;
+	/* 同一对象的多个线程同时第一次记录时只占用一个槽位 */
+	pt_mutex_lock(&m->lock);
+	s = slot_find(m, obj);
+	for (i = 0; s == NULL && i < m->max; i++) {
+		if (pt_atomic_cas(&m->slots[i].state, SLOT_FREE, SLOT_BUSY)) {
+			s = &m->slots[i];
+			s->obj = obj;
+			s->handle = obj->handle;
+			s->model = obj->model;
+			memcpy(s->addr, obj->addr, MAX_ADDR_SIZE);
+			pt_atomic_store(&s->state, SLOT_USED);
+		}
+	}
+	pt_mutex_unlock(&m->lock);
+	return s;
+}
+
+card_err_t card_metrics_remove(card_metrics_t *m, const card_obj_t *obj)
+{
+	obj_slot_t *s;
+
+	if (m == NULL || obj == NULL)
+		return 0x3007;
+	s = slot_find(m, obj);
+	if (s == NULL)
+		return 0x3007;
+	pt_atomic_store(&s->state, SLOT_BUSY);
+	memset((void *)&s->tx_bytes, 0, sizeof(obj_slot_t) - ((char *)&s->tx_bytes - (char *)s));
+	s->obj = NULL;
+	pt_atomic_store(&s->state, SLOT_FREE);
+	return CARD_NO_ERR;
+}
+
+/* 直方图位置: 耗时不大于2^i微秒的最小i，超过最大上限时为最后一个 */
+static Uint8_t bucket_of(Uint32_t us)
+{
+	Uint8_t i = 0;
+
+	while (i < CARD_METRICS_BUCKETS - 1 && (1UL << i) < us)
+		i++;
+	return i;
+}
+
+void card_metrics_record(card_metrics_t *m, const card_obj_t *obj, Uint8_t cmd, card_err_t err,
+	Uint32_t tx, Uint32_t rx, Uint32_t us)
+{
+	obj_slot_t *s;
+	cmd_slot_t *c;
+	long cur;
+	Uint8_t g;
+
+	if (m == NULL || obj == NULL)
+		return;
+	s = slot_get(m, obj);
+	if (s == NULL)
+		return;
+	c = &s->cmds[cmd < CARD_CMD_MAX ? cmd : CARD_CMD_OTHER];
+
+	wide_add(&c->count, 1);
+	wide_add(&c->buckets[bucket_of(us)], 1);
+	wide_add(&c->sum_us, us);
+	cur = pt_atomic_load(&c->max_us);
+	while ((Uint32_t)cur < us && !pt_atomic_cas(&c->max_us, cur, (long)us))
+		cur = pt_atomic_load(&c->max_us);
+
+	if (tx != 0)
+		wide_add(&s->tx_bytes, tx);
+	if (rx != 0)
+		wide_add(&s->rx_bytes, rx);
+	if (err != CARD_NO_ERR) {
+		wide_add(&c->errors, 1);
+		g = (Uint8_t)(err >> 12);
+		wide_add(&s->err_groups[g < CARD_METRICS_ERR_GROUPS ? g : 0], 1);
+	}
+}
+
+void card_metrics_reconnect(card_metrics_t *m, const card_obj_t *obj)
+{
+	obj_slot_t *s;
+
+	if (m == NULL || obj == NULL)
+		return;
+	s = slot_get(m, obj);
+	if (s != NULL) {
+		s->handle = obj->handle;
+		wide_add(&s->reconnects, 1);
+	}
+}
+
+static Uint32_t elapsed_us(unsigned long long start)
+{
+	unsigned long long d = pt_os_time_us() - start;
+
+	return d > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (Uint32_t)d;
+}
+
+card_err_t card_metrics_call(card_metrics_t *m, card_obj_t *obj, Uint8_t cmd, card_async_fn_t fn, void *arg)
+{
+	unsigned long long start;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (fn == NULL) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	start = pt_os_time_us();
+	ret = fn(obj, arg);
+	card_metrics_record(m, obj, cmd, ret, 0, 0, elapsed_us(start));
+	return ret;
+}
+
+card_err_t card_metrics_pipe(card_metrics_t *m, card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen)
+{
+	unsigned long long start = pt_os_time_us();
+	card_err_t ret;
+
+	ret = card_pipe(obj, tbuf, tlen, rbuf, rlen);
+	card_metrics_record(m, obj, CARD_CMD_PIPE, ret, tlen, ret == CARD_NO_ERR ? *rlen : 0, elapsed_us(start));
+	return ret;
+}
+
+card_err_t card_metrics_reset(card_metrics_t *m, card_obj_t *obj)
+{
+	unsigned long long start = pt_os_time_us();
+	card_err_t ret;
+
+	ret = card_reset(obj);
+	card_metrics_record(m, obj, CARD_CMD_RESET, ret, 0, ret == CARD_NO_ERR ? obj->atr_len : 0, elapsed_us(start));
+	return ret;
+}
+
+card_err_t card_metrics_reqa(card_metrics_t *m, card_obj_t *obj, Uint16_t *atqa)
+{
+	unsigned long long start = pt_os_time_us();
+	card_err_t ret;
+
+	ret = card_reqa(obj, atqa);
+	card_metrics_record(m, obj, CARD_CMD_REQA, ret, 1, ret == CARD_NO_ERR ? 2 : 0, elapsed_us(start));
+	return ret;
+}
+
+card_err_t card_metrics_runpre(card_metrics_t *m, card_obj_t *obj, Uint8_t *user_data, Uint32_t user_data_len,
+	Uint8_t *output_info, Uint32_t *output_info_len)
+{
+	unsigned long long start = pt_os_time_us();
+	card_err_t ret;
+
+	ret = ea_card_runpre(obj, user_data, user_data_len, output_info, output_info_len);
+	card_metrics_record(m, obj, CARD_CMD_RUNPRE, ret, user_data_len,
+		ret == CARD_NO_ERR && output_info_len != NULL ? *output_info_len : 0, elapsed_us(start));
+	return ret;
+}
+
+card_err_t card_get_stats(card_metrics_t *m, const card_obj_t *obj, card_stats_t *stats)
+{
+	obj_slot_t *s;
+	cmd_slot_t *c;
+	Uint8_t i, j;
+
+	if (m == NULL || obj == NULL || stats == NULL)
+		return 0x3007;
+	s = slot_find(m, obj);
+	if (s == NULL)
+		return 0x3007;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->handle = s->handle;
+	stats->model = s->model;
+	memcpy(stats->addr, s->addr, MAX_ADDR_SIZE);
+	stats->tx_bytes = wide_load(&s->tx_bytes);
+	stats->rx_bytes = wide_load(&s->rx_bytes);
+	stats->reconnects = wide_load(&s->reconnects);
+	for (i = 0; i < CARD_METRICS_ERR_GROUPS; i++)
+		stats->err_groups[i] = wide_load(&s->err_groups[i]);
+	for (i = 0; i < CARD_CMD_MAX; i++) {
+		c = &s->cmds[i];
+		stats->cmds[i].count = wide_load(&c->count);
+		stats->cmds[i].errors = wide_load(&c->errors);
+		stats->cmds[i].max_us = (Uint32_t)pt_atomic_load(&c->max_us);
+		stats->cmds[i].total_ms = wide_load(&c->sum_us) / 1000ULL;
+		for (j = 0; j < CARD_METRICS_BUCKETS; j++)
+			stats->cmds[i].buckets[j] = wide_load(&c->buckets[j]);
+	}
+	return CARD_NO_ERR;
+}
+
+static void out_str(out_buf_t *o, const char *str)
+{
+	while (*str != '\0') {
+		if (o->pos < o->size)
+			o->buf[o->pos] = (Uint8_t)*str;
+		o->pos++;
+		str++;
+	}
+}
+
+static void out_num(out_buf_t *o, unsigned long long v)
+{
+	char tmp[24];
+
+	sprintf(tmp, "%llu", v);
+	out_str(o, tmp);
+}
+
+/* 地址为读写器IP字符串，不可打印字符和引号替换为'_' */
+static void out_addr(out_buf_t *o, const Uint8_t *addr)
+{
+	char tmp[MAX_ADDR_SIZE + 1];
+	int i;
+
+	for (i = 0; i < MAX_ADDR_SIZE && addr[i] != '\0'; i++)
+		tmp[i] = (char)(addr[i] > 0x20 && addr[i] < 0x7F && addr[i] != '"' && addr[i] != '\\' ? addr[i] : '_');
+	tmp[i] = '\0';
+	out_str(o, tmp);
+}
+
+/* 秒为单位的小数，精确到微秒 */
+static void out_sec(out_buf_t *o, unsigned long long us)
+{
+	char tmp[32];
+
+	sprintf(tmp, "%llu.%06llu", us / 1000000ULL, us % 1000000ULL);
+	out_str(o, tmp);
+}
+
+static void out_labels(out_buf_t *o, obj_slot_t *s, const char *cmd)
+{
+	out_str(o, "{addr=\"");
+	out_addr(o, s->addr);
+	out_str(o, "\",model=\"");
+	out_num(o, (unsigned long long)s->model);
+	out_str(o, "\"");
+	if (cmd != NULL) {
+		out_str(o, ",cmd=\"");
+		out_str(o, cmd);
+		out_str(o, "\"");
+	}
+}
+
+static void out_counter(out_buf_t *o, card_metrics_t *m, const char *name, const char *help, size_t field)
+{
+	obj_slot_t *s;
+	Uint16_t i;
+
+	out_str(o, "# HELP ");
+	out_str(o, name);
+	out_str(o, " ");
+	out_str(o, help);
+	out_str(o, "\n# TYPE ");
+	out_str(o, name);
+	out_str(o, " counter\n");
+	for (i = 0; i < m->max; i++) {
+		s = &m->slots[i];
+		if (pt_atomic_load(&s->state) != SLOT_USED)
+			continue;
+		out_str(o, name);
+		out_labels(o, s, NULL);
+		out_str(o, "} ");
+		out_num(o, wide_load((wide_t *)((char *)s + field)));
+		out_str(o, "\n");
+	}
+}
+
+static void export_prom(out_buf_t *o, card_metrics_t *m)
+{
+	static const char *const groups[CARD_METRICS_ERR_GROUPS] = { "other", "0x1xxx", "0x2xxx", "0x3xxx", "0x4xxx" };
+	obj_slot_t *s;
+	cmd_slot_t *c;
+	unsigned long long n;
+	Uint16_t i;
+	Uint8_t k, j;
+
+	out_str(o, "# HELP card_cmd_latency_seconds Reader command latency.\n# TYPE card_cmd_latency_seconds histogram\n");
+	for (i = 0; i < m->max; i++) {
+		s = &m->slots[i];
+		if (pt_atomic_load(&s->state) != SLOT_USED)
+			continue;
+		for (k = 0; k < CARD_CMD_MAX; k++) {
+			c = &s->cmds[k];
+			if (wide_load(&c->count) == 0)
+				continue;
+			n = 0;
+			for (j = 0; j < CARD_METRICS_BUCKETS; j++) {
+				n += wide_load(&c->buckets[j]);
+				out_str(o, "card_cmd_latency_seconds_bucket");
+				out_labels(o, s, cmd_names[k]);
+				out_str(o, ",le=\"");
+				if (j < CARD_METRICS_BUCKETS - 1)
+					out_sec(o, 1ULL << j);
+				else
+					out_str(o, "+Inf");
+				out_str(o, "\"} ");
+				out_num(o, n);
+				out_str(o, "\n");
+			}
+			out_str(o, "card_cmd_latency_seconds_sum");
+			out_labels(o, s, cmd_names[k]);
+			out_str(o, "} ");
+			out_sec(o, wide_load(&c->sum_us));
+			out_str(o, "\ncard_cmd_latency_seconds_count");
+			out_labels(o, s, cmd_names[k]);
+			out_str(o, "} ");
+			out_num(o, n);
+			out_str(o, "\n");
+		}
+	}
+
+	out_str(o, "# HELP card_cmd_errors_total Reader commands that returned an error.\n# TYPE card_cmd_errors_total counter\n");
+	for (i = 0; i < m->max; i++) {
+		s = &m->slots[i];
+		if (pt_atomic_load(&s->state) != SLOT_USED)
+			continue;
+		for (k = 0; k < CARD_CMD_MAX; k++) {
+			c = &s->cmds[k];
+			if (wide_load(&c->count) == 0)
+				continue;
+			out_str(o, "card_cmd_errors_total");
+			out_labels(o, s, cmd_names[k]);
+			out_str(o, "} ");
+			out_num(o, wide_load(&c->errors));
+			out_str(o, "\n");
+		}
+	}
+
+	out_str(o, "# HELP card_errors_total Errors by error code group.\n# TYPE card_errors_total counter\n");
+	for (i = 0; i < m->max; i++) {
+		s = &m->slots[i];
+		if (pt_atomic_load(&s->state) != SLOT_USED)
+			continue;
+		for (k = 0; k < CARD_METRICS_ERR_GROUPS; k++) {
+			out_str(o, "card_errors_total");
+			out_labels(o, s, NULL);
+			out_str(o, ",class=\"");
+			out_str(o, groups[k]);
+			out_str(o, "\"} ");
+			out_num(o, wide_load(&s->err_groups[k]));
+			out_str(o, "\n");
+		}
+	}
+
+	out_counter(o, m, "card_bytes_sent_total", "Bytes sent to the card.", offsetof(obj_slot_t, tx_bytes));
+	out_counter(o, m, "card_bytes_received_total", "Bytes received from the card.", offsetof(obj_slot_t, rx_bytes));
+	out_counter(o, m, "card_reconnects_total", "Reader reconnects.", offsetof(obj_slot_t, reconnects));
+}
+
+static void export_json(out_buf_t *o, card_metrics_t *m)
+{
+	static const char *const groups[CARD_METRICS_ERR_GROUPS] = { "other", "0x1xxx", "0x2xxx", "0x3xxx", "0x4xxx" };
+	obj_slot_t *s;
+	cmd_slot_t *c;
+	Uint16_t i, n = 0;
+	Uint8_t k, j, nc;
+
+	out_str(o, "{\"readers\":[");
+	for (i = 0; i < m->max; i++) {
+		s = &m->slots[i];
+		if (pt_atomic_load(&s->state) != SLOT_USED)
+			continue;
+		out_str(o, n++ != 0 ? ",{\"addr\":\"" : "{\"addr\":\"");
+		out_addr(o, s->addr);
+		out_str(o, "\",\"model\":");
+		out_num(o, (unsigned long long)s->model);
+		out_str(o, s->handle < 0 ? ",\"handle\":-" : ",\"handle\":");
+		out_num(o, s->handle < 0 ? (unsigned long)-(long)s->handle : (unsigned long)s->handle);
+		out_str(o, ",\"tx_bytes\":");
+		out_num(o, wide_load(&s->tx_bytes));
+		out_str(o, ",\"rx_bytes\":");
+		out_num(o, wide_load(&s->rx_bytes));
+		out_str(o, ",\"reconnects\":");
+		out_num(o, wide_load(&s->reconnects));
+		out_str(o, ",\"errors\":{");
+		for (k = 0; k < CARD_METRICS_ERR_GROUPS; k++) {
+			out_str(o, k != 0 ? ",\"" : "\"");
+			out_str(o, groups[k]);
+			out_str(o, "\":");
+			out_num(o, wide_load(&s->err_groups[k]));
+		}
+		out_str(o, "},\"commands\":{");
+		nc = 0;
+		for (k = 0; k < CARD_CMD_MAX; k++) {
+			c = &s->cmds[k];
+			if (wide_load(&c->count) == 0)
+				continue;
+			out_str(o, nc++ != 0 ? ",\"" : "\"");
+			out_str(o, cmd_names[k]);
+			out_str(o, "\":{\"count\":");
+			out_num(o, wide_load(&c->count));
+			out_str(o, ",\"errors\":");
+			out_num(o, wide_load(&c->errors));
+			out_str(o, ",\"sum_us\":");
+			out_num(o, wide_load(&c->sum_us));
+			out_str(o, ",\"max_us\":");
+			out_num(o, (Uint32_t)pt_atomic_load(&c->max_us));
+			out_str(o, ",\"buckets\":[");
+			for (j = 0; j < CARD_METRICS_BUCKETS; j++) {
+				if (j != 0)
+					out_str(o, ",");
+				out_num(o, wide_load(&c->buckets[j]));
+			}
+			out_str(o, "]}");
+		}
+		out_str(o, "}}");
+	}
+	out_str(o, "]}\n");
+}
+
+card_err_t card_metrics_export(card_metrics_t *m, Uint8_t fmt, Uint8_t *buf, Uint32_t size, Uint32_t *len)
+{
+	out_buf_t o;
+
+	if (m == NULL || (buf == NULL && size != 0) || (fmt != CARD_METRICS_FMT_PROM && fmt != CARD_METRICS_FMT_JSON))
+		return 0x3007;
+	o.buf = buf;
+	o.size = size;
+	o.pos = 0;
+	if (fmt == CARD_METRICS_FMT_PROM)
+		export_prom(&o, m);
+	else
+		export_json(&o, m);
+
+	if (len != NULL)
+		*len = o.pos;
+	if (o.pos >= size)
+		return CARD_ERR_BUF_SMALL;
+	buf[o.pos] = '\0';
+	return CARD_NO_ERR;
+}
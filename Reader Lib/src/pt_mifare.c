@@ -0,0 +1,142 @@
+/**
+ * \file	pt_mifare.c
+ * \brief	MIFARE Classic批量读写接口函数
+ * \details	每个扇区只认证一次，认证失败后卡片停止应答，需要继续时重新唤醒并按UID选择。
+ */
+#include <string.h>
+#include "pt_card_ext.h"
+
+/* 扇区0-31每扇区4块，扇区32-39(4K卡)每扇区16块 */
+static Uint8_t sector_first_block(Uint8_t sector)
+{
+	return sector < 32 ? (Uint8_t)(sector * 4) : (Uint8_t)(128 + (sector - 32) * 16);
+}
+
+static Uint8_t sector_blocks(Uint8_t sector)
+{
+	return sector < 32 ? 4 : 16;
+}
+
+static const card_mifare_key_t *sector_key(const card_mifare_key_t *keys, Uint8_t nkeys, Uint8_t i)
+{
+	return nkeys == 1 ? &keys[0] : &keys[i];
+}
+
+/* 认证失败后卡片进入空闲状态，重新唤醒并选择 */
+static card_err_t reactivate(card_obj_t *obj, Uint8_t *uid)
+{
+	Uint16_t atqa;
+	Uint8_t sak;
+	card_err_t ret;
+
+	ret = card_wupa(obj, &atqa);
+	if (ret == CARD_NO_ERR)
+		ret = card_select(obj, uid, 4, &sak);
+	return ret;
+}
+
+static card_err_t check_args(card_obj_t *obj, Uint8_t *uid, const card_mifare_key_t *keys, Uint8_t nkeys,
+	Uint8_t first_sector, Uint8_t nsectors, const Uint8_t *buf)
+{
+	if (uid == NULL || keys == NULL || buf == NULL || nsectors == 0
+		|| (nkeys != 1 && nkeys < nsectors) || first_sector + nsectors > CARD_MIFARE_SECTORS_MAX) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	return CARD_NO_ERR;
+}
+
+/* 按扇区执行，write为0时读，为1时写 */
+static card_err_t sectors_xfer(card_obj_t *obj, int write, Uint8_t *uid, const card_mifare_key_t *keys, Uint8_t nkeys,
+	Uint8_t first_sector, Uint8_t nsectors, Uint8_t *buf, Uint8_t flags, card_err_t *sector_err)
+{
+	const card_mifare_key_t *key;
+	Uint8_t i, j, sector, blk, nblk, keybuf[6];
+	Uint8_t *p = buf;
+	card_err_t ret, first = CARD_NO_ERR;
+	int need_wake = 0;
+
+	if (sector_err != NULL) {
+		for (i = 0; i < nsectors; i++)
+			sector_err[i] = CARD_ERR_NOT_EXECUTED;
+	}
+
+	for (i = 0; i < nsectors; i++) {
+		sector = (Uint8_t)(first_sector + i);
+		blk = sector_first_block(sector);
+		nblk = sector_blocks(sector);
+		key = sector_key(keys, nkeys, i);
+
+		ret = CARD_NO_ERR;
+		if (need_wake) {
+			ret = reactivate(obj, uid);
+			need_wake = 0;
+		}
+		if (ret == CARD_NO_ERR) {
+			memcpy(keybuf, key->key, 6);
+			ret = card_authenticate(obj, blk, key->type, keybuf, uid);
+		}
+		for (j = 0; j < nblk && ret == CARD_NO_ERR; j++) {
+			if (!write) {
+				ret = card_mifare_read(obj, (Uint8_t)(blk + j), p + j * 16);
+				continue;
+			}
+			/* 厂商块和扇区尾块默认不写，缓存中对应数据忽略 */
+			if ((blk + j == 0 && !(flags & CARD_MIFARE_FLAG_BLOCK0))
+				|| (j == nblk - 1 && !(flags & CARD_MIFARE_FLAG_TRAILER)))
+				continue;
+			ret = card_mifare_write(obj, (Uint8_t)(blk + j), p + j * 16);
+		}
+		p += nblk * 16;
+
+		if (sector_err != NULL)
+			sector_err[i] = ret;
+		if (ret == CARD_NO_ERR)
+			continue;
+		if (first == CARD_NO_ERR)
+			first = ret;
+		if (!(flags & CARD_BATCH_FLAG_CONTINUE) || card_err_class(ret) == CARD_ERR_CLASS_LINK)
+			break;
+		need_wake = 1;
+	}
+
+	obj->last_err = first;
+	return first;
+}
+
+card_err_t card_mifare_read_sectors(card_obj_t *obj, Uint8_t *uid, const card_mifare_key_t *keys, Uint8_t nkeys,
+	Uint8_t first_sector, Uint8_t nsectors, Uint8_t *rbuf, Uint8_t flags, card_err_t *sector_err)
+{
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	ret = check_args(obj, uid, keys, nkeys, first_sector, nsectors, rbuf);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	return sectors_xfer(obj, 0, uid, keys, nkeys, first_sector, nsectors, rbuf, flags, sector_err);
+}
+
+card_err_t card_mifare_write_sectors(card_obj_t *obj, Uint8_t *uid, const card_mifare_key_t *keys, Uint8_t nkeys,
+	Uint8_t first_sector, Uint8_t nsectors, const Uint8_t *tbuf, Uint8_t flags, card_err_t *sector_err)
+{
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	ret = check_args(obj, uid, keys, nkeys, first_sector, nsectors, tbuf);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	/* card_mifare_write参数不是const，数据不会被修改 */
+	return sectors_xfer(obj, 1, uid, keys, nkeys, first_sector, nsectors, (Uint8_t *)tbuf, flags, sector_err);
+}
+
+Uint32_t card_mifare_sectors_size(Uint8_t first_sector, Uint8_t nsectors)
+{
+	Uint32_t size = 0;
+	Uint8_t i;
+
+	for (i = 0; i < nsectors && first_sector + i < CARD_MIFARE_SECTORS_MAX; i++)
+		size += sector_blocks((Uint8_t)(first_sector + i)) * 16U;
+	return size;
+}
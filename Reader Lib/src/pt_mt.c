@@ -0,0 +1,42 @@
+/**
+ * \file	pt_mt.c
+ * \brief	多线程打开接口函数
+ * \details	驱动库在第一次打开通信连接时读取配置文件并设置日志开关等全局变量，
+ *			该初始化没有加锁。此处保证初始化完成前的打开操作串行执行，
+ *			初始化完成后的打开操作不加锁。
+ */
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+static pt_slock_t init_lock = PT_SLOCK_INIT;
+static volatile long lib_ready = 0;
+
+card_err_t card_open_mt(card_obj_t *obj, card_mod_t model, Uint8_t *addr)
+{
+	card_err_t ret;
+
+	if (pt_atomic_load(&lib_ready))
+		return card_open(obj, model, addr);
+
+	pt_slock_lock(&init_lock);
+	ret = card_open(obj, model, addr);
+	if (ret == CARD_NO_ERR)
+		pt_atomic_store(&lib_ready, 1);
+	pt_slock_unlock(&init_lock);
+	return ret;
+}
+
+card_err_t ea_card_connect_mt(card_obj_t *obj, Uint8_t *addr)
+{
+	card_err_t ret;
+
+	if (pt_atomic_load(&lib_ready))
+		return ea_card_connect(obj, addr);
+
+	pt_slock_lock(&init_lock);
+	ret = ea_card_connect(obj, addr);
+	if (ret == CARD_NO_ERR)
+		pt_atomic_store(&lib_ready, 1);
+	pt_slock_unlock(&init_lock);
+	return ret;
+}
@@ -0,0 +1,452 @@
+/**
+ * \file	pt_os.h
+ * \brief	扩展接口内部使用的平台相关函数
+ * \details	只供src目录下源文件使用，不对外提供
+ */
+#ifndef _PT_OS_H_
+#define _PT_OS_H_
+
+#if defined(_WIN32) && !defined(WIN32)
+#define WIN32
+#endif
+
+#ifdef WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card.h"
+
+/* 配置结构体布局必须与驱动库一致(32/64位平台相同) */
+typedef char pt_check_cfg_size[sizeof(card_cfg_t) == 38 ? 1 : -1];
+typedef char pt_check_pcfg_size[sizeof(card_pcfg_t) == 53 ? 1 : -1];
+
+#ifdef _MSC_VER
+#define PT_INLINE	static __inline
+#else
+#define PT_INLINE	static __inline__
+#endif
+
+#ifdef WIN32
+typedef CRITICAL_SECTION pt_mutex_t;
+typedef CONDITION_VARIABLE pt_cond_t;
+typedef HANDLE pt_thread_t;
+#else
+typedef pthread_mutex_t pt_mutex_t;
+typedef pthread_cond_t pt_cond_t;
+typedef pthread_t pt_thread_t;
+#endif
+typedef void (*pt_thread_fn)(void *arg);
+
+/* 静态初始化的锁，用于进程内一次性初始化 */
+#ifdef WIN32
+typedef SRWLOCK pt_slock_t;
+#define PT_SLOCK_INIT	SRWLOCK_INIT
+#else
+typedef pthread_mutex_t pt_slock_t;
+#define PT_SLOCK_INIT	PTHREAD_MUTEX_INITIALIZER
+#endif
+
+/* 单调时钟时间，单位微秒 */
+PT_INLINE unsigned long long pt_os_time_us(void)
+{
+#ifdef WIN32
+	LARGE_INTEGER freq, cnt;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&cnt);
+	return (unsigned long long)(cnt.QuadPart / freq.QuadPart) * 1000000ULL
+		+ (unsigned long long)(cnt.QuadPart % freq.QuadPart) * 1000000ULL / freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL;
+#endif
+}
+
+/* 系统时间，单位微秒(1970年起) */
+PT_INLINE unsigned long long pt_os_realtime_us(void)
+{
+#ifdef WIN32
+	FILETIME ft;
+	ULARGE_INTEGER t;
+
+	GetSystemTimeAsFileTime(&ft);
+	t.LowPart = ft.dwLowDateTime;
+	t.HighPart = ft.dwHighDateTime;
+	return (t.QuadPart - 116444736000000000ULL) / 10ULL;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL;
+#endif
+}
+
+/* 互斥锁 */
+PT_INLINE void pt_mutex_init(pt_mutex_t *m)
+{
+#ifdef WIN32
+	InitializeCriticalSection(m);
+#else
+	pthread_mutex_init(m, NULL);
+#endif
+}
+
+PT_INLINE void pt_mutex_destroy(pt_mutex_t *m)
+{
+#ifdef WIN32
+	DeleteCriticalSection(m);
+#else
+	pthread_mutex_destroy(m);
+#endif
+}
+
+PT_INLINE void pt_mutex_lock(pt_mutex_t *m)
+{
+#ifdef WIN32
+	EnterCriticalSection(m);
+#else
+	pthread_mutex_lock(m);
+#endif
+}
+
+PT_INLINE void pt_mutex_unlock(pt_mutex_t *m)
+{
+#ifdef WIN32
+	LeaveCriticalSection(m);
+#else
+	pthread_mutex_unlock(m);
+#endif
+}
+
+PT_INLINE void pt_slock_lock(pt_slock_t *l)
+{
+#ifdef WIN32
+	AcquireSRWLockExclusive(l);
+#else
+	pthread_mutex_lock(l);
+#endif
+}
+
+PT_INLINE void pt_slock_unlock(pt_slock_t *l)
+{
+#ifdef WIN32
+	ReleaseSRWLockExclusive(l);
+#else
+	pthread_mutex_unlock(l);
+#endif
+}
+
+/* 原子操作 */
+PT_INLINE long pt_atomic_load(volatile long *v)
+{
+#ifdef WIN32
+	return InterlockedCompareExchange(v, 0, 0);
+#else
+	return __atomic_load_n(v, __ATOMIC_ACQUIRE);
+#endif
+}
+
+PT_INLINE void pt_atomic_store(volatile long *v, long val)
+{
+#ifdef WIN32
+	InterlockedExchange(v, val);
+#else
+	__atomic_store_n(v, val, __ATOMIC_RELEASE);
+#endif
+}
+
+/* 比较并交换，成功返回1 */
+PT_INLINE int pt_atomic_cas(volatile long *v, long expect, long desired)
+{
+#ifdef WIN32
+	return InterlockedCompareExchange(v, desired, expect) == expect;
+#else
+	return __atomic_compare_exchange_n(v, &expect, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/* 原子加，返回相加后的值 */
+PT_INLINE long pt_atomic_add(volatile long *v, long val)
+{
+#ifdef WIN32
+	return InterlockedExchangeAdd(v, val) + val;
+#else
+	return __atomic_add_fetch(v, val, __ATOMIC_ACQ_REL);
+#endif
+}
+
+/* 条件变量 */
+PT_INLINE void pt_cond_init(pt_cond_t *c)
+{
+#ifdef WIN32
+	InitializeConditionVariable(c);
+#else
+	pthread_cond_init(c, NULL);
+#endif
+}
+
+PT_INLINE void pt_cond_destroy(pt_cond_t *c)
+{
+#ifdef WIN32
+	(void)c;
+#else
+	pthread_cond_destroy(c);
+#endif
+}
+
+PT_INLINE void pt_cond_wait(pt_cond_t *c, pt_mutex_t *m)
+{
+#ifdef WIN32
+	SleepConditionVariableCS(c, m, INFINITE);
+#else
+	pthread_cond_wait(c, m);
+#endif
+}
+
+/* 带超时等待，单位毫秒 */
+PT_INLINE void pt_cond_timedwait(pt_cond_t *c, pt_mutex_t *m, Uint32_t ms)
+{
+#ifdef WIN32
+	SleepConditionVariableCS(c, m, ms);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += ms / 1000;
+	ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+	pthread_cond_timedwait(c, m, &ts);
+#endif
+}
+
+PT_INLINE void pt_cond_broadcast(pt_cond_t *c)
+{
+#ifdef WIN32
+	WakeAllConditionVariable(c);
+#else
+	pthread_cond_broadcast(c);
+#endif
+}
+
+/* 线程 */
+typedef struct pt_thread_start {
+	pt_thread_fn fn;
+	void *arg;
+} pt_thread_start_t;
+
+#ifdef WIN32
+PT_INLINE unsigned __stdcall pt_thread_entry(void *p)
+#else
+PT_INLINE void *pt_thread_entry(void *p)
+#endif
+{
+	pt_thread_start_t start = *(pt_thread_start_t *)p;
+
+	free(p);
+	start.fn(start.arg);
+	return 0;
+}
+
+PT_INLINE int pt_thread_create(pt_thread_t *t, pt_thread_fn fn, void *arg)
+{
+	pt_thread_start_t *start = (pt_thread_start_t *)malloc(sizeof(pt_thread_start_t));
+
+	if (start == NULL)
+		return -1;
+	start->fn = fn;
+	start->arg = arg;
+#ifdef WIN32
+	*t = (HANDLE)_beginthreadex(NULL, 0, pt_thread_entry, start, 0, NULL);
+	if (*t == 0) {
+		free(start);
+		return -1;
+	}
+#else
+	if (pthread_create(t, NULL, pt_thread_entry, start) != 0) {
+		free(start);
+		return -1;
+	}
+#endif
+	return 0;
+}
+
+PT_INLINE void pt_thread_join(pt_thread_t t)
+{
+#ifdef WIN32
+	WaitForSingleObject(t, INFINITE);
+	CloseHandle(t);
+#else
+	pthread_join(t, NULL);
+#endif
+}
+
+/* 毫秒休眠 */
+PT_INLINE void pt_sleep_ms(Uint32_t ms)
+{
+#ifdef WIN32
+	Sleep(ms);
+#else
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+#endif
+}
+
+/* 微秒休眠，Windows精度为毫秒 */
+PT_INLINE void pt_sleep_us(Uint32_t us)
+{
+#ifdef WIN32
+	Sleep((us + 999) / 1000);
+#else
+	struct timespec ts;
+
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (long)(us % 1000000) * 1000L;
+	nanosleep(&ts, NULL);
+#endif
+}
+
+/* 临时文件，驱动库只接受文件路径时用于传递内存数据
+ * Linux优先使用/dev/shm(内存文件系统)，Windows设置临时属性，数据通常不写入磁盘
+ */
+#define PT_PATH_MAX		260
+
+PT_INLINE int pt_temp_write(char *path, const void *buf, Uint32_t len)
+{
+#ifdef WIN32
+	char dir[PT_PATH_MAX];
+	HANDLE h;
+	DWORD n;
+
+	if (GetTempPathA(sizeof(dir), dir) == 0 || GetTempFileNameA(dir, "ptc", 0, path) == 0)
+		return -1;
+	h = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+	if (h == INVALID_HANDLE_VALUE) {
+		DeleteFileA(path);
+		return -1;
+	}
+	if (!WriteFile(h, buf, len, &n, NULL) || n != len) {
+		CloseHandle(h);
+		DeleteFileA(path);
+		return -1;
+	}
+	CloseHandle(h);
+	return 0;
+#else
+	const char *dir = getenv("TMPDIR");
+	const char *p = (const char *)buf;
+	ssize_t n;
+	int fd;
+
+	if (access("/dev/shm", W_OK) == 0)
+		dir = "/dev/shm";
+	else if (dir == NULL || dir[0] == '\0')
+		dir = "/tmp";
+	if ((size_t)snprintf(path, PT_PATH_MAX, "%s/pt_card_XXXXXX", dir) >= PT_PATH_MAX)
+		return -1;
+	fd = mkstemp(path);
+	if (fd < 0)
+		return -1;
+	while (len > 0) {
+		n = write(fd, p, len);
+		if (n <= 0) {
+			close(fd);
+			unlink(path);
+			return -1;
+		}
+		p += n;
+		len -= (Uint32_t)n;
+	}
+	close(fd);
+	return 0;
+#endif
+}
+
+PT_INLINE void pt_temp_remove(const char *path)
+{
+#ifdef WIN32
+	DeleteFileA(path);
+#else
+	unlink(path);
+#endif
+}
+
+/* 完成通知: Linux为管道读端文件描述符, Windows为事件句柄 */
+#ifdef WIN32
+typedef HANDLE pt_notify_t;
+#else
+typedef struct pt_notify {
+	int fds[2];
+} pt_notify_t;
+#endif
+
+PT_INLINE int pt_notify_init(pt_notify_t *n)
+{
+#ifdef WIN32
+	*n = CreateEvent(NULL, TRUE, FALSE, NULL);
+	return *n == NULL ? -1 : 0;
+#else
+	if (pipe(n->fds) != 0)
+		return -1;
+	fcntl(n->fds[0], F_SETFL, fcntl(n->fds[0], F_GETFL) | O_NONBLOCK);
+	fcntl(n->fds[1], F_SETFL, fcntl(n->fds[1], F_GETFL) | O_NONBLOCK);
+	fcntl(n->fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(n->fds[1], F_SETFD, FD_CLOEXEC);
+	return 0;
+#endif
+}
+
+PT_INLINE void pt_notify_destroy(pt_notify_t *n)
+{
+#ifdef WIN32
+	CloseHandle(*n);
+#else
+	close(n->fds[0]);
+	close(n->fds[1]);
+#endif
+}
+
+/* 置为可读 */
+PT_INLINE void pt_notify_set(pt_notify_t *n)
+{
+#ifdef WIN32
+	SetEvent(*n);
+#else
+	char c = 1;
+
+	if (write(n->fds[1], &c, 1) < 0) {
+		/* 管道已满时读端必然可读，忽略 */
+	}
+#endif
+}
+
+/* 清除可读状态 */
+PT_INLINE void pt_notify_clear(pt_notify_t *n)
+{
+#ifdef WIN32
+	ResetEvent(*n);
+#else
+	char buf[64];
+
+	while (read(n->fds[0], buf, sizeof(buf)) > 0)
+		;
+#endif
+}
+
+#endif
@@ -0,0 +1,341 @@
+/**
+ * \file	pt_pool.c
+ * \brief	连接池接口函数
+ * \details	每个读写器IP保持一个通信连接，会话为共享该连接句柄的卡片对象副本，
+ *			只修改卡片模式。驱动库按卡片模式选择命令，接触与非接触会话可共用连接。
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+/* 连接状态 */
+enum {
+	CONN_FREE = 0,
+	CONN_OPENING,		/* 正在打开，其他线程等待 */
+	CONN_READY,
+	CONN_PROBING,		/* 正在健康检查，其他线程等待 */
+	CONN_CLOSING,		/* 正在关闭，其他线程等待 */
+};
+
+typedef struct pool_conn {
+	card_obj_t obj;					/* 打开连接使用的卡片对象 */
+	Uint8_t state;
+	Uint8_t bad;					/* 通信层出错，引用释放后关闭 */
+	Uint16_t refs;					/* 使用中的会话个数 */
+	unsigned long long last_use_us;
+	pt_mutex_t lock;				/* 同一连接上的命令互斥 */
+} pool_conn_t;
+
+struct card_pool {
+	pool_conn_t *conns;
+	Uint16_t max_conns;
+	Uint32_t keepalive_ms;
+	int stop;
+	int has_thread;
+	pt_mutex_t lock;
+	pt_cond_t cond;
+	pt_thread_t thread;
+};
+
+static int is_contactless(card_mod_t model)
+{
+	return model >= MODEL_P14443A && model <= MODEL_P15693;
+}
+
+static pool_conn_t *find_conn(card_pool_t *pool, const Uint8_t *addr)
+{
+	Uint16_t i;
+
+	for (i = 0; i < pool->max_conns; i++) {
+		if (pool->conns[i].state != CONN_FREE && !pool->conns[i].bad
+			&& strncmp((const char *)pool->conns[i].obj.addr, (const char *)addr, MAX_ADDR_SIZE) == 0)
+			return &pool->conns[i];
+	}
+	return NULL;
+}
+
+static pool_conn_t *find_handle(card_pool_t *pool, const card_obj_t *obj)
+{
+	Uint16_t i;
+
+	for (i = 0; i < pool->max_conns; i++) {
+		if (pool->conns[i].state != CONN_FREE && pool->conns[i].obj.handle == obj->handle
+			&& memcmp(pool->conns[i].obj.addr, obj->addr, MAX_ADDR_SIZE) == 0)
+			return &pool->conns[i];
+	}
+	return NULL;
+}
+
+/* 关闭连接。调用时持有池锁，关闭期间释放池锁，一个无应答的读写器不阻塞其他连接 */
+static void close_conn(card_pool_t *pool, pool_conn_t *c)
+{
+	c->state = CONN_CLOSING;
+	pt_mutex_unlock(&pool->lock);
+	card_close(&c->obj);
+	pt_mutex_lock(&pool->lock);
+	c->state = CONN_FREE;
+	pt_cond_broadcast(&pool->cond);
+}
+
+/* 查找空闲位置，没有时返回最久未使用的空闲连接，由调用者关闭。调用时持有池锁 */
+static pool_conn_t *alloc_conn(card_pool_t *pool)
+{
+	pool_conn_t *idle = NULL;
+	Uint16_t i;
+
+	for (i = 0; i < pool->max_conns; i++) {
+		if (pool->conns[i].state == CONN_FREE)
+			return &pool->conns[i];
+		if (pool->conns[i].state == CONN_READY && pool->conns[i].refs == 0
+			&& (idle == NULL || pool->conns[i].last_use_us < idle->last_use_us))
+			idle = &pool->conns[i];
+	}
+	return idle;
+}
+
+/* 检查空闲连接，出错时关闭。调用时持有池锁，检查期间释放池锁 */
+static void probe_conn(card_pool_t *pool, pool_conn_t *c)
+{
+	Uint8_t info[64];
+	card_err_t ret;
+
+	c->state = CONN_PROBING;
+	pt_mutex_unlock(&pool->lock);
+	pt_mutex_lock(&c->lock);
+	ret = card_getinfo(&c->obj, info);
+	pt_mutex_unlock(&c->lock);
+	pt_mutex_lock(&pool->lock);
+
+	c->last_use_us = pt_os_time_us();
+	if (ret != CARD_NO_ERR) {
+		close_conn(pool, c);
+		return;
+	}
+	c->state = CONN_READY;
+	pt_cond_broadcast(&pool->cond);
+}
+
+static void keepalive_worker(void *p)
+{
+	card_pool_t *pool = (card_pool_t *)p;
+	unsigned long long now;
+	Uint16_t i;
+
+	pt_mutex_lock(&pool->lock);
+	while (!pool->stop) {
+		pt_cond_timedwait(&pool->cond, &pool->lock, pool->keepalive_ms);
+		now = pt_os_time_us();
+		for (i = 0; i < pool->max_conns && !pool->stop; i++) {
+			if (pool->conns[i].state == CONN_READY && pool->conns[i].refs == 0
+				&& now - pool->conns[i].last_use_us >= (unsigned long long)pool->keepalive_ms * 1000ULL)
+				probe_conn(pool, &pool->conns[i]);
+		}
+	}
+	pt_mutex_unlock(&pool->lock);
+}
+
+card_err_t card_pool_create(card_pool_t **pool, Uint16_t max_conns, Uint32_t keepalive_ms)
+{
+	card_pool_t *p;
+	Uint16_t i;
+
+	if (pool == NULL || max_conns == 0)
+		return 0x3007;
+
+	p = (card_pool_t *)calloc(1, sizeof(card_pool_t));
+	if (p == NULL)
+		return 0x4012;
+	p->conns = (pool_conn_t *)calloc(max_conns, sizeof(pool_conn_t));
+	if (p->conns == NULL) {
+		free(p);
+		return 0x4012;
+	}
+	p->max_conns = max_conns;
+	p->keepalive_ms = keepalive_ms;
+	for (i = 0; i < max_conns; i++)
+		pt_mutex_init(&p->conns[i].lock);
+	pt_mutex_init(&p->lock);
+	pt_cond_init(&p->cond);
+
+	if (keepalive_ms > 0) {
+		if (pt_thread_create(&p->thread, keepalive_worker, p) != 0) {
+			card_pool_destroy(p);
+			return 0x4012;
+		}
+		p->has_thread = 1;
+	}
+
+	*pool = p;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_pool_destroy(card_pool_t *pool)
+{
+	Uint16_t i;
+
+	if (pool == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pt_cond_broadcast(&pool->cond);
+	pt_mutex_unlock(&pool->lock);
+	if (pool->has_thread)
+		pt_thread_join(pool->thread);
+
+	for (i = 0; i < pool->max_conns; i++) {
+		if (pool->conns[i].state != CONN_FREE)
+			card_close(&pool->conns[i].obj);
+		pt_mutex_destroy(&pool->conns[i].lock);
+	}
+	pt_cond_destroy(&pool->cond);
+	pt_mutex_destroy(&pool->lock);
+	free(pool->conns);
+	free(pool);
+	return CARD_NO_ERR;
+}
+
+card_err_t card_pool_acquire(card_pool_t *pool, Uint8_t *addr, card_mod_t model, card_obj_t *obj)
+{
+	pool_conn_t *c;
+	card_err_t ret = CARD_NO_ERR;
+
+	if (pool == NULL || addr == NULL || obj == NULL)
+		return 0x3007;
+	if (strlen((const char *)addr) >= MAX_ADDR_SIZE)
+		return 0x3004;
+
+	pt_mutex_lock(&pool->lock);
+	for (;;) {
+		c = find_conn(pool, addr);
+		if (c == NULL) {
+			c = alloc_conn(pool);
+			if (c == NULL || c->state == CONN_FREE)
+				break;
+			/* 关闭最久未使用的空闲连接，期间可能有其他线程打开同一地址，之后重新查找 */
+			close_conn(pool, c);
+			continue;
+		}
+		if (c->state != CONN_READY) {
+			pt_cond_wait(&pool->cond, &pool->lock);
+			continue;
+		}
+		/* 空闲超过保活时间的连接先检查再使用 */
+		if (pool->keepalive_ms > 0 && c->refs == 0
+			&& pt_os_time_us() - c->last_use_us >= (unsigned long long)pool->keepalive_ms * 1000ULL) {
+			probe_conn(pool, c);
+			continue;
+		}
+		break;
+	}
+
+	if (c == NULL) {
+		pt_mutex_unlock(&pool->lock);
+		return CARD_ERR_POOL_FULL;
+	}
+	if (c->state == CONN_FREE) {
+		memset(&c->obj, 0, sizeof(card_obj_t));
+		strcpy((char *)c->obj.addr, (const char *)addr);
+		c->state = CONN_OPENING;
+		c->bad = 0;
+		c->refs = 0;
+		pt_mutex_unlock(&pool->lock);
+
+		ret = card_open_mt(&c->obj, model, addr);
+
+		pt_mutex_lock(&pool->lock);
+		c->state = ret == CARD_NO_ERR ? CONN_READY : CONN_FREE;
+		c->last_use_us = pt_os_time_us();
+		pt_cond_broadcast(&pool->cond);
+		if (ret != CARD_NO_ERR) {
+			pt_mutex_unlock(&pool->lock);
+			obj->last_err = ret;
+			return ret;
+		}
+	}
+	c->refs++;
+	pt_mutex_unlock(&pool->lock);
+
+	pt_mutex_lock(&c->lock);
+	*obj = c->obj;
+	obj->model = model;
+	obj->last_err = CARD_NO_ERR;
+	if (is_contactless(model) && model != c->obj.model) {
+		ret = card_setmodel(obj, model);
+		if (ret == CARD_NO_ERR)
+			c->obj.model = model;
+	}
+	pt_mutex_unlock(&c->lock);
+
+	if (ret != CARD_NO_ERR)
+		card_pool_release(pool, obj);
+	return ret;
+}
+
+card_err_t card_pool_release(card_pool_t *pool, card_obj_t *obj)
+{
+	pool_conn_t *c;
+
+	if (pool == NULL || obj == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&pool->lock);
+	c = find_handle(pool, obj);
+	if (c == NULL || c->refs == 0) {
+		pt_mutex_unlock(&pool->lock);
+		return 0x4003;
+	}
+	c->refs--;
+	c->last_use_us = pt_os_time_us();
+	if (card_err_class(obj->last_err) == CARD_ERR_CLASS_LINK)
+		c->bad = 1;
+	if (c->bad && c->refs == 0)
+		close_conn(pool, c);
+	pt_mutex_unlock(&pool->lock);
+
+	obj->handle = -1;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_pool_lock(card_pool_t *pool, card_obj_t *obj)
+{
+	pool_conn_t *c;
+	card_err_t ret = CARD_NO_ERR;
+
+	if (pool == NULL || obj == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&pool->lock);
+	c = find_handle(pool, obj);
+	pt_mutex_unlock(&pool->lock);
+	if (c == NULL)
+		return 0x4003;
+	pt_mutex_lock(&c->lock);
+	/* 其他会话可能已切换连接的卡片模式 */
+	if (is_contactless(obj->model) && obj->model != c->obj.model) {
+		ret = card_setmodel(obj, obj->model);
+		if (ret != CARD_NO_ERR) {
+			pt_mutex_unlock(&c->lock);
+			return ret;
+		}
+		c->obj.model = obj->model;
+	}
+	return CARD_NO_ERR;
+}
+
+card_err_t card_pool_unlock(card_pool_t *pool, card_obj_t *obj)
+{
+	pool_conn_t *c;
+
+	if (pool == NULL || obj == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&pool->lock);
+	c = find_handle(pool, obj);
+	pt_mutex_unlock(&pool->lock);
+	if (c == NULL)
+		return 0x4003;
+	pt_mutex_unlock(&c->lock);
+	return CARD_NO_ERR;
+}
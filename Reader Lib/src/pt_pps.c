@@ -0,0 +1,286 @@
+/**
+ * \file	pt_pps.c
+ * \brief	接触卡片PPS自动选择接口函数
+ * \details	按ATR中TA1允许的最大速率开始，每次复位后PPS并发送校验APDU，
+ *			失败时降低速率或时钟频率再试。结果按ATR保存，相同ATR的卡片直接使用。
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+/* 时钟频率转换因子F和最大时钟频率(KHz)，按Fi索引 */
+static const Uint16_t fi_table[16] = {
+	372, 372, 558, 744, 1116, 1488, 1860, 0, 0, 512, 768, 1024, 1536, 2048, 0, 0
+};
+static const Uint16_t fmax_table[16] = {
+	4000, 5000, 6000, 8000, 12000, 16000, 20000, 0, 0, 5000, 7500, 10000, 15000, 20000, 0, 0
+};
+/* 波特率调整因子D，按Di索引 */
+static const Uint8_t di_table[16] = {
+	0, 1, 2, 4, 8, 16, 32, 64, 12, 20, 0, 0, 0, 0, 0, 0
+};
+
+typedef struct pps_entry {
+	Uint8_t atr[ATR_DATA_LEN];
+	Uint8_t atr_len;
+	card_pps_result_t res;
+	unsigned long use;			/* 最近使用序号，满时替换最小的 */
+} pps_entry_t;
+
+struct card_pps_cache {
+	pps_entry_t entries[CARD_PPS_CACHE_MAX];
+	Uint16_t count;
+	unsigned long use;
+	pt_mutex_t lock;
+};
+
+typedef struct pps_cand {
+	Uint16_t freq;
+	Uint8_t di;
+	Uint32_t baud;
+} pps_cand_t;
+
+card_err_t card_pps_cache_create(card_pps_cache_t **cache)
+{
+	card_pps_cache_t *c;
+
+	if (cache == NULL)
+		return 0x3007;
+	c = (card_pps_cache_t *)calloc(1, sizeof(card_pps_cache_t));
+	if (c == NULL)
+		return 0x4012;
+	pt_mutex_init(&c->lock);
+	*cache = c;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_pps_cache_destroy(card_pps_cache_t *cache)
+{
+	if (cache == NULL)
+		return 0x3007;
+	pt_mutex_destroy(&cache->lock);
+	free(cache);
+	return CARD_NO_ERR;
+}
+
+static pps_entry_t *cache_find(card_pps_cache_t *cache, const Uint8_t *atr, Uint8_t atr_len)
+{
+	Uint16_t i;
+
+	for (i = 0; i < cache->count; i++) {
+		if (cache->entries[i].atr_len == atr_len && memcmp(cache->entries[i].atr, atr, atr_len) == 0)
+			return &cache->entries[i];
+	}
+	return NULL;
+}
+
+static int cache_get(card_pps_cache_t *cache, const Uint8_t *atr, Uint8_t atr_len, card_pps_result_t *res)
+{
+	pps_entry_t *e;
+
+	if (cache == NULL)
+		return 0;
+	pt_mutex_lock(&cache->lock);
+	e = cache_find(cache, atr, atr_len);
+	if (e != NULL) {
+		e->use = ++cache->use;
+		*res = e->res;
+	}
+	pt_mutex_unlock(&cache->lock);
+	return e != NULL;
+}
+
+static void cache_put(card_pps_cache_t *cache, const Uint8_t *atr, Uint8_t atr_len, const card_pps_result_t *res)
+{
+	pps_entry_t *e;
+	Uint16_t i;
+
+	if (cache == NULL)
+		return;
+	pt_mutex_lock(&cache->lock);
+	e = cache_find(cache, atr, atr_len);
+	if (e == NULL && cache->count < CARD_PPS_CACHE_MAX) {
+		e = &cache->entries[cache->count++];
+	} else if (e == NULL) {
+		e = &cache->entries[0];
+		for (i = 1; i < CARD_PPS_CACHE_MAX; i++) {
+			if (cache->entries[i].use < e->use)
+				e = &cache->entries[i];
+		}
+	}
+	memcpy(e->atr, atr, atr_len);
+	e->atr_len = atr_len;
+	e->res = *res;
+	e->use = ++cache->use;
+	pt_mutex_unlock(&cache->lock);
+}
+
+static void cache_drop(card_pps_cache_t *cache, const Uint8_t *atr, Uint8_t atr_len)
+{
+	pps_entry_t *e;
+
+	if (cache == NULL)
+		return;
+	pt_mutex_lock(&cache->lock);
+	e = cache_find(cache, atr, atr_len);
+	if (e != NULL)
+		*e = cache->entries[--cache->count];
+	pt_mutex_unlock(&cache->lock);
+}
+
+/* 取得TA1和第一个协议，ATR无TA1时返回0x11 */
+static Uint8_t atr_ta1(const card_obj_t *obj, Uint8_t *prot)
+{
+	Uint8_t t0, ta1 = 0x11;
+	int pos = 2;
+
+	*prot = 0;
+	if (obj->atr_len < 2)
+		return ta1;
+	t0 = obj->atr[1];
+	if ((t0 & 0x10) && pos < obj->atr_len)
+		ta1 = obj->atr[pos++];
+	if (t0 & 0x20)
+		pos++;
+	if (t0 & 0x40)
+		pos++;
+	if ((t0 & 0x80) && pos < obj->atr_len)
+		*prot = (Uint8_t)(obj->atr[pos] & 0x0F);
+	return ta1;
+}
+
+/* 复位后PPS并校验，pps0为0时不进行PPS */
+static card_err_t try_pps(card_obj_t *obj, const card_pps_tune_t *cfg, Uint16_t *cur_freq, const card_pps_result_t *res)
+{
+	card_apdu_res_t ar;
+	Uint8_t rbuf[CARD_PPS_EXPECT_MAX + 2];
+	Uint8_t i, rounds = cfg->rounds != 0 ? cfg->rounds : 1;
+	card_err_t ret = CARD_NO_ERR;
+
+	if (res->freq != 0 && res->freq != *cur_freq) {
+		ret = card_setfreq(obj, res->freq);
+		if (ret != CARD_NO_ERR)
+			return ret;
+		*cur_freq = res->freq;
+	}
+	ret = card_reset(obj);
+	if (ret == CARD_NO_ERR && res->pps0 != 0)
+		ret = card_pps(obj, res->pps0, res->pps1);
+	for (i = 0; i < rounds && ret == CARD_NO_ERR; i++) {
+		memset(&ar, 0, sizeof(ar));
+		ar.rbuf = rbuf;
+		ar.rsize = sizeof(rbuf);
+		ret = card_pipe_batch(obj, &cfg->echo, 1, &ar, 0);
+		if (ret == CARD_NO_ERR && cfg->expect != NULL
+			&& (ar.rlen != cfg->expect_len + 2 || memcmp(rbuf, cfg->expect, cfg->expect_len) != 0)) {
+			ret = CARD_ERR_SW_UNEXPECTED;
+			obj->last_err = ret;
+		}
+	}
+	return ret;
+}
+
+static int cand_cmp(const void *a, const void *b)
+{
+	const pps_cand_t *x = (const pps_cand_t *)a, *y = (const pps_cand_t *)b;
+
+	if (x->baud != y->baud)
+		return x->baud < y->baud ? 1 : -1;
+	/* 速率相同时优先使用较低的时钟 */
+	return x->freq < y->freq ? -1 : x->freq > y->freq;
+}
+
+card_err_t card_pps_tune(card_obj_t *obj, const card_pps_tune_t *cfg, card_pps_cache_t *cache, card_pps_result_t *result)
+{
+	pps_cand_t cands[CARD_PPS_FREQS_MAX * 8];
+	Uint8_t atr[ATR_DATA_LEN], atr_len, ta1, prot, fi, di, i, j, nfreq;
+	Uint16_t cur_freq = 0, freq, base_freq = 0, n = 0, k;
+	card_pps_result_t res;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (cfg == NULL || cfg->echo.tbuf == NULL || cfg->echo.tlen == 0 || cfg->freqs_n > CARD_PPS_FREQS_MAX
+		|| (cfg->freqs == NULL && cfg->freqs_n != 0) || (cfg->expect != NULL && cfg->expect_len > CARD_PPS_EXPECT_MAX)
+		|| obj->atr_len == 0) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+
+	atr_len = obj->atr_len < ATR_DATA_LEN ? obj->atr_len : ATR_DATA_LEN;
+	memcpy(atr, obj->atr, atr_len);
+	ret = card_getfreq(obj, &cur_freq);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	base_freq = cur_freq;
+
+	/* 已有结果时只校验一次，失败后重新选择 */
+	if (cache_get(cache, atr, atr_len, &res)) {
+		ret = try_pps(obj, cfg, &cur_freq, &res);
+		if (ret == CARD_NO_ERR) {
+			res.cached = 1;
+			if (result != NULL)
+				*result = res;
+			return CARD_NO_ERR;
+		}
+		if (card_err_class(ret) == CARD_ERR_CLASS_LINK)
+			return ret;
+		cache_drop(cache, atr, atr_len);
+	}
+
+	ta1 = atr_ta1(obj, &prot);
+	fi = (Uint8_t)(ta1 >> 4);
+	di = (Uint8_t)(ta1 & 0x0F);
+	nfreq = cfg->freqs_n != 0 ? cfg->freqs_n : 1;
+	if (fi_table[fi] != 0 && di_table[di] > 1) {
+		for (i = 0; i < nfreq; i++) {
+			freq = cfg->freqs_n != 0 ? cfg->freqs[i] : 0;
+			if (freq > fmax_table[fi])
+				continue;
+			/* 相同Fi下不超过卡片Di的全部D值 */
+			for (j = 2; j < 10; j++) {
+				if (di_table[j] > di_table[di] || n >= CARD_PPS_FREQS_MAX * 8)
+					continue;
+				cands[n].freq = freq;
+				cands[n].di = j;
+				cands[n].baud = (Uint32_t)(((unsigned long long)(freq != 0 ? freq : base_freq) * 1000ULL
+					* di_table[j]) / fi_table[fi]);
+				n++;
+			}
+		}
+		qsort(cands, n, sizeof(pps_cand_t), cand_cmp);
+	}
+
+	memset(&res, 0, sizeof(res));
+	for (k = 0; k < n; k++) {
+		res.pps0 = (Uint8_t)(0x10 | prot);
+		res.pps1 = (Uint8_t)((fi << 4) | cands[k].di);
+		res.freq = cands[k].freq;
+		res.baud = cands[k].baud;
+		ret = try_pps(obj, cfg, &cur_freq, &res);
+		if (ret == CARD_NO_ERR)
+			break;
+		if (card_err_class(ret) == CARD_ERR_CLASS_LINK)
+			return ret;
+	}
+
+	/* 全部失败时使用默认速率和原时钟 */
+	if (k == n) {
+		res.pps0 = 0;
+		res.pps1 = 0x11;
+		res.freq = base_freq;
+		res.baud = (Uint32_t)(base_freq * 1000UL / 372);
+		ret = try_pps(obj, cfg, &cur_freq, &res);
+		if (ret != CARD_NO_ERR)
+			return ret;
+	}
+
+	if (res.freq == 0)
+		res.freq = base_freq;
+	res.cached = 0;
+	cache_put(cache, atr, atr_len, &res);
+	if (result != NULL)
+		*result = res;
+	return CARD_NO_ERR;
+}
@@ -0,0 +1,315 @@
+/**
+ * \file	pt_profile.c
+ * \brief	会话配置模板接口函数
+ * \details	读写器没有整体配置命令，模板按顺序调用各设置函数。调用者保存读写器当前配置时，
+ *			与当前配置相同的项目不再发送，连续处理同类卡片时每张卡只需复位和PPS。
+ */
+#include <stddef.h>
+#include <string.h>
+#include "pt_card_ext.h"
+
+/* 序列化格式版本 */
+#define PROFILE_VERSION		1
+
+/* 读写器级别的配置项目，PPS和ETU属于单张卡片，复位后总是重新设置 */
+#define PROFILE_READER_FIELDS	(CARD_PROFILE_MODEL | CARD_PROFILE_VCC | CARD_PROFILE_FREQ \
+	| CARD_PROFILE_CFG | CARD_PROFILE_PCFG)
+
+typedef struct profile_field {
+	Uint16_t offset;
+	Uint8_t size;
+} profile_field_t;
+
+#define FIELD(type, member)	{ (Uint16_t)offsetof(type, member), (Uint8_t)sizeof(((type *)0)->member) }
+
+/* 配置结构体按字段逐个以小端序保存，与编译器和平台无关 */
+static const profile_field_t cfg_fields[] = {
+	FIELD(card_cfg_t, mask), FIELD(card_cfg_t, n), FIELD(card_cfg_t, wwt), FIELD(card_cfg_t, cwt),
+	FIELD(card_cfg_t, bwt), FIELD(card_cfg_t, nad), FIELD(card_cfg_t, ifsc), FIELD(card_cfg_t, tswt),
+	FIELD(card_cfg_t, tswwt), FIELD(card_cfg_t, rstwt), FIELD(card_cfg_t, t1reties), FIELD(card_cfg_t, ppsgt),
+	FIELD(card_cfg_t, auto_resp), FIELD(card_cfg_t, auto_rele), FIELD(card_cfg_t, auto_pps),
+	FIELD(card_cfg_t, wwt_ms), FIELD(card_cfg_t, comm_prot)
+};
+
+static const profile_field_t pcfg_fields[] = {
+	FIELD(card_pcfg_t, mask), FIELD(card_pcfg_t, fsdi), FIELD(card_pcfg_t, fwi), FIELD(card_pcfg_t, fwt),
+	FIELD(card_pcfg_t, dri), FIELD(card_pcfg_t, dsi), FIELD(card_pcfg_t, ds), FIELD(card_pcfg_t, dr),
+	FIELD(card_pcfg_t, sof), FIELD(card_pcfg_t, eof), FIELD(card_pcfg_t, egt), FIELD(card_pcfg_t, frame_flag),
+	FIELD(card_pcfg_t, system_code), FIELD(card_pcfg_t, nad), FIELD(card_pcfg_t, cid), FIELD(card_pcfg_t, fsci),
+	FIELD(card_pcfg_t, rfon_wait), FIELD(card_pcfg_t, rfoff_wait), FIELD(card_pcfg_t, afdt),
+	FIELD(card_pcfg_t, err_reemit), FIELD(card_pcfg_t, sfgi), FIELD(card_pcfg_t, sfgt), FIELD(card_pcfg_t, afi),
+	FIELD(card_pcfg_t, slot_no), FIELD(card_pcfg_t, tr0tr1), FIELD(card_pcfg_t, afwt), FIELD(card_pcfg_t, asfgt)
+};
+
+#define NFIELDS(t)	(sizeof(t) / sizeof((t)[0]))
+
+static Uint32_t get_le(const Uint8_t *p, int n)
+{
+	Uint32_t v = 0;
+
+	while (n-- > 0)
+		v = (v << 8) | p[n];
+	return v;
+}
+
+static void put_le(Uint8_t *p, Uint32_t v, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		p[i] = (Uint8_t)(v >> (8 * i));
+}
+
+static Uint32_t get_native(const Uint8_t *p, Uint8_t size)
+{
+	Uint16_t v16;
+	Uint32_t v32;
+
+	switch (size) {
+	case 1:
+		return p[0];
+	case 2:
+		memcpy(&v16, p, 2);
+		return v16;
+	default:
+		memcpy(&v32, p, 4);
+		return v32;
+	}
+}
+
+static void put_native(Uint8_t *p, Uint8_t size, Uint32_t v)
+{
+	Uint16_t v16 = (Uint16_t)v;
+
+	switch (size) {
+	case 1:
+		p[0] = (Uint8_t)v;
+		break;
+	case 2:
+		memcpy(p, &v16, 2);
+		break;
+	default:
+		memcpy(p, &v, 4);
+		break;
+	}
+}
+
+static Uint32_t save_struct(Uint8_t *out, const void *s, const profile_field_t *fields, Uint32_t n)
+{
+	Uint32_t i, pos = 0;
+
+	for (i = 0; i < n; i++) {
+		put_le(out + pos, get_native((const Uint8_t *)s + fields[i].offset, fields[i].size), fields[i].size);
+		pos += fields[i].size;
+	}
+	return pos;
+}
+
+static Uint32_t load_struct(const Uint8_t *in, void *s, const profile_field_t *fields, Uint32_t n)
+{
+	Uint32_t i, pos = 0;
+
+	for (i = 0; i < n; i++) {
+		put_native((Uint8_t *)s + fields[i].offset, fields[i].size, get_le(in + pos, fields[i].size));
+		pos += fields[i].size;
+	}
+	return pos;
+}
+
+card_err_t card_profile_save(const card_profile_t *p, Uint8_t *buf, Uint32_t size, Uint32_t *len)
+{
+	Uint32_t pos = 0;
+
+	if (p == NULL || buf == NULL)
+		return 0x3007;
+	if (size < CARD_PROFILE_SIZE)
+		return CARD_ERR_BUF_SMALL;
+
+	memcpy(buf, "PTPF", 4);
+	pos += 4;
+	buf[pos++] = PROFILE_VERSION;
+	put_le(buf + pos, p->fields, 4);
+	pos += 4;
+	memset(buf + pos, 0, CARD_PROFILE_NAME_MAX);
+	strncpy((char *)buf + pos, p->name, CARD_PROFILE_NAME_MAX - 1);
+	pos += CARD_PROFILE_NAME_MAX;
+	buf[pos++] = (Uint8_t)p->model;
+	put_le(buf + pos, p->vcc, 2);
+	pos += 2;
+	put_le(buf + pos, p->freq, 2);
+	pos += 2;
+	buf[pos++] = p->pps0;
+	buf[pos++] = p->pps1;
+	put_le(buf + pos, p->etu, 2);
+	pos += 2;
+	pos += save_struct(buf + pos, &p->cfg, cfg_fields, NFIELDS(cfg_fields));
+	pos += save_struct(buf + pos, &p->pcfg, pcfg_fields, NFIELDS(pcfg_fields));
+
+	if (len != NULL)
+		*len = pos;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_profile_load(card_profile_t *p, const Uint8_t *buf, Uint32_t len)
+{
+	Uint32_t pos = 0;
+
+	if (p == NULL || buf == NULL || len < CARD_PROFILE_SIZE || memcmp(buf, "PTPF", 4) != 0
+		|| buf[4] != PROFILE_VERSION)
+		return 0x3007;
+
+	memset(p, 0, sizeof(*p));
+	pos += 5;
+	p->fields = get_le(buf + pos, 4);
+	pos += 4;
+	memcpy(p->name, buf + pos, CARD_PROFILE_NAME_MAX - 1);
+	pos += CARD_PROFILE_NAME_MAX;
+	p->model = (card_mod_t)buf[pos++];
+	p->vcc = (Uint16_t)get_le(buf + pos, 2);
+	pos += 2;
+	p->freq = (Uint16_t)get_le(buf + pos, 2);
+	pos += 2;
+	p->pps0 = buf[pos++];
+	p->pps1 = buf[pos++];
+	p->etu = (Uint16_t)get_le(buf + pos, 2);
+	pos += 2;
+	pos += load_struct(buf + pos, &p->cfg, cfg_fields, NFIELDS(cfg_fields));
+	load_struct(buf + pos, &p->pcfg, pcfg_fields, NFIELDS(pcfg_fields));
+	return CARD_NO_ERR;
+}
+
+/* 当前配置中已有相同的项目时返回1 */
+static int same(const card_profile_t *p, const card_profile_t *cur, Uint32_t field)
+{
+	if (cur == NULL || !(cur->fields & field))
+		return 0;
+	switch (field) {
+	case CARD_PROFILE_MODEL:
+		return cur->model == p->model;
+	case CARD_PROFILE_VCC:
+		return cur->vcc == p->vcc;
+	case CARD_PROFILE_FREQ:
+		return cur->freq == p->freq;
+	case CARD_PROFILE_CFG:
+		return memcmp(&cur->cfg, &p->cfg, sizeof(card_cfg_t)) == 0;
+	case CARD_PROFILE_PCFG:
+		return memcmp(&cur->pcfg, &p->pcfg, sizeof(card_pcfg_t)) == 0;
+	default:
+		return 0;
+	}
+}
+
+/* 设置读写器级别的项目，成功的项目记录到cur */
+static card_err_t apply_reader(card_obj_t *obj, const card_profile_t *p, card_profile_t *cur)
+{
+	card_cfg_t cfg;
+	card_pcfg_t pcfg;
+	card_err_t ret = CARD_NO_ERR;
+	Uint32_t field;
+
+	for (field = CARD_PROFILE_MODEL; field & PROFILE_READER_FIELDS; field <<= 1) {
+		if (!(p->fields & field) || same(p, cur, field))
+			continue;
+		switch (field) {
+		case CARD_PROFILE_MODEL:
+			ret = card_setmodel(obj, p->model);
+			break;
+		case CARD_PROFILE_VCC:
+			ret = card_setvcc(obj, p->vcc);
+			break;
+		case CARD_PROFILE_FREQ:
+			ret = card_setfreq(obj, p->freq);
+			break;
+		case CARD_PROFILE_CFG:
+			/* card_cfg可能回写结构体，使用副本 */
+			cfg = p->cfg;
+			ret = card_cfg(obj, &cfg);
+			break;
+		case CARD_PROFILE_PCFG:
+			pcfg = p->pcfg;
+			ret = card_pcfg(obj, &pcfg);
+			break;
+		}
+		if (ret != CARD_NO_ERR)
+			break;
+		if (cur == NULL)
+			continue;
+		switch (field) {
+		case CARD_PROFILE_MODEL:
+			cur->model = p->model;
+			break;
+		case CARD_PROFILE_VCC:
+			cur->vcc = p->vcc;
+			break;
+		case CARD_PROFILE_FREQ:
+			cur->freq = p->freq;
+			break;
+		case CARD_PROFILE_CFG:
+			cur->cfg = p->cfg;
+			break;
+		case CARD_PROFILE_PCFG:
+			cur->pcfg = p->pcfg;
+			break;
+		}
+		cur->fields |= field;
+	}
+	return ret;
+}
+
+static card_err_t apply_card(card_obj_t *obj, const card_profile_t *p)
+{
+	card_err_t ret = CARD_NO_ERR;
+
+	if (p->fields & CARD_PROFILE_PPS)
+		ret = card_pps(obj, p->pps0, p->pps1);
+	if (ret == CARD_NO_ERR && (p->fields & CARD_PROFILE_ETU))
+		ret = card_etu(obj, p->etu);
+	return ret;
+}
+
+card_err_t card_profile_apply(card_obj_t *obj, const card_profile_t *p, card_profile_t *cur)
+{
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (p == NULL) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	ret = apply_reader(obj, p, cur);
+	if (ret == CARD_NO_ERR)
+		ret = apply_card(obj, p);
+	return ret;
+}
+
+card_err_t card_profile_reset(card_obj_t *obj, const card_profile_t *p, card_profile_t *cur)
+{
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (p == NULL) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	ret = apply_reader(obj, p, cur);
+	if (ret == CARD_NO_ERR)
+		ret = card_reset(obj);
+	if (ret == CARD_NO_ERR)
+		ret = apply_card(obj, p);
+	return ret;
+}
+
+const card_profile_t *card_profile_find(const card_profile_t *profiles, Uint16_t n, const char *name)
+{
+	Uint16_t i;
+
+	if (profiles == NULL || name == NULL)
+		return NULL;
+	for (i = 0; i < n; i++) {
+		if (strncmp(profiles[i].name, name, CARD_PROFILE_NAME_MAX) == 0)
+			return &profiles[i];
+	}
+	return NULL;
+}
@@ -0,0 +1,287 @@
+/**
+ * \file	pt_retry.c
+ * \brief	错误重试和恢复接口函数
+ * \details	错误分为非接触瞬时错误、接触瞬时错误、通信错误和不可恢复错误，
+ *			失败后执行对应的恢复操作: 非接触卡片重新唤醒和选择，接触卡片重新复位，通信错误重新连接。
+ *			策略允许重放时按策略有限次退避后重试，否则恢复后返回原错误，由调用者决定是否重新执行。
+ *			一个策略对象可由多个线程同时用于不同的卡片对象，计数为原子操作。
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+struct card_retry {
+	card_retry_policy_t policy;
+	volatile long calls;
+	volatile long retries[CARD_ERR_CLASS_FATAL + 1];
+	volatile long reactivations;
+	volatile long resets;
+	volatile long reconnects;
+	volatile long recovered;
+	volatile long failed;
+};
+
+typedef struct pipe_arg {
+	Uint8_t *tbuf;
+	Uint16_t tlen;
+	Uint8_t *rbuf;
+	Uint16_t *rlen;
+} pipe_arg_t;
+
+Uint8_t card_err_class(card_err_t err)
+{
+	if (err == CARD_NO_ERR)
+		return CARD_ERR_CLASS_NONE;
+	if ((err & 0xF000) == 0x4000)
+		return CARD_ERR_CLASS_LINK;
+	switch (err) {
+	case 0x2001:	/* 无应答 */
+	case 0x2002:	/* CRC或奇偶校验错误 */
+	case 0x2003:	/* 碰撞 */
+	case 0x2005:	/* 无效的帧格式 */
+	case 0x2006:	/* 应答违反协议 */
+	case 0x2010:	/* RF错误 */
+	case 0x2011:	/* RC通信错误 */
+	case 0x2014:	/* 发送端NAK */
+	case 0x2015:	/* 接收端NAK */
+	case 0x2017:	/* EMD噪声 */
+		return CARD_ERR_CLASS_RF;
+	case 0x1008:	/* 接收超时 */
+	case 0x1009:	/* 奇偶校验失败 */
+	case 0x1010:	/* LRC失败 */
+	case 0x1011:	/* CRC失败 */
+	case 0x1012:	/* 序号错误 */
+	case 0x1017:	/* 块等待超时 */
+	case 0x1018:	/* 字符等待超时 */
+	case 0x1020:	/* 超过最大重试次数 */
+		return CARD_ERR_CLASS_CARD;
+	default:
+		return CARD_ERR_CLASS_FATAL;
+	}
+}
+
+void card_retry_policy_default(card_retry_policy_t *policy)
+{
+	if (policy == NULL)
+		return;
+	memset(policy, 0, sizeof(*policy));
+	policy->rf_retries = 2;
+	policy->card_retries = 1;
+	policy->link_retries = 2;
+	policy->backoff_ms = 10;
+	policy->backoff_max_ms = 1000;
+	policy->flags = CARD_RETRY_FLAG_REACTIVATE | CARD_RETRY_FLAG_RECONNECT;
+}
+
+card_err_t card_retry_create(card_retry_t **r, const card_retry_policy_t *policy)
+{
+	card_retry_t *c;
+
+	if (r == NULL)
+		return 0x3007;
+	c = (card_retry_t *)calloc(1, sizeof(card_retry_t));
+	if (c == NULL)
+		return 0x4012;
+	if (policy != NULL)
+		c->policy = *policy;
+	else
+		card_retry_policy_default(&c->policy);
+	*r = c;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_retry_destroy(card_retry_t *r)
+{
+	if (r == NULL)
+		return 0x3007;
+	free(r);
+	return CARD_NO_ERR;
+}
+
+/* ISO14443A重新唤醒、防冲突和选择，A型卡片SAK表示支持ISO14443-4时RATS */
+static card_err_t reactivate_a(card_obj_t *obj)
+{
+	Uint8_t uid[CARD_TAG_UID_MAX], sak, status, ats[256];
+	Uint16_t atqa, uid_len = 0, ats_len = 0;
+	card_err_t ret;
+
+	ret = card_wupa(obj, &atqa);
+	if (ret == CARD_NO_ERR)
+		ret = card_anticol(obj, uid, &uid_len, &sak, &status);
+	if (ret == CARD_NO_ERR)
+		ret = card_select(obj, uid, uid_len, &sak);
+	if (ret == CARD_NO_ERR && obj->model == MODEL_P14443A && (sak & 0x20))
+		ret = card_rats(obj, ats, &ats_len);
+	return ret;
+}
+
+static card_err_t reactivate_b(card_obj_t *obj)
+{
+	Uint8_t atqb[256], atqb_len = 0, rbuf[256];
+	Uint16_t rlen = 0;
+	card_err_t ret;
+
+	ret = card_wupb(obj, atqb, &atqb_len);
+	if (ret == CARD_NO_ERR)
+		ret = card_attrib(obj, rbuf, &rlen);
+	return ret;
+}
+
+/* 卡片级恢复，不需要恢复的协议返回CARD_NO_ERR */
+static card_err_t recover_card(card_retry_t *r, card_obj_t *obj)
+{
+	Uint8_t flags = r->policy.flags;
+
+	switch (obj->model) {
+	case MODEL_P14443A:
+	case MODEL_PMIFARE:
+		if (!(flags & CARD_RETRY_FLAG_REACTIVATE))
+			return CARD_NO_ERR;
+		pt_atomic_add(&r->reactivations, 1);
+		return reactivate_a(obj);
+	case MODEL_P14443B:
+		if (!(flags & CARD_RETRY_FLAG_REACTIVATE))
+			return CARD_NO_ERR;
+		pt_atomic_add(&r->reactivations, 1);
+		return reactivate_b(obj);
+	case MODEL_P7816:
+		if (!(flags & CARD_RETRY_FLAG_RESET))
+			return CARD_NO_ERR;
+		pt_atomic_add(&r->resets, 1);
+		return card_reset(obj);
+	default:
+		return CARD_NO_ERR;
+	}
+}
+
+/* 关闭并重新打开同一地址的连接，保留超时设置 */
+static card_err_t reconnect(card_retry_t *r, card_obj_t *obj)
+{
+	Uint8_t addr[MAX_ADDR_SIZE];
+	card_mod_t model = obj->model;
+	Uint32_t timeout = obj->timeout;
+	card_err_t ret;
+
+	memcpy(addr, obj->addr, MAX_ADDR_SIZE);
+	card_close(obj);
+	ret = card_open_mt(obj, model, addr);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	obj->timeout = timeout;
+	pt_atomic_add(&r->reconnects, 1);
+	return recover_card(r, obj);
+}
+
+card_err_t card_retry_call(card_retry_t *r, card_obj_t *obj, card_async_fn_t fn, void *arg)
+{
+	Uint8_t used[CARD_ERR_CLASS_FATAL + 1], limit, cls = CARD_ERR_CLASS_NONE;
+	Uint32_t delay, shift = 0;
+	card_err_t ret = CARD_NO_ERR, rec;
+	int skip = 0;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (r == NULL || fn == NULL) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	memset(used, 0, sizeof(used));
+	pt_atomic_add(&r->calls, 1);
+
+	for (;;) {
+		if (!skip) {
+			ret = fn(obj, arg);
+			cls = card_err_class(ret);
+		}
+		skip = 0;
+		if (cls == CARD_ERR_CLASS_NONE) {
+			if (shift > 0)
+				pt_atomic_add(&r->recovered, 1);
+			return ret;
+		}
+		switch (cls) {
+		case CARD_ERR_CLASS_RF:
+			limit = r->policy.rf_retries;
+			break;
+		case CARD_ERR_CLASS_CARD:
+			limit = r->policy.card_retries;
+			break;
+		case CARD_ERR_CLASS_LINK:
+			limit = (r->policy.flags & CARD_RETRY_FLAG_RECONNECT) ? r->policy.link_retries : 0;
+			break;
+		default:
+			limit = 0;
+			break;
+		}
+		if (used[cls] >= limit) {
+			pt_atomic_add(&r->failed, 1);
+			return ret;
+		}
+		/* 命令可能已经执行，不允许重放时只恢复一次，不退避也不计重试，返回原错误 */
+		if (!(r->policy.flags & CARD_RETRY_FLAG_REPLAY)) {
+			rec = cls == CARD_ERR_CLASS_LINK ? reconnect(r, obj) : recover_card(r, obj);
+			pt_atomic_add(&r->failed, 1);
+			obj->last_err = card_err_class(rec) == CARD_ERR_CLASS_FATAL ? rec : ret;
+			return obj->last_err;
+		}
+		used[cls]++;
+		pt_atomic_add(&r->retries[cls], 1);
+
+		/* 指数退避 */
+		delay = r->policy.backoff_ms;
+		if (delay != 0) {
+			delay = shift < 16 ? delay << shift : r->policy.backoff_max_ms;
+			if (r->policy.backoff_max_ms != 0 && delay > r->policy.backoff_max_ms)
+				delay = r->policy.backoff_max_ms;
+			pt_sleep_ms(delay);
+		}
+		shift++;
+
+		/* 重连失败时再次重连，卡片恢复失败时直接重试，恢复操作出现不可恢复错误时停止 */
+		rec = cls == CARD_ERR_CLASS_LINK ? reconnect(r, obj) : recover_card(r, obj);
+		if (rec != CARD_NO_ERR && cls == CARD_ERR_CLASS_LINK) {
+			skip = 1;
+			continue;
+		}
+		if (rec != CARD_NO_ERR && card_err_class(rec) == CARD_ERR_CLASS_FATAL) {
+			pt_atomic_add(&r->failed, 1);
+			obj->last_err = rec;
+			return rec;
+		}
+	}
+}
+
+static card_err_t pipe_fn(card_obj_t *obj, void *p)
+{
+	pipe_arg_t *a = (pipe_arg_t *)p;
+
+	return card_pipe(obj, a->tbuf, a->tlen, a->rbuf, a->rlen);
+}
+
+card_err_t card_retry_pipe(card_retry_t *r, card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen)
+{
+	pipe_arg_t a;
+
+	a.tbuf = tbuf;
+	a.tlen = tlen;
+	a.rbuf = rbuf;
+	a.rlen = rlen;
+	return card_retry_call(r, obj, pipe_fn, &a);
+}
+
+card_err_t card_retry_stat(card_retry_t *r, card_retry_stat_t *stat)
+{
+	if (r == NULL || stat == NULL)
+		return 0x3007;
+	stat->calls = (Uint32_t)pt_atomic_load(&r->calls);
+	stat->rf_retries = (Uint32_t)pt_atomic_load(&r->retries[CARD_ERR_CLASS_RF]);
+	stat->card_retries = (Uint32_t)pt_atomic_load(&r->retries[CARD_ERR_CLASS_CARD]);
+	stat->link_retries = (Uint32_t)pt_atomic_load(&r->retries[CARD_ERR_CLASS_LINK]);
+	stat->reactivations = (Uint32_t)pt_atomic_load(&r->reactivations);
+	stat->resets = (Uint32_t)pt_atomic_load(&r->resets);
+	stat->reconnects = (Uint32_t)pt_atomic_load(&r->reconnects);
+	stat->recovered = (Uint32_t)pt_atomic_load(&r->recovered);
+	stat->failed = (Uint32_t)pt_atomic_load(&r->failed);
+	return CARD_NO_ERR;
+}
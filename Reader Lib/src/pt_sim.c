@@ -0,0 +1,1354 @@
+/**
+ * \file	pt_sim.c
+ * \brief	读写器模拟器接口函数
+ * \details	在本机TCP端口模拟读写器通信协议，命令帧与驱动库相同，数值均为小端:
+ *			请求: 模块(1) 长度(4) 'C'(1) 命令类(1) 命令(1) 数据 CRC16(2)，长度为数据长度加3
+ *			应答: 模块(1) 帧长度(4) 'P'/'N'(1) 命令类(1) 命令(1) 错误码(2) 数据 CRC16(2)
+ *			CRC16为CCITT多项式(0x1021)，初值0，校验除CRC外的整帧。
+ *			一个内部线程按顺序处理全部连接的命令，与读写器一次执行一条命令相同。
+ *			注入的延时按连接计时，应答到期后在select循环中发送，不阻塞其他连接的命令。
+ */
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+#ifdef WIN32
+typedef SOCKET sim_sock_t;
+#define SIM_BAD_SOCK	INVALID_SOCKET
+#define sim_close		closesocket
+#else
+typedef int sim_sock_t;
+#define SIM_BAD_SOCK	(-1)
+#define sim_close		close
+#endif
+#ifdef MSG_NOSIGNAL
+#define SIM_SEND_FLAGS	MSG_NOSIGNAL
+#else
+#define SIM_SEND_FLAGS	0
+#endif
+
+/* 命令模块 */
+#define SIM_MOD_SYS		0xF0	/* 读写器和接触卡上下电 */
+#define SIM_MOD_RF		0xF1	/* 非接触 */
+#define SIM_MOD_ICC		0xF2	/* 接触卡数据交换 */
+#define SIM_MOD_I2C		0xF6
+#define SIM_MOD_SPI		0xF7
+
+#define SIM_HEAD_LEN	8			/* 请求帧头长度 */
+#define SIM_RESP_HEAD	10			/* 应答帧头长度 */
+#define SIM_FRAME_MAX	0x1000000UL	/* 请求帧最大长度 */
+#define SIM_RESP_MAX	0xFFFF		/* 应答数据最大长度 */
+#define SIM_POLL_MS		50			/* 检查退出标志间隔 */
+#define SIM_RECV_MS		1000		/* 接收一帧剩余数据的超时 */
+
+/* 存储器参数 */
+#define SIM_MIFARE_SIZE	1024
+#define SIM_I2C_SIZE	8192
+#define SIM_I2C_PAGE	32
+#define SIM_I2C_TWR_US	5000
+#define SIM_SPI_SIZE	0x100000UL
+#define SIM_SPI_PAGE	256
+#define SIM_SPI_TPP_US	700
+#define SIM_SPI_TSE_US	30000
+#define SIM_SPI_TBE_US	150000
+#define SIM_SPI_TCE_US	500000
+#define SIM_15693_BLOCK	4
+#define SIM_15693_BLOCKS	64
+
+/* SPI Flash状态寄存器 */
+#define SIM_SR_WIP		0x01
+#define SIM_SR_WEL		0x02
+
+/* 非接触卡片状态 */
+enum {
+	RF_IDLE = 0,
+	RF_READY,		/* 已应答REQA/WUPA */
+	RF_ACTIVE,		/* 已选择 */
+	RF_PROTOCOL,	/* 已应答RATS */
+	RF_HALT,		/* ISO15693为静默状态 */
+};
+
+/* ISO15693 */
+#define V_FLAG_ERROR	0x01
+#define V_FLAG_INVENTORY	0x04
+#define V_FLAG_AFI		0x10	/* INVENTORY时 */
+#define V_FLAG_ADDRESS	0x20	/* 非INVENTORY时 */
+#define V_ERR_NOT_SUPPORTED	0x01
+#define V_ERR_FORMAT	0x02
+#define V_ERR_BLOCK		0x10
+
+#define SIM_NONE		0xFF
+
+static const Uint8_t atr_t0[] = { 0x3B, 0x13, 0x96, 0x53, 0x49, 0x4D };
+static const Uint8_t atr_t1[] = { 0x3B, 0x93, 0x96, 0x01, 0x53, 0x49, 0x4D, 0x53 };
+static const Uint8_t ats_14443_4[] = { 0x05, 0x78, 0x80, 0x70, 0x02 };
+static const char sim_info[] = "PT-SIM V1.0";
+
+/* 连接，应答在send_at到期后发送 */
+typedef struct sim_conn {
+	sim_sock_t sock;
+	Uint8_t *tx;
+	Uint32_t tx_len;			/* 待发送的应答长度，0为无 */
+	Uint8_t close_after;		/* 应答发送后断开 */
+	unsigned long long send_at;
+} sim_conn_t;
+
+struct card_sim {
+	card_sim_cfg_t cfg;
+	card_sim_card_t card;
+	Uint8_t model;
+	Uint8_t powered;
+	Uint8_t auto_resp;			/* card_cfg设置的61XX自动应答 */
+	Uint8_t auto_rele;			/* card_cfg设置的6CXX自动重发 */
+	Uint8_t rf_state;
+	Uint8_t auth_sector;
+	Uint8_t write_block;		/* MIFARE写命令第二步的块号 */
+	Uint8_t uid[8];				/* ISO15693为8字节，低字节在前 */
+	Uint8_t *pending;			/* T=0 GET RESPONSE剩余数据 */
+	Uint32_t pending_len;
+	Uint8_t *mem;
+	Uint32_t mem_size;
+	Uint32_t ptr;				/* I2C EEPROM地址指针 */
+	Uint8_t status;				/* SPI Flash状态寄存器 */
+	unsigned long long busy_until;
+	Uint32_t rand;
+	volatile long count;
+	volatile long stop;
+	sim_sock_t listen;
+	sim_conn_t conns[CARD_SIM_MAX_CONNS];
+	Uint8_t *rx;
+	Uint32_t rx_size;
+	pt_mutex_t lock;
+	pt_thread_t thread;
+};
+
+static Uint16_t crc_table[256];
+
+static void crc16_init(void)
+{
+	Uint16_t crc;
+	int i, j;
+
+	if (crc_table[1] != 0)
+		return;
+	for (i = 0; i < 256; i++) {
+		crc = (Uint16_t)(i << 8);
+		for (j = 0; j < 8; j++)
+			crc = (Uint16_t)((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+		crc_table[i] = crc;
+	}
+}
+
+static Uint16_t crc16(const Uint8_t *p, Uint32_t len)
+{
+	Uint16_t crc = 0;
+	Uint32_t i;
+
+	for (i = 0; i < len; i++)
+		crc = (Uint16_t)((crc << 8) ^ crc_table[((crc >> 8) ^ p[i]) & 0xFF]);
+	return crc;
+}
+
+static Uint32_t get_le(const Uint8_t *p, int n)
+{
+	Uint32_t v = 0;
+
+	while (n-- > 0)
+		v = (v << 8) | p[n];
+	return v;
+}
+
+static void put_le(Uint8_t *p, Uint32_t v, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		p[i] = (Uint8_t)(v >> (8 * i));
+}
+
+static Uint32_t sim_rand(card_sim_t *sim)
+{
+	Uint32_t x = sim->rand;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	sim->rand = x;
+	return x;
+}
+
+static int sim_hit(card_sim_t *sim, Uint32_t ppm)
+{
+	return ppm > 0 && sim_rand(sim) % 1000000UL < ppm;
+}
+
+static int is_busy(card_sim_t *sim)
+{
+	return pt_os_time_us() < sim->busy_until;
+}
+
+static Uint32_t put_sw(Uint8_t *r, Uint32_t len, Uint16_t sw)
+{
+	r[len] = (Uint8_t)(sw >> 8);
+	r[len + 1] = (Uint8_t)sw;
+	return len + 2;
+}
+
+/*---------------------------------------------------------
+			卡片内容
+ ---------------------------------------------------------*/
+static void mifare_format(card_sim_t *sim)
+{
+	Uint8_t *b;
+	int i;
+
+	memset(sim->mem, 0, SIM_MIFARE_SIZE);
+	b = sim->mem;
+	memcpy(b, sim->uid, 4);
+	b[4] = (Uint8_t)(sim->uid[0] ^ sim->uid[1] ^ sim->uid[2] ^ sim->uid[3]);
+	b[5] = 0x08;
+	b[6] = 0x04;
+	b[7] = 0x00;
+	/* 扇区尾块: 密钥A 存取控制位 密钥B */
+	for (i = 3; i < SIM_MIFARE_SIZE / 16; i += 4) {
+		b = sim->mem + i * 16;
+		memset(b, 0xFF, 6);
+		b[6] = 0xFF;
+		b[7] = 0x07;
+		b[8] = 0x80;
+		b[9] = 0x69;
+		memset(b + 10, 0xFF, 6);
+	}
+}
+
+static card_err_t sim_load(card_sim_t *sim, card_sim_card_t card)
+{
+	Uint32_t size = 0;
+	Uint32_t id;
+
+	switch (card) {
+	case CARD_SIM_MIFARE:
+		size = SIM_MIFARE_SIZE;
+		break;
+	case CARD_SIM_I2C_EEPROM:
+		size = SIM_I2C_SIZE;
+		break;
+	case CARD_SIM_SPI_FLASH:
+		size = SIM_SPI_SIZE;
+		break;
+	case CARD_SIM_15693:
+		size = SIM_15693_BLOCK * SIM_15693_BLOCKS;
+		break;
+	default:
+		break;
+	}
+
+	free(sim->mem);
+	sim->mem = NULL;
+	sim->mem_size = 0;
+	if (size > 0) {
+		sim->mem = (Uint8_t *)malloc(size);
+		if (sim->mem == NULL) {
+			sim->card = CARD_SIM_NONE;
+			return 0x4012;
+		}
+		memset(sim->mem, 0xFF, size);
+		sim->mem_size = size;
+	}
+
+	id = sim_rand(sim);
+	sim->uid[0] = 0x08;		/* 随机UID */
+	sim->uid[1] = (Uint8_t)(id >> 16);
+	sim->uid[2] = (Uint8_t)(id >> 8);
+	sim->uid[3] = (Uint8_t)id;
+	if (card == CARD_SIM_15693) {
+		id = sim_rand(sim);
+		sim->uid[4] = (Uint8_t)(id >> 8);
+		sim->uid[5] = (Uint8_t)id;
+		sim->uid[6] = 0x04;		/* 制造商代码 */
+		sim->uid[7] = 0xE0;
+	}
+	if (card == CARD_SIM_MIFARE)
+		mifare_format(sim);
+
+	sim->card = card;
+	sim->powered = 0;
+	sim->rf_state = RF_IDLE;
+	sim->auth_sector = SIM_NONE;
+	sim->write_block = SIM_NONE;
+	sim->pending_len = 0;
+	sim->ptr = 0;
+	sim->status = 0;
+	sim->busy_until = 0;
+	return CARD_NO_ERR;
+}
+
+/*---------------------------------------------------------
+			APDU卡片
+ ---------------------------------------------------------*/
+/* 执行一条APDU，应答含SW。t0为T=0卡片，ext为支持扩展长度 */
+static void apdu_exec(card_sim_t *sim, int t0, int ext, const Uint8_t *c, Uint32_t n, Uint8_t *r, Uint32_t *rlen)
+{
+	const Uint8_t *data = NULL;
+	Uint32_t lc = 0, le = 0, len = 0, i;
+	int has_le = 0;
+
+	*rlen = 0;
+	if (n < 4) {
+		*rlen = put_sw(r, 0, 0x6700);
+		return;
+	}
+	if (n == 5) {
+		has_le = 1;
+		le = c[4] ? c[4] : 256;
+	} else if (n > 5 && c[4] != 0) {
+		lc = c[4];
+		data = c + 5;
+		if (n == 6 + lc) {
+			has_le = 1;
+			le = c[5 + lc] ? c[5 + lc] : 256;
+		} else if (n != 5 + lc) {
+			*rlen = put_sw(r, 0, 0x6700);
+			return;
+		}
+	} else if (n > 5) {
+		/* 扩展长度 */
+		if (!ext) {
+			*rlen = put_sw(r, 0, 0x6700);
+			return;
+		}
+		if (n == 7) {
+			has_le = 1;
+			le = ((Uint32_t)c[5] << 8) | c[6];
+		} else {
+			lc = ((Uint32_t)c[5] << 8) | c[6];
+			data = c + 7;
+			if (lc > 0 && n == 9 + lc) {
+				has_le = 1;
+				le = ((Uint32_t)c[7 + lc] << 8) | c[8 + lc];
+			} else if (lc == 0 || n != 7 + lc) {
+				*rlen = put_sw(r, 0, 0x6700);
+				return;
+			}
+		}
+		if (has_le && le == 0)
+			le = 65536;
+	}
+	if (le > SIM_RESP_MAX - 2)
+		le = SIM_RESP_MAX - 2;
+
+	switch (c[1]) {
+	case 0xC0:		/* GET RESPONSE */
+		if (!t0) {
+			*rlen = put_sw(r, 0, 0x6D00);
+			return;
+		}
+		if (sim->pending_len == 0) {
+			*rlen = put_sw(r, 0, 0x6985);
+			return;
+		}
+		if (le > sim->pending_len) {
+			*rlen = put_sw(r, 0, (Uint16_t)(0x6C00 | (sim->pending_len & 0xFF)));
+			return;
+		}
+		memcpy(r, sim->pending, le);
+		sim->pending_len -= le;
+		memmove(sim->pending, sim->pending + le, sim->pending_len);
+		if (sim->pending_len > 0)
+			*rlen = put_sw(r, le, (Uint16_t)(0x6100 | (sim->pending_len > 0xFF ? 0 : sim->pending_len)));
+		else
+			*rlen = put_sw(r, le, 0x9000);
+		return;
+	case 0xA4:		/* SELECT */
+		*rlen = put_sw(r, 0, 0x9000);
+		return;
+	case 0x84:		/* GET CHALLENGE */
+		if (!has_le || le != 8) {
+			*rlen = put_sw(r, 0, t0 ? 0x6C08 : 0x6700);
+			return;
+		}
+		for (i = 0; i < 8; i++)
+			r[i] = (Uint8_t)sim_rand(sim);
+		*rlen = put_sw(r, 8, 0x9000);
+		return;
+	default:
+		break;
+	}
+
+	/* 回显 */
+	if (lc > 0 && has_le) {
+		len = lc < le ? lc : le;
+		memcpy(r, data, len);
+	} else if (has_le) {
+		len = le;
+		for (i = 0; i < len; i++)
+			r[i] = (Uint8_t)i;
+	}
+	if (t0 && len > 0 && lc > 0) {
+		/* T=0卡片数据经GET RESPONSE取回 */
+		memcpy(sim->pending, r, len);
+		sim->pending_len = len;
+		*rlen = put_sw(r, 0, (Uint16_t)(0x6100 | (len > 0xFF ? 0 : len)));
+		return;
+	}
+	*rlen = put_sw(r, len, 0x9000);
+}
+
+/* 接触卡APDU，按card_cfg设置自动处理61XX和6CXX */
+static card_err_t icc_pipe(card_sim_t *sim, const Uint8_t *c, Uint32_t n, Uint8_t *r, Uint32_t *rlen)
+{
+	Uint8_t cmd[5];
+	Uint32_t len;
+	int t0 = sim->card == CARD_SIM_7816_T0;
+
+	if (n == 0)
+		return 0x3007;
+	if (sim->card != CARD_SIM_7816_T0 && sim->card != CARD_SIM_7816_T1)
+		return 0x1008;
+	if (!sim->powered)
+		return 0x1008;
+
+	apdu_exec(sim, t0, !t0, c, n, r, rlen);
+	if (!t0 || *rlen != 2)
+		return CARD_NO_ERR;
+
+	if (sim->auto_rele && r[0] == 0x6C && n >= 5) {
+		memcpy(cmd, c, 4);
+		cmd[4] = r[1];
+		apdu_exec(sim, t0, 0, cmd, 5, r, rlen);
+	}
+	if (sim->auto_resp && *rlen == 2 && r[0] == 0x61) {
+		len = sim->pending_len;
+		memcpy(r, sim->pending, len);
+		sim->pending_len = 0;
+		*rlen = put_sw(r, len, 0x9000);
+	}
+	return CARD_NO_ERR;
+}
+
+/*---------------------------------------------------------
+			MIFARE Classic
+ ---------------------------------------------------------*/
+static card_err_t mifare_auth(card_sim_t *sim, const Uint8_t *d, Uint32_t n)
+{
+	const Uint8_t *trailer;
+	Uint8_t blk, type;
+
+	if (n < 12)
+		return 0x2021;
+	if (sim->card != CARD_SIM_MIFARE || sim->rf_state != RF_ACTIVE)
+		return 0x2001;
+	blk = d[0];
+	type = d[1];
+	if (blk >= SIM_MIFARE_SIZE / 16)
+		return 0x2021;
+	if (memcmp(d + 8, sim->uid, 4) != 0)
+		return 0x2007;
+
+	trailer = sim->mem + ((blk / 4) * 4 + 3) * 16;
+	if (memcmp(type == CARD_MIFARE_KEYB ? trailer + 10 : trailer, d + 2, 6) != 0) {
+		/* 验证失败后卡片停止应答 */
+		sim->rf_state = RF_IDLE;
+		sim->auth_sector = SIM_NONE;
+		return 0x2007;
+	}
+	sim->auth_sector = (Uint8_t)(blk / 4);
+	return CARD_NO_ERR;
+}
+
+static card_err_t mifare_pipe(card_sim_t *sim, const Uint8_t *c, Uint32_t n, Uint8_t *r, Uint32_t *rlen)
+{
+	Uint8_t blk;
+
+	if (sim->card != CARD_SIM_MIFARE || sim->rf_state != RF_ACTIVE)
+		return 0x2001;
+
+	if (sim->write_block != SIM_NONE) {
+		/* 写命令第二步，16字节数据 */
+		blk = sim->write_block;
+		sim->write_block = SIM_NONE;
+		if (n != 16)
+			return 0x2012;
+		memcpy(sim->mem + blk * 16, c, 16);
+		r[0] = 0x0A;
+		*rlen = 1;
+		return CARD_NO_ERR;
+	}
+	if (n != 2 || (c[0] != 0x30 && c[0] != 0xA0))
+		return 0x2024;
+	blk = c[1];
+	if (blk >= SIM_MIFARE_SIZE / 16)
+		return 0x2021;
+	if (sim->auth_sector != blk / 4)
+		return 0x2007;
+
+	if (c[0] == 0x30) {
+		memcpy(r, sim->mem + blk * 16, 16);
+		if (blk % 4 == 3)
+			memset(r, 0, 6);	/* 密钥A不可读 */
+		*rlen = 16;
+		return CARD_NO_ERR;
+	}
+	if (blk == 0) {
+		r[0] = 0x04;	/* 厂商块不可写 */
+		*rlen = 1;
+		return CARD_NO_ERR;
+	}
+	sim->write_block = blk;
+	r[0] = 0x0A;
+	*rlen = 1;
+	return CARD_NO_ERR;
+}
+
+/*---------------------------------------------------------
+			ISO15693标签
+ ---------------------------------------------------------*/
+static Uint32_t v_err(Uint8_t *r, Uint8_t code)
+{
+	r[0] = V_FLAG_ERROR;
+	r[1] = code;
+	return 2;
+}
+
+/* INVENTORY: 标志 01 [AFI] 掩码长度 掩码，掩码与UID低位比较 */
+static card_err_t v_inventory(card_sim_t *sim, const Uint8_t *c, Uint32_t n, Uint8_t *r, Uint32_t *rlen)
+{
+	Uint32_t pos = 2, bits, i;
+
+	if (sim->rf_state == RF_HALT)
+		return 0x2001;
+	/* 标签AFI为0，只应答不带AFI的请求 */
+	if (c[0] & V_FLAG_AFI)
+		return 0x2001;
+	if (n < pos + 1)
+		return 0x2001;
+	bits = c[pos++];
+	if (bits > 64 || n < pos + (bits + 7) / 8)
+		return 0x2001;
+	for (i = 0; i < bits; i++) {
+		if (((c[pos + i / 8] ^ sim->uid[i / 8]) >> (i % 8)) & 1)
+			return 0x2001;
+	}
+	r[0] = 0x00;
+	r[1] = 0x00;	/* DSFID */
+	memcpy(r + 2, sim->uid, 8);
+	*rlen = 10;
+	return CARD_NO_ERR;
+}
+
+/* 标签命令帧不含CRC: 标志 命令 [UID] 参数，应答: 标志 数据 */
+static card_err_t v_exec(card_sim_t *sim, const Uint8_t *c, Uint32_t n, Uint8_t *r, Uint32_t *rlen)
+{
+	Uint32_t pos = 2, first, count, size = SIM_15693_BLOCK;
+
+	if (sim->card != CARD_SIM_15693 || n < 2)
+		return 0x2001;
+	if (c[0] & V_FLAG_INVENTORY)
+		return c[1] == 0x01 ? v_inventory(sim, c, n, r, rlen) : 0x2001;
+	if (c[0] & V_FLAG_ADDRESS) {
+		if (n < pos + 8 || memcmp(c + pos, sim->uid, 8) != 0)
+			return 0x2001;
+		pos += 8;
+	} else if (sim->rf_state == RF_HALT) {
+		/* 静默状态只处理寻址命令 */
+		return 0x2001;
+	}
+
+	switch (c[1]) {
+	case 0x02:		/* STAY QUIET，不应答 */
+		if (!(c[0] & V_FLAG_ADDRESS))
+			return 0x2001;
+		sim->rf_state = RF_HALT;
+		return 0x2001;
+	case 0x26:		/* RESET TO READY */
+		sim->rf_state = RF_READY;
+		r[0] = 0x00;
+		*rlen = 1;
+		return CARD_NO_ERR;
+	case 0x20:		/* READ SINGLE BLOCK */
+	case 0x23:		/* READ MULTIPLE BLOCKS */
+	case 0x21:		/* WRITE SINGLE BLOCK */
+	case 0x24:		/* WRITE MULTIPLE BLOCKS */
+		if (n < pos + 1 || (c[1] >= 0x23 && n < pos + 2)) {
+			*rlen = v_err(r, V_ERR_FORMAT);
+			return CARD_NO_ERR;
+		}
+		first = c[pos++];
+		count = c[1] >= 0x23 ? (Uint32_t)c[pos++] + 1 : 1;
+		if (first + count > SIM_15693_BLOCKS) {
+			*rlen = v_err(r, V_ERR_BLOCK);
+			return CARD_NO_ERR;
+		}
+		if (c[1] == 0x20 || c[1] == 0x23) {
+			r[0] = 0x00;
+			memcpy(r + 1, sim->mem + first * size, count * size);
+			*rlen = 1 + count * size;
+			return CARD_NO_ERR;
+		}
+		if (n != pos + count * size) {
+			*rlen = v_err(r, V_ERR_FORMAT);
+			return CARD_NO_ERR;
+		}
+		memcpy(sim->mem + first * size, c + pos, count * size);
+		r[0] = 0x00;
+		*rlen = 1;
+		return CARD_NO_ERR;
+	default:
+		*rlen = v_err(r, V_ERR_NOT_SUPPORTED);
+		return CARD_NO_ERR;
+	}
+}
+
+/*---------------------------------------------------------
+			非接触命令
+ ---------------------------------------------------------*/
+static int is_picc(card_sim_t *sim)
+{
+	return sim->card == CARD_SIM_MIFARE || sim->card == CARD_SIM_14443_4;
+}
+
+static card_err_t rf_exec(card_sim_t *sim, Uint8_t cm, Uint8_t pm, const Uint8_t *d, Uint32_t n, Uint8_t *r, Uint32_t *rlen)
+{
+	if (cm == 0xA1 || cm == 0xC1) {
+		if (!is_picc(sim))
+			return 0x2001;
+		switch (pm) {
+		case 0x01:		/* REQA */
+		case 0x02:		/* WUPA */
+			if (pm == 0x01 && sim->rf_state == RF_HALT)
+				return 0x2001;
+			sim->rf_state = RF_READY;
+			sim->auth_sector = SIM_NONE;
+			sim->write_block = SIM_NONE;
+			r[0] = 0x04;
+			r[1] = 0x00;
+			*rlen = 2;
+			return CARD_NO_ERR;
+		case 0x03:		/* 防冲突 */
+			if (sim->rf_state != RF_READY)
+				return 0x2001;
+			memcpy(r, sim->uid, 4);
+			r[4] = sim->card == CARD_SIM_MIFARE ? 0x08 : 0x20;
+			r[5] = 0x00;
+			*rlen = 6;
+			return CARD_NO_ERR;
+		case 0x04:		/* 选择 */
+			if (sim->rf_state != RF_READY || n != 4 || memcmp(d, sim->uid, 4) != 0)
+				return 0x2001;
+			sim->rf_state = RF_ACTIVE;
+			r[0] = sim->card == CARD_SIM_MIFARE ? 0x08 : 0x20;
+			*rlen = 1;
+			return CARD_NO_ERR;
+		case 0x05:		/* HALTA */
+			sim->rf_state = RF_HALT;
+			return CARD_NO_ERR;
+		default:
+			return 0x2024;
+		}
+	}
+	if (cm == 0xA2) {
+		switch (pm) {
+		case 0x01:		/* RATS */
+			if (sim->card != CARD_SIM_14443_4 || sim->rf_state != RF_ACTIVE)
+				return 0x2001;
+			sim->rf_state = RF_PROTOCOL;
+			memcpy(r, ats_14443_4, sizeof(ats_14443_4));
+			*rlen = sizeof(ats_14443_4);
+			return CARD_NO_ERR;
+		case 0x02:		/* 速率设置 */
+			return CARD_NO_ERR;
+		case 0x04:		/* DESELECT */
+			if (sim->rf_state != RF_PROTOCOL)
+				return 0x2001;
+			sim->rf_state = RF_HALT;
+			return CARD_NO_ERR;
+		case 0x05:		/* 卡片检测 */
+			r[0] = is_picc(sim) ? 1 : 0;
+			*rlen = 1;
+			return CARD_NO_ERR;
+		default:
+			return 0x2024;
+		}
+	}
+	if (cm == 0xA4 && pm == 0x01) {
+		if (sim->card != CARD_SIM_14443_4 || sim->rf_state != RF_PROTOCOL)
+			return 0x2001;
+		if (n == 0)
+			return 0x2021;
+		apdu_exec(sim, 0, 1, d, n, r, rlen);
+		return CARD_NO_ERR;
+	}
+	if (cm == 0xC4 && pm == 0x01)
+		return mifare_pipe(sim, d, n, r, rlen);
+	if (cm == 0xC3 && pm == 0x02)
+		return mifare_auth(sim, d, n);
+	if (cm == 0xE1 && pm == 0x01)
+		return v_exec(sim, d, n, r, rlen);
+	/* ISO14443B、FeliCa卡片不存在 */
+	if (cm == 0xB1 || cm == 0xB2 || cm == 0xB3 || cm == 0xB4 || cm == 0xD1 || cm == 0xE1)
+		return 0x2001;
+	return 0x2024;
+}
+
+/*---------------------------------------------------------
+			接触卡命令
+ ---------------------------------------------------------*/
+static card_err_t icc_atr(card_sim_t *sim, Uint8_t *r, Uint32_t *rlen)
+{
+	if (sim->card == CARD_SIM_7816_T0) {
+		memcpy(r, atr_t0, sizeof(atr_t0));
+		*rlen = sizeof(atr_t0);
+	} else if (sim->card == CARD_SIM_7816_T1) {
+		memcpy(r, atr_t1, sizeof(atr_t1));
+		*rlen = sizeof(atr_t1);
+	} else {
+		return 0x1003;
+	}
+	sim->powered = 1;
+	sim->pending_len = 0;
+	return CARD_NO_ERR;
+}
+
+/* PPS1不能超过ATR中TA1的Fi和Di */
+static card_err_t icc_pps(card_sim_t *sim, const Uint8_t *d, Uint32_t n)
+{
+	Uint8_t ta1 = atr_t0[2];
+
+	if (!sim->powered)
+		return 0x1008;
+	if (n < 2)
+		return 0x1037;
+	if ((d[0] & 0x10) && ((d[1] >> 4) > (ta1 >> 4) || (d[1] & 0x0F) > (ta1 & 0x0F)))
+		return 0x1027;
+	return CARD_NO_ERR;
+}
+
+/* 接触卡配置，只处理自动应答开关 */
+static void icc_cfg(card_sim_t *sim, const Uint8_t *d, Uint32_t n)
+{
+	Uint32_t mask;
+
+	if (n != sizeof(card_cfg_t))
+		return;
+	mask = get_le(d, 4);
+	if (mask & CARD_ICC_CONFIG_MASK_AUTO_RESP)
+		sim->auto_resp = d[32];
+	if (mask & CARD_ICC_CONFIG_MASK_AUTO_RELE)
+		sim->auto_rele = d[33];
+}
+
+static card_err_t sys_exec(card_sim_t *sim, Uint8_t cm, Uint8_t pm, const Uint8_t *d, Uint32_t n, Uint8_t *r, Uint32_t *rlen)
+{
+	if (cm == 0xA1) {
+		switch (pm) {
+		case 0x01:		/* 打开 */
+			if (n > 0)
+				sim->model = d[0];
+			return CARD_NO_ERR;
+		case 0x03:		/* 设置卡片模式 */
+			if (n > 0)
+				sim->model = d[0];
+			return CARD_NO_ERR;
+		case 0x04:		/* 获取卡片模式 */
+		case 0x06:		/* 自动选择卡片模式 */
+			r[0] = sim->model;
+			*rlen = 1;
+			return CARD_NO_ERR;
+		case 0x05:		/* 读写器信息 */
+			memcpy(r, sim_info, sizeof(sim_info));
+			*rlen = sizeof(sim_info);
+			return CARD_NO_ERR;
+		default:
+			return CARD_NO_ERR;
+		}
+	}
+	if (cm == 0xA2) {
+		switch (pm) {
+		case 0x01:		/* 复位 */
+		case 0x02:		/* 上电 */
+			/* 非接触模式为开启载波，卡片回到未激活状态 */
+			if (sim->model >= MODEL_P14443A && sim->model <= MODEL_P15693) {
+				sim->rf_state = RF_IDLE;
+				sim->auth_sector = SIM_NONE;
+				return CARD_NO_ERR;
+			}
+			return icc_atr(sim, r, rlen);
+		case 0x03:		/* 下电 */
+			sim->powered = 0;
+			sim->rf_state = RF_IDLE;
+			sim->auth_sector = SIM_NONE;
+			sim->pending_len = 0;
+			return CARD_NO_ERR;
+		default:
+			return 0x3005;
+		}
+	}
+	if (cm == 0xA3) {
+		if (pm == 0x02)
+			icc_cfg(sim, d, n);
+		return CARD_NO_ERR;
+	}
+	return 0x3005;
+}
+
+static card_err_t icc_exec(card_sim_t *sim, Uint8_t cm, Uint8_t pm, const Uint8_t *d, Uint32_t n, Uint8_t *r, Uint32_t *rlen)
+{
+	if (cm != 0xA1)
+		return 0x3005;
+	switch (pm) {
+	case 0x01:		/* PPS */
+		return icc_pps(sim, d, n);
+	case 0x02:		/* 数据交换 */
+		return icc_pipe(sim, d, n, r, rlen);
+	case 0x03:		/* 热复位 */
+		if (!sim->powered)
+			return 0x1014;
+		return icc_atr(sim, r, rlen);
+	default:
+		return CARD_NO_ERR;
+	}
+}
+
+/*---------------------------------------------------------
+			I2C EEPROM
+ ---------------------------------------------------------*/
+static card_err_t i2c_exec(card_sim_t *sim, Uint8_t cm, Uint8_t pm, const Uint8_t *d, Uint32_t n, Uint8_t *r, Uint32_t *rlen)
+{
+	Uint16_t address, len, i;
+	Uint32_t base, off;
+
+	if (cm != 0xA1 || pm != 0x05)
+		return CARD_NO_ERR;
+	/* 写后读: 设备地址(2) 读长度(2) 写数据 */
+	if (n < 4)
+		return 0x1037;
+	address = (Uint16_t)get_le(d, 2);
+	len = (Uint16_t)get_le(d + 2, 2);
+	d += 4;
+	n -= 4;
+	if (sim->card != CARD_SIM_I2C_EEPROM || (address != 0x50 && address != 0xA0))
+		return 0x1008;
+	if (is_busy(sim))
+		return 0x1038;
+
+	if (n >= 2) {
+		sim->ptr = (((Uint32_t)d[0] << 8) | d[1]) % SIM_I2C_SIZE;
+		if (n > 2) {
+			/* 页内地址回绕 */
+			base = sim->ptr & ~(Uint32_t)(SIM_I2C_PAGE - 1);
+			off = sim->ptr - base;
+			for (i = 2; i < n; i++) {
+				sim->mem[base + off] = d[i];
+				off = (off + 1) % SIM_I2C_PAGE;
+			}
+			sim->ptr = base + off;
+			sim->busy_until = pt_os_time_us() + SIM_I2C_TWR_US;
+			if (len > 0)
+				return 0x1038;
+		}
+	}
+	for (i = 0; i < len; i++) {
+		r[i] = sim->mem[sim->ptr];
+		sim->ptr = (sim->ptr + 1) % SIM_I2C_SIZE;
+	}
+	*rlen = len;
+	return CARD_NO_ERR;
+}
+
+/*---------------------------------------------------------
+			SPI Flash
+ ---------------------------------------------------------*/
+static void spi_erase(card_sim_t *sim, Uint32_t addr, Uint32_t size, Uint32_t time_us)
+{
+	addr &= ~(size - 1);
+	memset(sim->mem + addr, 0xFF, size);
+	sim->busy_until = pt_os_time_us() + time_us;
+}
+
+static card_err_t spi_exec(card_sim_t *sim, Uint8_t cm, Uint8_t pm, const Uint8_t *d, Uint32_t n, Uint8_t *r, Uint32_t *rlen)
+{
+	Uint16_t tlen, len, i;
+	Uint32_t addr = 0, base, off;
+	Uint8_t op;
+
+	if (cm != 0xA1 || pm != 0x05)
+		return CARD_NO_ERR;
+	/* 写后读: 写长度(2) 读长度(2) 写数据 */
+	if (n < 4)
+		return 0x1037;
+	tlen = (Uint16_t)get_le(d, 2);
+	len = (Uint16_t)get_le(d + 2, 2);
+	d += 4;
+	n -= 4;
+	if (tlen > n || tlen == 0)
+		return 0x1037;
+	*rlen = len;
+	memset(r, 0xFF, len);
+	if (sim->card != CARD_SIM_SPI_FLASH)
+		return CARD_NO_ERR;
+
+	if (is_busy(sim)) {
+		sim->status |= SIM_SR_WIP;
+	} else if (sim->status & SIM_SR_WIP) {
+		sim->status &= (Uint8_t)~(SIM_SR_WIP | SIM_SR_WEL);
+	}
+	op = d[0];
+	if (tlen >= 4)
+		addr = (((Uint32_t)d[1] << 16) | ((Uint32_t)d[2] << 8) | d[3]) % SIM_SPI_SIZE;
+	/* 擦写期间只响应读状态 */
+	if ((sim->status & SIM_SR_WIP) && op != 0x05)
+		return CARD_NO_ERR;
+
+	switch (op) {
+	case 0x9F:		/* JEDEC ID */
+		memset(r, 0, len);
+		for (i = 0; i < len && i < 3; i++)
+			r[i] = (Uint8_t)(0xEF4014UL >> (16 - 8 * i));
+		break;
+	case 0x05:		/* 读状态 */
+		memset(r, sim->status, len);
+		break;
+	case 0x06:
+		sim->status |= SIM_SR_WEL;
+		break;
+	case 0x04:
+		sim->status &= (Uint8_t)~SIM_SR_WEL;
+		break;
+	case 0x03:		/* 读 */
+	case 0x0B:		/* 快速读，地址后1字节空周期 */
+		if (tlen < (op == 0x03 ? 4 : 5))
+			break;
+		for (i = 0; i < len; i++)
+			r[i] = sim->mem[(addr + i) % SIM_SPI_SIZE];
+		break;
+	case 0x02:		/* 页编程，页内地址回绕 */
+		if (!(sim->status & SIM_SR_WEL) || tlen < 5)
+			break;
+		base = addr & ~(Uint32_t)(SIM_SPI_PAGE - 1);
+		off = addr - base;
+		for (i = 4; i < tlen; i++) {
+			sim->mem[base + off] &= d[i];
+			off = (off + 1) % SIM_SPI_PAGE;
+		}
+		sim->status |= SIM_SR_WIP;
+		sim->busy_until = pt_os_time_us() + SIM_SPI_TPP_US;
+		break;
+	case 0x20:		/* 扇区擦除 4KB */
+	case 0xD8:		/* 块擦除 64KB */
+		if (!(sim->status & SIM_SR_WEL) || tlen < 4)
+			break;
+		if (op == 0x20)
+			spi_erase(sim, addr, 0x1000, SIM_SPI_TSE_US);
+		else
+			spi_erase(sim, addr, 0x10000, SIM_SPI_TBE_US);
+		sim->status |= SIM_SR_WIP;
+		break;
+	case 0xC7:		/* 整片擦除 */
+	case 0x60:
+		if (!(sim->status & SIM_SR_WEL))
+			break;
+		spi_erase(sim, 0, SIM_SPI_SIZE, SIM_SPI_TCE_US);
+		sim->status |= SIM_SR_WIP;
+		break;
+	default:
+		break;
+	}
+	return CARD_NO_ERR;
+}
+
+/*---------------------------------------------------------
+			通信
+ ---------------------------------------------------------*/
+static int recv_full(sim_sock_t s, Uint8_t *p, Uint32_t len)
+{
+	int ret;
+
+	while (len > 0) {
+		ret = recv(s, (char *)p, len > 0x10000 ? 0x10000 : (int)len, 0);
+		if (ret <= 0)
+			return -1;
+		p += ret;
+		len -= (Uint32_t)ret;
+	}
+	return 0;
+}
+
+static int send_full(sim_sock_t s, const Uint8_t *p, Uint32_t len)
+{
+	int ret;
+
+	while (len > 0) {
+		ret = send(s, (const char *)p, len > 0x10000 ? 0x10000 : (int)len, SIM_SEND_FLAGS);
+		if (ret <= 0)
+			return -1;
+		p += ret;
+		len -= (Uint32_t)ret;
+	}
+	return 0;
+}
+
+/* 注入的默认错误码 */
+static card_err_t inject_err(card_sim_t *sim, Uint8_t mod)
+{
+	if (sim->cfg.err_code != CARD_NO_ERR)
+		return sim->cfg.err_code;
+	if (mod == SIM_MOD_RF)
+		return 0x2001;
+	if (mod == SIM_MOD_I2C || mod == SIM_MOD_SPI)
+		return 0x1008;
+	return 0x1009;
+}
+
+/* 接收并处理一条命令，应答放入连接的发送缓冲区，连接断开或出错返回-1 */
+static int sim_serve(card_sim_t *sim, sim_conn_t *c)
+{
+	sim_sock_t s = c->sock;
+	Uint8_t *req, *tx = c->tx;
+	Uint8_t mod, cm, pm;
+	Uint32_t total, rlen = 0, delay;
+	card_err_t err;
+	int inject, drop = 0, mute = 0, crc_bad = 0;
+	Uint16_t crc;
+
+	if (recv_full(s, sim->rx, 5) != 0)
+		return -1;
+	total = get_le(sim->rx + 1, 4) + 7;
+	if (total < SIM_HEAD_LEN + 2 || total > SIM_FRAME_MAX)
+		return -1;
+	if (total > sim->rx_size) {
+		req = (Uint8_t *)realloc(sim->rx, total);
+		if (req == NULL)
+			return -1;
+		sim->rx = req;
+		sim->rx_size = total;
+	}
+	req = sim->rx;
+	if (recv_full(s, req + 5, total - 5) != 0)
+		return -1;
+
+	mod = req[0];
+	cm = req[6];
+	pm = req[7];
+	pt_mutex_lock(&sim->lock);
+	pt_atomic_add(&sim->count, 1);
+	crc = crc16(req, total - 2);
+	if (req[5] != 0x43) {
+		err = 0x4014;
+	} else if ((Uint16_t)get_le(req + total - 2, 2) != crc) {
+		err = 0x4013;
+	} else {
+		/* 读写器命令不注入错误 */
+		inject = !(mod == SIM_MOD_SYS && cm != 0xA2);
+		if (inject && sim_hit(sim, sim->cfg.drop_ppm)) {
+			drop = 1;
+		} else if (inject && sim_hit(sim, sim->cfg.mute_ppm)) {
+			mute = 1;
+		} else if (inject && sim_hit(sim, sim->cfg.err_ppm)) {
+			err = inject_err(sim, mod);
+			if (mod == SIM_MOD_RF) {
+				sim->rf_state = RF_IDLE;
+				sim->auth_sector = SIM_NONE;
+			}
+		} else {
+			switch (mod) {
+			case SIM_MOD_SYS:
+				err = sys_exec(sim, cm, pm, req + SIM_HEAD_LEN, total - SIM_HEAD_LEN - 2, tx + SIM_RESP_HEAD, &rlen);
+				break;
+			case SIM_MOD_RF:
+				err = rf_exec(sim, cm, pm, req + SIM_HEAD_LEN, total - SIM_HEAD_LEN - 2, tx + SIM_RESP_HEAD, &rlen);
+				break;
+			case SIM_MOD_ICC:
+				err = icc_exec(sim, cm, pm, req + SIM_HEAD_LEN, total - SIM_HEAD_LEN - 2, tx + SIM_RESP_HEAD, &rlen);
+				break;
+			case SIM_MOD_I2C:
+				err = i2c_exec(sim, cm, pm, req + SIM_HEAD_LEN, total - SIM_HEAD_LEN - 2, tx + SIM_RESP_HEAD, &rlen);
+				break;
+			case SIM_MOD_SPI:
+				err = spi_exec(sim, cm, pm, req + SIM_HEAD_LEN, total - SIM_HEAD_LEN - 2, tx + SIM_RESP_HEAD, &rlen);
+				break;
+			default:
+				err = 0x3005;
+				break;
+			}
+		}
+		crc_bad = inject && !drop && !mute && sim_hit(sim, sim->cfg.crc_ppm);
+	}
+	if (drop || mute)
+		err = CARD_NO_ERR;
+	if (err != CARD_NO_ERR)
+		rlen = 0;
+	delay = sim->cfg.latency_us;
+	if (sim->cfg.jitter_us > 0)
+		delay += sim_rand(sim) % (sim->cfg.jitter_us + 1);
+	delay += (Uint32_t)(((unsigned long long)sim->cfg.byte_ns * (total + rlen + SIM_RESP_HEAD + 2)) / 1000ULL);
+	pt_mutex_unlock(&sim->lock);
+
+	if (drop)
+		return -1;
+	if (mute)
+		return 0;
+
+	total = rlen + SIM_RESP_HEAD + 2;
+	tx[0] = mod;
+	put_le(tx + 1, total, 4);
+	tx[5] = err == CARD_NO_ERR ? 'P' : 'N';
+	tx[6] = cm;
+	tx[7] = pm;
+	put_le(tx + 8, err, 2);
+	crc = crc16(tx, total - 2);
+	if (crc_bad)
+		crc ^= 0xFFFF;
+	put_le(tx + total - 2, crc, 2);
+	c->tx_len = total;
+	c->send_at = pt_os_time_us() + delay;
+	/* 关闭命令应答后断开 */
+	c->close_after = mod == SIM_MOD_SYS && cm == 0xA1 && pm == 0x02;
+	return 0;
+}
+
+static void conn_close(sim_conn_t *c)
+{
+	sim_close(c->sock);
+	c->sock = SIM_BAD_SOCK;
+	c->tx_len = 0;
+}
+
+/* 发送到期的应答，连接断开或出错返回-1 */
+static int conn_flush(sim_conn_t *c, unsigned long long now)
+{
+	Uint32_t len = c->tx_len;
+
+	if (len == 0 || now < c->send_at)
+		return 0;
+	c->tx_len = 0;
+	if (send_full(c->sock, c->tx, len) != 0 || c->close_after)
+		return -1;
+	return 0;
+}
+
+static void sim_accept(card_sim_t *sim)
+{
+	sim_sock_t s;
+	int i, on = 1;
+#ifdef WIN32
+	DWORD tmo = SIM_RECV_MS;
+#else
+	struct timeval tmo;
+
+	tmo.tv_sec = SIM_RECV_MS / 1000;
+	tmo.tv_usec = (SIM_RECV_MS % 1000) * 1000;
+#endif
+
+	s = accept(sim->listen, NULL, NULL);
+	if (s == SIM_BAD_SOCK)
+		return;
+	for (i = 0; i < CARD_SIM_MAX_CONNS; i++) {
+		if (sim->conns[i].sock == SIM_BAD_SOCK)
+			break;
+	}
+	/* 发送缓冲区在第一次使用该位置时分配，断开后保留 */
+	if (i < CARD_SIM_MAX_CONNS && sim->conns[i].tx == NULL)
+		sim->conns[i].tx = (Uint8_t *)malloc(SIM_RESP_MAX + SIM_RESP_HEAD + 2);
+	if (i == CARD_SIM_MAX_CONNS || sim->conns[i].tx == NULL) {
+		sim_close(s);
+		return;
+	}
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&on, sizeof(on));
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char *)&tmo, sizeof(tmo));
+	sim->conns[i].sock = s;
+	sim->conns[i].tx_len = 0;
+}
+
+static void sim_worker(void *p)
+{
+	card_sim_t *sim = (card_sim_t *)p;
+	sim_conn_t *c;
+	fd_set rfds;
+	struct timeval tv;
+	unsigned long long now, wake;
+	int i, maxfd, n;
+
+	while (!pt_atomic_load(&sim->stop)) {
+		FD_ZERO(&rfds);
+		FD_SET(sim->listen, &rfds);
+		maxfd = (int)sim->listen;
+		now = pt_os_time_us();
+		wake = now + SIM_POLL_MS * 1000ULL;
+		for (i = 0; i < CARD_SIM_MAX_CONNS; i++) {
+			c = &sim->conns[i];
+			if (c->sock == SIM_BAD_SOCK)
+				continue;
+			/* 应答发送前不接收该连接的下一条命令 */
+			if (c->tx_len != 0) {
+				if (c->send_at < wake)
+					wake = c->send_at;
+				continue;
+			}
+			FD_SET(c->sock, &rfds);
+			if ((int)c->sock > maxfd)
+				maxfd = (int)c->sock;
+		}
+		wake = wake > now ? wake - now : 0;
+		tv.tv_sec = (long)(wake / 1000000ULL);
+		tv.tv_usec = (long)(wake % 1000000ULL);
+		n = select(maxfd + 1, &rfds, NULL, NULL, &tv);
+
+		for (i = 0; n > 0 && i < CARD_SIM_MAX_CONNS; i++) {
+			c = &sim->conns[i];
+			if (c->sock != SIM_BAD_SOCK && c->tx_len == 0 && FD_ISSET(c->sock, &rfds)
+				&& sim_serve(sim, c) != 0)
+				conn_close(c);
+		}
+		now = pt_os_time_us();
+		for (i = 0; i < CARD_SIM_MAX_CONNS; i++) {
+			c = &sim->conns[i];
+			if (c->sock != SIM_BAD_SOCK && conn_flush(c, now) != 0)
+				conn_close(c);
+		}
+		if (n > 0 && FD_ISSET(sim->listen, &rfds))
+			sim_accept(sim);
+	}
+}
+
+card_err_t card_sim_create(card_sim_t **sim, Uint8_t *addr, const card_sim_cfg_t *cfg)
+{
+	card_sim_t *s;
+	struct sockaddr_in sa;
+	int i, on = 1;
+#ifdef WIN32
+	WSADATA wsa;
+#endif
+
+	if (sim == NULL)
+		return 0x3007;
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = inet_addr(addr == NULL ? "127.0.0.1" : (const char *)addr);
+	if (sa.sin_addr.s_addr == INADDR_NONE)
+		return 0x3004;
+	crc16_init();
+
+	s = (card_sim_t *)calloc(1, sizeof(card_sim_t));
+	if (s == NULL)
+		return 0x4012;
+	if (cfg != NULL)
+		s->cfg = *cfg;
+	sa.sin_port = htons(s->cfg.port != 0 ? s->cfg.port : CARD_SIM_PORT);
+	s->rand = s->cfg.seed != 0 ? s->cfg.seed : 0x2545F491UL;
+	s->rx_size = 0x10000;
+	s->rx = (Uint8_t *)malloc(s->rx_size);
+	s->pending = (Uint8_t *)malloc(SIM_RESP_MAX);
+	if (s->rx == NULL || s->pending == NULL) {
+		free(s->rx);
+		free(s->pending);
+		free(s);
+		return 0x4012;
+	}
+	for (i = 0; i < CARD_SIM_MAX_CONNS; i++)
+		s->conns[i].sock = SIM_BAD_SOCK;
+	sim_load(s, CARD_SIM_NONE);
+
+#ifdef WIN32
+	WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+	s->listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s->listen == SIM_BAD_SOCK)
+		goto fail;
+	setsockopt(s->listen, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+	if (bind(s->listen, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(s->listen, CARD_SIM_MAX_CONNS) != 0) {
+		sim_close(s->listen);
+		goto fail;
+	}
+
+	pt_mutex_init(&s->lock);
+	if (pt_thread_create(&s->thread, sim_worker, s) != 0) {
+		pt_mutex_destroy(&s->lock);
+		sim_close(s->listen);
+		goto fail;
+	}
+	*sim = s;
+	return CARD_NO_ERR;
+
+fail:
+#ifdef WIN32
+	WSACleanup();
+#endif
+	free(s->rx);
+	free(s->pending);
+	free(s);
+	return 0x4004;
+}
+
+card_err_t card_sim_destroy(card_sim_t *sim)
+{
+	int i;
+
+	if (sim == NULL)
+		return 0x3007;
+
+	pt_atomic_store(&sim->stop, 1);
+	pt_thread_join(sim->thread);
+	for (i = 0; i < CARD_SIM_MAX_CONNS; i++) {
+		if (sim->conns[i].sock != SIM_BAD_SOCK)
+			sim_close(sim->conns[i].sock);
+		free(sim->conns[i].tx);
+	}
+	sim_close(sim->listen);
+#ifdef WIN32
+	WSACleanup();
+#endif
+	pt_mutex_destroy(&sim->lock);
+	free(sim->mem);
+	free(sim->rx);
+	free(sim->pending);
+	free(sim);
+	return CARD_NO_ERR;
+}
+
+card_err_t card_sim_insert(card_sim_t *sim, card_sim_card_t card)
+{
+	card_err_t ret;
+
+	if (sim == NULL || card > CARD_SIM_15693)
+		return 0x3007;
+
+	pt_mutex_lock(&sim->lock);
+	ret = sim_load(sim, card);
+	pt_mutex_unlock(&sim->lock);
+	return ret;
+}
+
+card_err_t card_sim_config(card_sim_t *sim, const card_sim_cfg_t *cfg)
+{
+	if (sim == NULL || cfg == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&sim->lock);
+	sim->cfg.latency_us = cfg->latency_us;
+	sim->cfg.jitter_us = cfg->jitter_us;
+	sim->cfg.byte_ns = cfg->byte_ns;
+	sim->cfg.err_ppm = cfg->err_ppm;
+	sim->cfg.err_code = cfg->err_code;
+	sim->cfg.crc_ppm = cfg->crc_ppm;
+	sim->cfg.mute_ppm = cfg->mute_ppm;
+	sim->cfg.drop_ppm = cfg->drop_ppm;
+	pt_mutex_unlock(&sim->lock);
+	return CARD_NO_ERR;
+}
+
+Uint32_t card_sim_count(card_sim_t *sim)
+{
+	return sim == NULL ? 0 : (Uint32_t)pt_atomic_load(&sim->count);
+}
@@ -0,0 +1,276 @@
+/**
+ * \file	pt_spi.c
+ * \brief	SPI Flash批量擦除、编程和校验接口函数
+ * \details	读写器只提供单次写后读传输(一次片选)，写使能、页编程和读状态各为一次传输。
+ *			全为0xFF的页在擦除后跳过，读取使用快速读命令按大块传输。
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+/* SPI NOR Flash命令 */
+#define FLASH_WREN			0x06
+#define FLASH_RDSR			0x05
+#define FLASH_RDID			0x9F
+#define FLASH_FAST_READ		0x0B
+#define FLASH_PP			0x02
+#define FLASH_SE			0x20		/* 4KB扇区擦除 */
+#define FLASH_BE			0xD8		/* 64KB块擦除 */
+#define FLASH_SR_WIP		0x01
+
+#define FLASH_BLOCK_SIZE	0x10000UL
+#define ERASE_POLL_MS		1			/* 擦除期间读状态间隔 */
+
+static card_err_t spi_cmd(card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t rlen)
+{
+	Uint16_t n = rlen;
+	Uint8_t dummy[1];
+	card_err_t ret;
+
+	ret = card_spi_write_read(obj, tbuf, tlen, rlen != 0 ? rbuf : dummy, &n);
+	if (ret == CARD_NO_ERR && n != rlen) {
+		obj->last_err = 0x1022;
+		ret = obj->last_err;
+	}
+	return ret;
+}
+
+static void put_addr(Uint8_t *p, Uint32_t addr)
+{
+	p[0] = (Uint8_t)(addr >> 16);
+	p[1] = (Uint8_t)(addr >> 8);
+	p[2] = (Uint8_t)addr;
+}
+
+/* 等待编程或擦除结束 */
+static card_err_t wait_ready(card_obj_t *obj, Uint32_t timeout_ms, Uint32_t interval_ms)
+{
+	unsigned long long deadline = pt_os_time_us() + (unsigned long long)timeout_ms * 1000ULL;
+	Uint8_t cmd = FLASH_RDSR, sr;
+	card_err_t ret;
+
+	for (;;) {
+		ret = spi_cmd(obj, &cmd, 1, &sr, 1);
+		if (ret != CARD_NO_ERR)
+			return ret;
+		if (!(sr & FLASH_SR_WIP))
+			return CARD_NO_ERR;
+		if (pt_os_time_us() >= deadline) {
+			obj->last_err = CARD_ERR_TIMEOUT;
+			return obj->last_err;
+		}
+		if (interval_ms != 0)
+			pt_sleep_ms(interval_ms);
+	}
+}
+
+static card_err_t write_enable(card_obj_t *obj)
+{
+	Uint8_t cmd = FLASH_WREN;
+
+	return spi_cmd(obj, &cmd, 1, NULL, 0);
+}
+
+static card_err_t check_range(card_obj_t *obj, const card_spi_flash_t *f, Uint32_t addr, Uint32_t len, const void *buf)
+{
+	if (f == NULL || buf == NULL || len == 0 || f->size == 0 || addr >= f->size || len > f->size - addr) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	return CARD_NO_ERR;
+}
+
+card_err_t card_spi_flash_probe(card_obj_t *obj, Uint32_t freq, card_spi_flash_t *f)
+{
+	Uint8_t cmd = FLASH_RDID, id[3];
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (f == NULL) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	if (freq != 0) {
+		ret = card_spi_setparam(obj, SPI_PARAM_FREQ, freq);
+		if (ret != CARD_NO_ERR)
+			return ret;
+	}
+	ret = spi_cmd(obj, &cmd, 1, id, 3);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	/* 无器件时MISO为全0或全1 */
+	if ((id[0] == 0xFF && id[1] == 0xFF && id[2] == 0xFF) || (id[0] == 0 && id[1] == 0 && id[2] == 0)
+		|| id[2] < 0x10 || id[2] > 0x18) {
+		obj->last_err = 0x1008;
+		return obj->last_err;
+	}
+
+	memset(f, 0, sizeof(*f));
+	memcpy(f->jedec, id, 3);
+	/* 容量代码为2的指数，3字节地址最大16MB */
+	f->size = 1UL << id[2];
+	f->page_size = CARD_SPI_PAGE_SIZE;
+	f->sector_size = CARD_SPI_SECTOR_SIZE;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_spi_flash_erase(card_obj_t *obj, const card_spi_flash_t *f, Uint32_t addr, Uint32_t len,
+	card_stream_cb_t cb, void *arg)
+{
+	Uint8_t cmd[4];
+	Uint32_t end, size;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	ret = check_range(obj, f, addr, len, f);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	if (f->sector_size == 0 || (f->sector_size & (f->sector_size - 1)) != 0) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+
+	/* 按扇区对齐，能对齐64KB块时使用块擦除 */
+	end = addr + len;
+	addr &= ~(f->sector_size - 1);
+	while (addr < end) {
+		if ((addr & (FLASH_BLOCK_SIZE - 1)) == 0 && end - addr >= FLASH_BLOCK_SIZE) {
+			cmd[0] = FLASH_BE;
+			size = FLASH_BLOCK_SIZE;
+		} else {
+			cmd[0] = FLASH_SE;
+			size = f->sector_size;
+		}
+		put_addr(cmd + 1, addr);
+		ret = write_enable(obj);
+		if (ret == CARD_NO_ERR)
+			ret = spi_cmd(obj, cmd, 4, NULL, 0);
+		if (ret == CARD_NO_ERR)
+			ret = wait_ready(obj, CARD_SPI_ERASE_TIMEOUT, ERASE_POLL_MS);
+		if (ret != CARD_NO_ERR)
+			return ret;
+		if (cb != NULL)
+			cb(arg, addr, size);
+		addr += size;
+	}
+	return CARD_NO_ERR;
+}
+
+card_err_t card_spi_flash_read(card_obj_t *obj, const card_spi_flash_t *f, Uint32_t addr, Uint8_t *rbuf, Uint32_t len,
+	card_stream_cb_t cb, void *arg, Uint32_t *crc)
+{
+	Uint8_t cmd[5];
+	Uint32_t done = 0, n, c = 0;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	ret = check_range(obj, f, addr, len, rbuf);
+	if (ret != CARD_NO_ERR)
+		return ret;
+
+	cmd[0] = FLASH_FAST_READ;
+	cmd[4] = 0x00;		/* 空周期 */
+	while (done < len) {
+		n = len - done < CARD_SPI_READ_CHUNK ? len - done : CARD_SPI_READ_CHUNK;
+		put_addr(cmd + 1, addr + done);
+		ret = spi_cmd(obj, cmd, 5, rbuf + done, (Uint16_t)n);
+		if (ret != CARD_NO_ERR)
+			return ret;
+		c = card_crc32(c, rbuf + done, n);
+		if (cb != NULL)
+			cb(arg, done, n);
+		done += n;
+	}
+
+	if (crc != NULL)
+		*crc = c;
+	return CARD_NO_ERR;
+}
+
+static int all_ff(const Uint8_t *p, Uint32_t n)
+{
+	Uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		if (p[i] != 0xFF)
+			return 0;
+	}
+	return 1;
+}
+
+card_err_t card_spi_flash_program(card_obj_t *obj, const card_spi_flash_t *f, Uint32_t addr, const Uint8_t *image,
+	Uint32_t len, Uint8_t flags, card_stream_cb_t cb, void *arg, Uint32_t *crc)
+{
+	Uint8_t *tbuf, *vbuf;
+	Uint32_t done = 0, n, c;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	ret = check_range(obj, f, addr, len, image);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	if (f->page_size == 0 || (f->page_size & (f->page_size - 1)) != 0) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	if (flags & CARD_SPI_FLAG_ERASE) {
+		ret = card_spi_flash_erase(obj, f, addr, len, NULL, NULL);
+		if (ret != CARD_NO_ERR)
+			return ret;
+	}
+	tbuf = (Uint8_t *)malloc((size_t)f->page_size + 4);
+	if (tbuf == NULL) {
+		obj->last_err = 0x4012;
+		return obj->last_err;
+	}
+
+	/* 页编程不能跨页，第一页从起始地址写到页尾 */
+	tbuf[0] = FLASH_PP;
+	while (done < len) {
+		n = f->page_size - ((addr + done) & (f->page_size - 1));
+		if (n > len - done)
+			n = len - done;
+		/* 擦除后的页内容为0xFF，编程全0xFF数据不改变内容 */
+		if (!all_ff(image + done, n)) {
+			put_addr(tbuf + 1, addr + done);
+			memcpy(tbuf + 4, image + done, n);
+			ret = write_enable(obj);
+			if (ret == CARD_NO_ERR)
+				ret = spi_cmd(obj, tbuf, (Uint16_t)(n + 4), NULL, 0);
+			if (ret == CARD_NO_ERR)
+				ret = wait_ready(obj, CARD_SPI_PROGRAM_TIMEOUT, 0);
+			if (ret != CARD_NO_ERR)
+				break;
+		}
+		if (cb != NULL)
+			cb(arg, done, n);
+		done += n;
+	}
+	free(tbuf);
+	if (ret != CARD_NO_ERR)
+		return ret;
+
+	c = card_crc32(0, image, len);
+	if (flags & CARD_SPI_FLAG_VERIFY) {
+		vbuf = (Uint8_t *)malloc(len);
+		if (vbuf == NULL) {
+			obj->last_err = 0x4012;
+			return obj->last_err;
+		}
+		ret = card_spi_flash_read(obj, f, addr, vbuf, len, NULL, NULL, &c);
+		if (ret == CARD_NO_ERR && memcmp(vbuf, image, len) != 0) {
+			obj->last_err = CARD_ERR_VERIFY;
+			ret = obj->last_err;
+		}
+		free(vbuf);
+	}
+
+	if (ret == CARD_NO_ERR && crc != NULL)
+		*crc = c;
+	return ret;
+}
@@ -0,0 +1,372 @@
+/**
+ * \file	pt_station.c
+ * \brief	多读写器调度接口函数
+ * \details	每个读写器一个内部线程和一个任务队列。未指定读写器的任务放入最短的队列，
+ *			空闲线程在自身队列为空时从最长的队列末尾取走未指定读写器的任务。
+ *			读写器通信出错后关闭连接并按退避间隔重连，期间其队列中的任务由其他读写器执行。
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+typedef struct station_job {
+	card_req_t id;
+	Uint16_t reader;			/* 指定的读写器，CARD_STATION_ANY为不指定 */
+	card_async_fn_t fn;
+	void *fn_arg;
+	card_station_cb_t cb;
+	void *arg;
+} station_job_t;
+
+typedef struct station_reader {
+	card_station_t *st;
+	Uint16_t id;
+	Uint8_t addr[MAX_ADDR_SIZE];
+	card_obj_t obj;
+	station_job_t *jobs;		/* 队列，jobs[0]为队首 */
+	Uint16_t count;
+	Uint8_t state;
+	Uint8_t busy;
+	Uint32_t backoff_ms;
+	unsigned long long retry_at;
+	card_reader_stat_t stat;
+	pt_thread_t thread;
+} station_reader_t;
+
+struct card_station {
+	card_mod_t model;
+	Uint16_t depth;
+	Uint16_t nreaders;
+	Uint16_t next;				/* 轮询起点 */
+	card_req_t next_job;
+	Uint32_t inflight;			/* 已提交未完成(含回调)的任务个数 */
+	int stop;
+	station_reader_t *readers[CARD_STATION_MAX_READERS];
+	pt_mutex_t lock;
+	pt_cond_t cond;				/* 有新任务或退出 */
+	pt_cond_t idle;				/* 全部任务完成 */
+};
+
+static void queue_remove(station_reader_t *r, Uint16_t idx, station_job_t *job)
+{
+	*job = r->jobs[idx];
+	memmove(&r->jobs[idx], &r->jobs[idx + 1], (r->count - idx - 1) * sizeof(station_job_t));
+	r->count--;
+}
+
+/* 从其他读写器队列末尾取一个未指定读写器的任务，优先取最长的队列 */
+static int steal_job(card_station_t *st, station_reader_t *self, station_job_t *job)
+{
+	station_reader_t *r, *victim = NULL;
+	Uint16_t i, j, idx = 0;
+
+	for (i = 0; i < st->nreaders; i++) {
+		r = st->readers[i];
+		if (r == self || (victim != NULL && r->count <= victim->count))
+			continue;
+		for (j = r->count; j > 0; j--) {
+			if (r->jobs[j - 1].reader == CARD_STATION_ANY) {
+				victim = r;
+				idx = (Uint16_t)(j - 1);
+				break;
+			}
+		}
+	}
+	if (victim == NULL)
+		return 0;
+	queue_remove(victim, idx, job);
+	self->stat.stolen++;
+	return 1;
+}
+
+/* 执行回调并计数，调用时持有锁 */
+static void job_complete(card_station_t *st, const station_job_t *job, Uint16_t reader, card_err_t err)
+{
+	if (job->cb != NULL) {
+		pt_mutex_unlock(&st->lock);
+		job->cb(st, job->id, reader, err, job->arg);
+		pt_mutex_lock(&st->lock);
+	}
+	if (--st->inflight == 0)
+		pt_cond_broadcast(&st->idle);
+}
+
+/* 连接失败，指定本读写器的任务以错误完成，其余任务留给其他读写器 */
+static void reader_offline(card_station_t *st, station_reader_t *r, card_err_t err)
+{
+	station_job_t job;
+	Uint16_t i = 0;
+
+	r->state = CARD_READER_OFFLINE;
+	r->stat.last_err = err;
+	r->retry_at = pt_os_time_us() + (unsigned long long)r->backoff_ms * 1000ULL;
+	r->backoff_ms = r->backoff_ms * 2 < CARD_STATION_RETRY_MAX ? r->backoff_ms * 2 : CARD_STATION_RETRY_MAX;
+	while (i < r->count) {
+		if (r->jobs[i].reader != r->id) {
+			i++;
+			continue;
+		}
+		queue_remove(r, i, &job);
+		r->stat.errors++;
+		job_complete(st, &job, r->id, err);
+		i = 0;
+	}
+	pt_cond_broadcast(&st->cond);
+}
+
+static void station_worker(void *p)
+{
+	station_reader_t *r = (station_reader_t *)p;
+	card_station_t *st = r->st;
+	station_job_t job;
+	unsigned long long now, start;
+	card_err_t err;
+
+	pt_mutex_lock(&st->lock);
+	while (!st->stop) {
+		if (r->state != CARD_READER_ONLINE) {
+			now = pt_os_time_us();
+			if (now < r->retry_at) {
+				pt_cond_timedwait(&st->cond, &st->lock, (Uint32_t)((r->retry_at - now + 999) / 1000));
+				continue;
+			}
+			pt_mutex_unlock(&st->lock);
+			err = card_open_mt(&r->obj, st->model, r->addr);
+			pt_mutex_lock(&st->lock);
+			if (err != CARD_NO_ERR) {
+				reader_offline(st, r, err);
+				continue;
+			}
+			if (r->state == CARD_READER_OFFLINE)
+				r->stat.reconnects++;
+			r->state = CARD_READER_ONLINE;
+			r->backoff_ms = CARD_STATION_RETRY_MIN;
+		}
+
+		if (r->count > 0) {
+			queue_remove(r, 0, &job);
+		} else if (!steal_job(st, r, &job)) {
+			pt_cond_wait(&st->cond, &st->lock);
+			continue;
+		}
+		r->busy = 1;
+		pt_mutex_unlock(&st->lock);
+
+		start = pt_os_time_us();
+		err = job.fn(&r->obj, job.fn_arg);
+		now = pt_os_time_us();
+		/* 连接异常，在锁外关闭，其他读写器的提交和完成不等待关闭 */
+		if (card_err_class(err) == CARD_ERR_CLASS_LINK)
+			card_close(&r->obj);
+
+		pt_mutex_lock(&st->lock);
+		r->busy = 0;
+		r->stat.done++;
+		r->stat.busy_ms += (Uint32_t)((now - start) / 1000);
+		if (err != CARD_NO_ERR) {
+			r->stat.errors++;
+			r->stat.last_err = err;
+		}
+		if (card_err_class(err) == CARD_ERR_CLASS_LINK) {
+			/* 立即重连一次，失败后按退避间隔重试 */
+			r->state = CARD_READER_OFFLINE;
+			r->retry_at = 0;
+		}
+		job_complete(st, &job, r->id, err);
+	}
+	pt_mutex_unlock(&st->lock);
+
+	if (r->state == CARD_READER_ONLINE)
+		card_close(&r->obj);
+}
+
+card_err_t card_station_create(card_station_t **st, card_mod_t model, Uint16_t depth)
+{
+	card_station_t *s;
+
+	if (st == NULL)
+		return 0x3007;
+	s = (card_station_t *)calloc(1, sizeof(card_station_t));
+	if (s == NULL)
+		return 0x4012;
+	s->model = model;
+	s->depth = depth != 0 ? depth : CARD_ASYNC_DEFAULT_DEPTH;
+	pt_mutex_init(&s->lock);
+	pt_cond_init(&s->cond);
+	pt_cond_init(&s->idle);
+	*st = s;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_station_add(card_station_t *st, Uint8_t *addr, Uint16_t *reader)
+{
+	station_reader_t *r;
+
+	if (st == NULL || addr == NULL || strlen((const char *)addr) >= MAX_ADDR_SIZE)
+		return 0x3007;
+	r = (station_reader_t *)calloc(1, sizeof(station_reader_t));
+	if (r == NULL)
+		return 0x4012;
+	r->jobs = (station_job_t *)calloc(st->depth, sizeof(station_job_t));
+	if (r->jobs == NULL) {
+		free(r);
+		return 0x4012;
+	}
+	r->st = st;
+	memcpy(r->addr, addr, strlen((const char *)addr) + 1);
+	r->obj.handle = -1;
+	r->state = CARD_READER_CONNECTING;
+	r->backoff_ms = CARD_STATION_RETRY_MIN;
+
+	pt_mutex_lock(&st->lock);
+	if (st->nreaders >= CARD_STATION_MAX_READERS) {
+		pt_mutex_unlock(&st->lock);
+		free(r->jobs);
+		free(r);
+		return CARD_ERR_POOL_FULL;
+	}
+	r->id = st->nreaders;
+	if (pt_thread_create(&r->thread, station_worker, r) != 0) {
+		pt_mutex_unlock(&st->lock);
+		free(r->jobs);
+		free(r);
+		return 0x4012;
+	}
+	st->readers[st->nreaders++] = r;
+	pt_mutex_unlock(&st->lock);
+
+	if (reader != NULL)
+		*reader = r->id;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_station_submit(card_station_t *st, Uint16_t reader, card_async_fn_t fn, void *fn_arg,
+	card_station_cb_t cb, void *arg, card_req_t *job)
+{
+	station_reader_t *r, *best = NULL;
+	station_job_t *j;
+	Uint16_t i;
+	Uint32_t load, best_load = 0;
+
+	if (st == NULL || fn == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&st->lock);
+	if (reader != CARD_STATION_ANY) {
+		if (reader >= st->nreaders) {
+			pt_mutex_unlock(&st->lock);
+			return 0x3007;
+		}
+		best = st->readers[reader];
+		if (best->count >= st->depth)
+			best = NULL;
+	} else {
+		/* 优先在线读写器中负载最小的，相同时轮询 */
+		for (i = 0; i < st->nreaders; i++) {
+			r = st->readers[(st->next + i) % st->nreaders];
+			if (r->count >= st->depth)
+				continue;
+			/* 离线读写器的负载总是大于在线读写器，Uint32_t不会溢出 */
+			load = (Uint32_t)r->count + r->busy + (r->state == CARD_READER_ONLINE ? 0 : (Uint32_t)st->depth + 1);
+			if (best == NULL || load < best_load) {
+				best = r;
+				best_load = load;
+			}
+		}
+		if (st->nreaders > 0)
+			st->next = (Uint16_t)((st->next + 1) % st->nreaders);
+	}
+	if (best == NULL) {
+		pt_mutex_unlock(&st->lock);
+		return st->nreaders == 0 ? 0x4003 : CARD_ERR_QUEUE_FULL;
+	}
+
+	/* 任务句柄从1开始，0保留 */
+	if (++st->next_job == 0)
+		st->next_job = 1;
+	j = &best->jobs[best->count++];
+	j->id = st->next_job;
+	j->reader = reader;
+	j->fn = fn;
+	j->fn_arg = fn_arg;
+	j->cb = cb;
+	j->arg = arg;
+	st->inflight++;
+	pt_cond_broadcast(&st->cond);
+	pt_mutex_unlock(&st->lock);
+
+	if (job != NULL)
+		*job = j->id;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_station_wait(card_station_t *st, Uint32_t timeout_ms)
+{
+	unsigned long long end, now;
+	card_err_t ret = CARD_NO_ERR;
+
+	if (st == NULL)
+		return 0x3007;
+
+	end = pt_os_time_us() + (unsigned long long)timeout_ms * 1000ULL;
+	pt_mutex_lock(&st->lock);
+	while (st->inflight > 0) {
+		if (timeout_ms == 0) {
+			pt_cond_wait(&st->idle, &st->lock);
+			continue;
+		}
+		now = pt_os_time_us();
+		if (now >= end) {
+			ret = CARD_ERR_TIMEOUT;
+			break;
+		}
+		pt_cond_timedwait(&st->idle, &st->lock, (Uint32_t)((end - now + 999) / 1000));
+	}
+	pt_mutex_unlock(&st->lock);
+	return ret;
+}
+
+card_err_t card_station_stat(card_station_t *st, Uint16_t reader, card_reader_stat_t *stat)
+{
+	station_reader_t *r;
+
+	if (st == NULL || stat == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&st->lock);
+	if (reader >= st->nreaders) {
+		pt_mutex_unlock(&st->lock);
+		return 0x3007;
+	}
+	r = st->readers[reader];
+	*stat = r->stat;
+	stat->state = r->state;
+	stat->queued = r->count;
+	pt_mutex_unlock(&st->lock);
+	return CARD_NO_ERR;
+}
+
+card_err_t card_station_destroy(card_station_t *st)
+{
+	Uint16_t i;
+
+	if (st == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&st->lock);
+	st->stop = 1;
+	pt_cond_broadcast(&st->cond);
+	pt_mutex_unlock(&st->lock);
+	for (i = 0; i < st->nreaders; i++) {
+		pt_thread_join(st->readers[i]->thread);
+		free(st->readers[i]->jobs);
+		free(st->readers[i]);
+	}
+
+	pt_cond_destroy(&st->idle);
+	pt_cond_destroy(&st->cond);
+	pt_mutex_destroy(&st->lock);
+	free(st);
+	return CARD_NO_ERR;
+}
@@ -0,0 +1,211 @@
+/**
+ * \file	pt_swd.c
+ * \brief	SWD MEM-AP批量内存读写接口函数
+ * \details	读写器只提供单个DP/AP寄存器读写，批量传输使用MEM-AP地址自动递增，
+ *			每个字只访问一次DRW，TAR只在1KB边界重新设置。粘滞错误时清除后重试当前1KB段。
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+
+/* DP寄存器 */
+#define DP_DPIDR			CARD_SWD_DP_REG(0x00)
+#define DP_CTRL_STAT		CARD_SWD_DP_REG(0x04)
+#define DP_SELECT			CARD_SWD_DP_REG(0x08)
+#define DP_RDBUFF			CARD_SWD_DP_REG(0x0C)
+/* MEM-AP寄存器，bank 0 */
+#define AP_CSW				CARD_SWD_AP_REG(0x00)
+#define AP_TAR				CARD_SWD_AP_REG(0x04)
+#define AP_DRW				CARD_SWD_AP_REG(0x0C)
+
+#define CSW_SIZE_WORD		0x00000002UL
+#define CSW_ADDRINC_SINGLE	0x00000010UL
+#define CSW_MODE_MASK		0x0000003FUL
+/* CTRL/STAT粘滞错误位: STICKYORUN STICKYCMP STICKYERR WDATAERR */
+#define STAT_STICKY_MASK	0x000000B2UL
+
+/* DPIDR: RAO(位0) DESIGNER(位1-11) VERSION(位12-15) */
+#define DPIDR_RAO			0x00000001UL
+#define DPIDR_DESIGNER(v)	(((v) >> 1) & 0x7FFUL)
+#define DPIDR_VERSION(v)	(((v) >> 12) & 0x0FUL)
+
+/* TAR自动递增只保证低10位 */
+#define TAR_WRAP			0x400UL
+
+static Uint32_t get_le32(const Uint8_t *p)
+{
+	return (Uint32_t)p[0] | ((Uint32_t)p[1] << 8) | ((Uint32_t)p[2] << 16) | ((Uint32_t)p[3] << 24);
+}
+
+static void put_le32(Uint8_t *p, Uint32_t v)
+{
+	p[0] = (Uint8_t)v;
+	p[1] = (Uint8_t)(v >> 8);
+	p[2] = (Uint8_t)(v >> 16);
+	p[3] = (Uint8_t)(v >> 24);
+}
+
+/* 写入任何寄存器前读DPIDR，确认寄存器地址编码和目标连接有效 */
+static card_err_t check_dpidr(card_obj_t *obj)
+{
+	Uint32_t id = 0;
+	card_err_t ret;
+
+	ret = card_swd_dap_read(obj, DP_DPIDR, &id);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	if (!(id & DPIDR_RAO) || DPIDR_DESIGNER(id) == 0 || DPIDR_DESIGNER(id) == 0x7FF
+		|| DPIDR_VERSION(id) < 1 || DPIDR_VERSION(id) > 3) {
+		obj->last_err = CARD_ERR_SWD_DPIDR;
+		return obj->last_err;
+	}
+	return CARD_NO_ERR;
+}
+
+/* 选择AP bank 0，CSW设为32位访问、单次递增，保留其他位 */
+static card_err_t ap_setup(card_obj_t *obj, Uint8_t ap)
+{
+	Uint32_t csw;
+	card_err_t ret;
+
+	ret = card_swd_dap_write(obj, DP_SELECT, (Uint32_t)ap << 24);
+	/* AP读为延迟读，结果在RDBUFF中 */
+	if (ret == CARD_NO_ERR)
+		ret = card_swd_dap_read(obj, AP_CSW, &csw);
+	if (ret == CARD_NO_ERR)
+		ret = card_swd_dap_read(obj, DP_RDBUFF, &csw);
+	if (ret == CARD_NO_ERR)
+		ret = card_swd_dap_write(obj, AP_CSW, (csw & ~CSW_MODE_MASK) | CSW_SIZE_WORD | CSW_ADDRINC_SINGLE);
+	return ret;
+}
+
+/* 检查粘滞错误位，有错误时返回CARD_ERR_SWD_STICKY */
+static card_err_t check_sticky(card_obj_t *obj)
+{
+	Uint32_t stat;
+	card_err_t ret;
+
+	ret = card_swd_dap_read(obj, DP_CTRL_STAT, &stat);
+	if (ret == CARD_NO_ERR && (stat & STAT_STICKY_MASK)) {
+		obj->last_err = CARD_ERR_SWD_STICKY;
+		ret = obj->last_err;
+	}
+	return ret;
+}
+
+/* 读写一个不跨1KB边界的段，n为字数 */
+static card_err_t seg_xfer(card_obj_t *obj, int write, Uint32_t addr, Uint8_t *buf, Uint32_t n)
+{
+	Uint32_t i, v;
+	card_err_t ret;
+
+	ret = card_swd_dap_write(obj, AP_TAR, addr);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	if (write) {
+		for (i = 0; i < n && ret == CARD_NO_ERR; i++)
+			ret = card_swd_dap_write(obj, AP_DRW, get_le32(buf + 4 * i));
+	} else {
+		/* 第一次读DRW启动传输，之后每次读取上一个字，最后一个字从RDBUFF读取 */
+		ret = card_swd_dap_read(obj, AP_DRW, &v);
+		for (i = 1; i < n && ret == CARD_NO_ERR; i++) {
+			ret = card_swd_dap_read(obj, AP_DRW, &v);
+			put_le32(buf + 4 * (i - 1), v);
+		}
+		if (ret == CARD_NO_ERR)
+			ret = card_swd_dap_read(obj, DP_RDBUFF, &v);
+		if (ret == CARD_NO_ERR)
+			put_le32(buf + 4 * (n - 1), v);
+	}
+	if (ret == CARD_NO_ERR)
+		ret = check_sticky(obj);
+	return ret;
+}
+
+static card_err_t mem_xfer(card_obj_t *obj, int write, Uint8_t ap, Uint32_t addr, Uint8_t *buf, Uint32_t len,
+	card_stream_cb_t cb, void *arg)
+{
+	Uint32_t done = 0, n;
+	Uint8_t retries;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (buf == NULL || len == 0 || (addr & 3) != 0 || (len & 3) != 0) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+
+	ret = check_dpidr(obj);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	ret = ap_setup(obj, ap);
+	while (ret == CARD_NO_ERR && done < len) {
+		n = TAR_WRAP - ((addr + done) & (TAR_WRAP - 1));
+		if (n > len - done)
+			n = len - done;
+		ret = seg_xfer(obj, write, addr + done, buf + done, n / 4);
+		/* FAULT应答或粘滞错误后清除错误，重新设置AP并重试本段 */
+		for (retries = 0; ret != CARD_NO_ERR && card_err_class(ret) != CARD_ERR_CLASS_LINK && retries < CARD_SWD_RETRIES; retries++) {
+			ret = card_swd_clr_error(obj);
+			if (ret == CARD_NO_ERR)
+				ret = ap_setup(obj, ap);
+			if (ret == CARD_NO_ERR)
+				ret = seg_xfer(obj, write, addr + done, buf + done, n / 4);
+		}
+		if (ret != CARD_NO_ERR)
+			break;
+		if (cb != NULL)
+			cb(arg, done, n);
+		done += n;
+	}
+	/* 返回前清除粘滞错误，不影响后续操作 */
+	if (ret != CARD_NO_ERR && card_err_class(ret) != CARD_ERR_CLASS_LINK) {
+		card_swd_clr_error(obj);
+		obj->last_err = ret;
+	}
+	return ret;
+}
+
+card_err_t card_swd_mem_read(card_obj_t *obj, Uint8_t ap, Uint32_t addr, Uint8_t *rbuf, Uint32_t len,
+	card_stream_cb_t cb, void *arg, Uint32_t *crc)
+{
+	card_err_t ret;
+
+	ret = mem_xfer(obj, 0, ap, addr, rbuf, len, cb, arg);
+	if (ret == CARD_NO_ERR && crc != NULL)
+		*crc = card_crc32(0, rbuf, len);
+	return ret;
+}
+
+card_err_t card_swd_mem_write(card_obj_t *obj, Uint8_t ap, Uint32_t addr, const Uint8_t *tbuf, Uint32_t len,
+	Uint8_t flags, card_stream_cb_t cb, void *arg, Uint32_t *crc)
+{
+	Uint8_t *vbuf;
+	Uint32_t c;
+	card_err_t ret;
+
+	/* 写入时缓存只读 */
+	ret = mem_xfer(obj, 1, ap, addr, (Uint8_t *)tbuf, len, cb, arg);
+	if (ret != CARD_NO_ERR)
+		return ret;
+
+	c = card_crc32(0, tbuf, len);
+	if (flags & CARD_SWD_FLAG_VERIFY) {
+		vbuf = (Uint8_t *)malloc(len);
+		if (vbuf == NULL) {
+			obj->last_err = 0x4012;
+			return obj->last_err;
+		}
+		ret = card_swd_mem_read(obj, ap, addr, vbuf, len, NULL, NULL, &c);
+		if (ret == CARD_NO_ERR && memcmp(vbuf, tbuf, len) != 0) {
+			obj->last_err = CARD_ERR_VERIFY;
+			ret = obj->last_err;
+		}
+		free(vbuf);
+	}
+
+	if (ret == CARD_NO_ERR && crc != NULL)
+		*crc = c;
+	return ret;
+}
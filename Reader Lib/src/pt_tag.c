@@ -0,0 +1,378 @@
+/**
+ * \file	pt_tag.c
+ * \brief	ISO15693和FeliCa标签批量读写接口函数
+ * \details	通过card_pipe发送标签命令帧，按每条命令的块数上限分段，
+ *			每段完成后回调，标签返回错误时停止。
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+
+/* ISO15693 */
+#define ISO15693_FLAG_HIGH_RATE		0x02
+#define ISO15693_FLAG_ADDRESS		0x20
+#define ISO15693_FLAG_ERROR			0x01
+#define ISO15693_READ_MULTIPLE		0x23
+#define ISO15693_WRITE_SINGLE		0x21
+#define ISO15693_WRITE_MULTIPLE		0x24
+#define ISO15693_ERR_NOT_SUPPORTED	0x01
+#define ISO15693_ERR_NOT_RECOGNIZED	0x02
+
+/* FeliCa */
+#define FELICA_POLLING				0x00
+#define FELICA_READ					0x06
+#define FELICA_WRITE				0x08
+#define FELICA_BLOCK_SIZE			16
+
+/* 标签命令最大长度，与card_pipe长度类型一致 */
+#define TAG_FRAME_MAX				512
+
+/* card_pipe不检查应答长度，应答缓存按最大应答长度分配 */
+static Uint8_t *tag_rbuf(card_obj_t *obj)
+{
+	Uint8_t *r = (Uint8_t *)malloc(CARD_APDU_RESP_MAX);
+
+	if (r == NULL)
+		obj->last_err = 0x4012;
+	return r;
+}
+
+static Uint8_t tbuf_15693_head(Uint8_t *t, Uint8_t cmd, const Uint8_t *uid)
+{
+	Uint8_t n = 0;
+
+	t[n++] = (Uint8_t)(ISO15693_FLAG_HIGH_RATE | (uid != NULL ? ISO15693_FLAG_ADDRESS : 0));
+	t[n++] = cmd;
+	if (uid != NULL) {
+		memcpy(t + n, uid, 8);
+		n += 8;
+	}
+	return n;
+}
+
+/* 标签错误: obj->sw1为应答标志，obj->sw2为错误码 */
+static card_err_t check_15693(card_obj_t *obj, const Uint8_t *r, Uint16_t rlen)
+{
+	if (rlen < 1) {
+		obj->last_err = 0x2006;
+		return obj->last_err;
+	}
+	if (r[0] & ISO15693_FLAG_ERROR) {
+		obj->sw1 = r[0];
+		obj->sw2 = rlen > 1 ? r[1] : 0;
+		obj->last_err = CARD_ERR_SW_UNEXPECTED;
+		return obj->last_err;
+	}
+	return CARD_NO_ERR;
+}
+
+card_err_t card_15693_read_blocks(card_obj_t *obj, Uint8_t *uid, Uint8_t first, Uint16_t count, Uint8_t block_size,
+	Uint8_t max_blocks, Uint8_t *rbuf, card_stream_cb_t cb, void *arg, Uint32_t *rlen)
+{
+	Uint8_t t[16], *r;
+	Uint16_t n, tl, rl, done = 0;
+	card_err_t ret = CARD_NO_ERR;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (rbuf == NULL || count == 0 || block_size == 0 || block_size > CARD_15693_BLOCK_MAX || first + count > 256) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	r = tag_rbuf(obj);
+	if (r == NULL)
+		return obj->last_err;
+	if (max_blocks == 0)
+		max_blocks = CARD_15693_READ_BLOCKS;
+	if ((Uint32_t)max_blocks * block_size > TAG_FRAME_MAX - 1)
+		max_blocks = (Uint8_t)((TAG_FRAME_MAX - 1) / block_size);
+	if (rlen != NULL)
+		*rlen = 0;
+
+	while (done < count) {
+		n = (Uint16_t)(count - done < max_blocks ? count - done : max_blocks);
+		tl = tbuf_15693_head(t, ISO15693_READ_MULTIPLE, uid);
+		t[tl++] = (Uint8_t)(first + done);
+		t[tl++] = (Uint8_t)(n - 1);
+		rl = 0;
+		ret = card_pipe(obj, t, tl, r, &rl);
+		if (ret == CARD_NO_ERR)
+			ret = check_15693(obj, r, rl);
+		if (ret == CARD_NO_ERR && rl != 1 + n * block_size) {
+			obj->last_err = 0x2006;
+			ret = obj->last_err;
+		}
+		if (ret != CARD_NO_ERR)
+			break;
+
+		memcpy(rbuf + (Uint32_t)done * block_size, r + 1, (size_t)n * block_size);
+		if (cb != NULL)
+			cb(arg, (Uint32_t)done * block_size, (Uint32_t)n * block_size);
+		done = (Uint16_t)(done + n);
+		if (rlen != NULL)
+			*rlen = (Uint32_t)done * block_size;
+	}
+	free(r);
+	return ret;
+}
+
+card_err_t card_15693_write_blocks(card_obj_t *obj, Uint8_t *uid, Uint8_t first, Uint16_t count, Uint8_t block_size,
+	Uint8_t max_blocks, const Uint8_t *tbuf, card_stream_cb_t cb, void *arg, Uint32_t *wlen)
+{
+	Uint8_t t[TAG_FRAME_MAX], *r;
+	Uint16_t n, tl, rl, done = 0;
+	card_err_t ret = CARD_NO_ERR;
+	int single;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (tbuf == NULL || count == 0 || block_size == 0 || block_size > CARD_15693_BLOCK_MAX || first + count > 256) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	r = tag_rbuf(obj);
+	if (r == NULL)
+		return obj->last_err;
+	if (max_blocks == 0)
+		max_blocks = CARD_15693_WRITE_BLOCKS;
+	if ((Uint32_t)max_blocks * block_size > TAG_FRAME_MAX - 12)
+		max_blocks = (Uint8_t)((TAG_FRAME_MAX - 12) / block_size);
+	single = max_blocks == 1;
+	if (wlen != NULL)
+		*wlen = 0;
+
+	while (done < count) {
+		n = single ? 1 : (Uint16_t)(count - done < max_blocks ? count - done : max_blocks);
+		tl = tbuf_15693_head(t, single ? ISO15693_WRITE_SINGLE : ISO15693_WRITE_MULTIPLE, uid);
+		t[tl++] = (Uint8_t)(first + done);
+		if (!single)
+			t[tl++] = (Uint8_t)(n - 1);
+		memcpy(t + tl, tbuf + (Uint32_t)done * block_size, (size_t)n * block_size);
+		tl = (Uint16_t)(tl + n * block_size);
+		rl = 0;
+		ret = card_pipe(obj, t, tl, r, &rl);
+		if (ret == CARD_NO_ERR)
+			ret = check_15693(obj, r, rl);
+		/* 不支持WRITE MULTIPLE BLOCKS的标签改为逐块写入 */
+		if (ret == CARD_ERR_SW_UNEXPECTED && !single
+			&& (obj->sw2 == ISO15693_ERR_NOT_SUPPORTED || obj->sw2 == ISO15693_ERR_NOT_RECOGNIZED)) {
+			single = 1;
+			continue;
+		}
+		if (ret != CARD_NO_ERR)
+			break;
+
+		if (cb != NULL)
+			cb(arg, (Uint32_t)done * block_size, (Uint32_t)n * block_size);
+		done = (Uint16_t)(done + n);
+		if (wlen != NULL)
+			*wlen = (Uint32_t)done * block_size;
+	}
+	free(r);
+	obj->last_err = ret;
+	return ret;
+}
+
+/*---- FeliCa ----*/
+/* 标签错误: obj->sw1、obj->sw2为状态标志1、2 */
+static card_err_t check_felica(card_obj_t *obj, const Uint8_t *r, Uint16_t rlen, Uint8_t code, const Uint8_t *idm)
+{
+	if (rlen < 12 || r[0] != rlen || r[1] != code || memcmp(r + 2, idm, 8) != 0) {
+		obj->last_err = 0x2006;
+		return obj->last_err;
+	}
+	if (r[10] != 0x00) {
+		obj->sw1 = r[10];
+		obj->sw2 = r[11];
+		obj->last_err = CARD_ERR_SW_UNEXPECTED;
+		return obj->last_err;
+	}
+	return CARD_NO_ERR;
+}
+
+/* 命令头: 长度 命令 IDm 服务个数 服务代码表 块个数 块列表，返回长度 */
+static Uint16_t felica_head(Uint8_t *t, Uint8_t code, const Uint8_t *idm, const Uint16_t *services, Uint8_t nsvc,
+	const card_felica_block_t *blocks, Uint16_t n)
+{
+	Uint16_t tl = 1, i;
+
+	t[tl++] = code;
+	memcpy(t + tl, idm, 8);
+	tl += 8;
+	t[tl++] = nsvc;
+	for (i = 0; i < nsvc; i++) {
+		t[tl++] = (Uint8_t)services[i];
+		t[tl++] = (Uint8_t)(services[i] >> 8);
+	}
+	t[tl++] = (Uint8_t)n;
+	/* 块号小于256时使用2字节块列表元素 */
+	for (i = 0; i < n; i++) {
+		if (blocks[i].block < 256) {
+			t[tl++] = (Uint8_t)(0x80 | (blocks[i].service & 0x0F));
+			t[tl++] = (Uint8_t)blocks[i].block;
+		} else {
+			t[tl++] = (Uint8_t)(blocks[i].service & 0x0F);
+			t[tl++] = (Uint8_t)blocks[i].block;
+			t[tl++] = (Uint8_t)(blocks[i].block >> 8);
+		}
+	}
+	return tl;
+}
+
+static card_err_t felica_check_args(card_obj_t *obj, const Uint8_t *idm, const Uint16_t *services, Uint8_t nsvc,
+	const card_felica_block_t *blocks, Uint16_t nblocks, const Uint8_t *buf)
+{
+	Uint16_t i;
+
+	if (idm == NULL || services == NULL || nsvc == 0 || nsvc > CARD_FELICA_SERVICES_MAX
+		|| blocks == NULL || nblocks == 0 || buf == NULL) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	for (i = 0; i < nblocks; i++) {
+		if (blocks[i].service >= nsvc) {
+			obj->last_err = 0x3007;
+			return obj->last_err;
+		}
+	}
+	return CARD_NO_ERR;
+}
+
+card_err_t card_felica_poll(card_obj_t *obj, const card_pcfg_t *cfg, Uint8_t *idm, Uint8_t *pmm)
+{
+	Uint8_t t[6], *r;
+	Uint16_t rl = 0, system_code;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	if (idm == NULL) {
+		obj->last_err = 0x3007;
+		return obj->last_err;
+	}
+	/* 与读写器轮询使用相同的系统代码 */
+	system_code = cfg != NULL ? cfg->system_code : 0xFFFF;
+	t[0] = 6;
+	t[1] = FELICA_POLLING;
+	t[2] = (Uint8_t)(system_code >> 8);
+	t[3] = (Uint8_t)system_code;
+	t[4] = 0x00;		/* 不请求系统代码 */
+	t[5] = 0x00;		/* 单时隙 */
+	r = tag_rbuf(obj);
+	if (r == NULL)
+		return obj->last_err;
+	ret = card_pipe(obj, t, 6, r, &rl);
+	if (ret == CARD_NO_ERR && (rl < 18 || r[1] != FELICA_POLLING + 1)) {
+		obj->last_err = 0x2006;
+		ret = obj->last_err;
+	}
+	if (ret == CARD_NO_ERR) {
+		memcpy(idm, r + 2, 8);
+		if (pmm != NULL)
+			memcpy(pmm, r + 10, 8);
+	}
+	free(r);
+	return ret;
+}
+
+card_err_t card_felica_read(card_obj_t *obj, Uint8_t *idm, const Uint16_t *services, Uint8_t nsvc,
+	const card_felica_block_t *blocks, Uint16_t nblocks, Uint8_t max_blocks, Uint8_t *rbuf,
+	card_stream_cb_t cb, void *arg, Uint32_t *rlen)
+{
+	Uint8_t t[TAG_FRAME_MAX], *r;
+	Uint16_t n, tl, rl, done = 0;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	ret = felica_check_args(obj, idm, services, nsvc, blocks, nblocks, rbuf);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	if (max_blocks == 0)
+		max_blocks = CARD_FELICA_READ_BLOCKS;
+	if (max_blocks > CARD_FELICA_BLOCKS_MAX)
+		max_blocks = CARD_FELICA_BLOCKS_MAX;
+	r = tag_rbuf(obj);
+	if (r == NULL)
+		return obj->last_err;
+	if (rlen != NULL)
+		*rlen = 0;
+
+	while (done < nblocks) {
+		n = (Uint16_t)(nblocks - done < max_blocks ? nblocks - done : max_blocks);
+		tl = felica_head(t, FELICA_READ, idm, services, nsvc, blocks + done, n);
+		t[0] = (Uint8_t)tl;
+		rl = 0;
+		ret = card_pipe(obj, t, tl, r, &rl);
+		if (ret == CARD_NO_ERR)
+			ret = check_felica(obj, r, rl, FELICA_READ + 1, idm);
+		/* 应答: 长度 07 IDm 状态1 状态2 块个数 块数据 */
+		if (ret == CARD_NO_ERR && (rl != 13 + n * FELICA_BLOCK_SIZE || r[12] != n)) {
+			obj->last_err = 0x2006;
+			ret = obj->last_err;
+		}
+		if (ret != CARD_NO_ERR)
+			break;
+
+		memcpy(rbuf + (Uint32_t)done * FELICA_BLOCK_SIZE, r + 13, (size_t)n * FELICA_BLOCK_SIZE);
+		if (cb != NULL)
+			cb(arg, (Uint32_t)done * FELICA_BLOCK_SIZE, (Uint32_t)n * FELICA_BLOCK_SIZE);
+		done = (Uint16_t)(done + n);
+		if (rlen != NULL)
+			*rlen = (Uint32_t)done * FELICA_BLOCK_SIZE;
+	}
+	free(r);
+	return ret;
+}
+
+card_err_t card_felica_write(card_obj_t *obj, Uint8_t *idm, const Uint16_t *services, Uint8_t nsvc,
+	const card_felica_block_t *blocks, Uint16_t nblocks, Uint8_t max_blocks, const Uint8_t *tbuf,
+	card_stream_cb_t cb, void *arg, Uint32_t *wlen)
+{
+	Uint8_t t[TAG_FRAME_MAX], *r;
+	Uint16_t n, tl, rl, done = 0;
+	card_err_t ret;
+
+	if (obj == NULL)
+		return 0x3007;
+	ret = felica_check_args(obj, idm, services, nsvc, blocks, nblocks, tbuf);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	if (max_blocks == 0)
+		max_blocks = CARD_FELICA_WRITE_BLOCKS;
+	if (max_blocks > CARD_FELICA_BLOCKS_MAX)
+		max_blocks = CARD_FELICA_BLOCKS_MAX;
+	r = tag_rbuf(obj);
+	if (r == NULL)
+		return obj->last_err;
+	if (wlen != NULL)
+		*wlen = 0;
+
+	while (done < nblocks) {
+		n = (Uint16_t)(nblocks - done < max_blocks ? nblocks - done : max_blocks);
+		tl = felica_head(t, FELICA_WRITE, idm, services, nsvc, blocks + done, n);
+		memcpy(t + tl, tbuf + (Uint32_t)done * FELICA_BLOCK_SIZE, (size_t)n * FELICA_BLOCK_SIZE);
+		tl = (Uint16_t)(tl + n * FELICA_BLOCK_SIZE);
+		/* 长度字节只有8位 */
+		if (tl > 255) {
+			obj->last_err = 0x3007;
+			ret = obj->last_err;
+			break;
+		}
+		t[0] = (Uint8_t)tl;
+		rl = 0;
+		ret = card_pipe(obj, t, tl, r, &rl);
+		if (ret == CARD_NO_ERR)
+			ret = check_felica(obj, r, rl, FELICA_WRITE + 1, idm);
+		if (ret != CARD_NO_ERR)
+			break;
+
+		if (cb != NULL)
+			cb(arg, (Uint32_t)done * FELICA_BLOCK_SIZE, (Uint32_t)n * FELICA_BLOCK_SIZE);
+		done = (Uint16_t)(done + n);
+		if (wlen != NULL)
+			*wlen = (Uint32_t)done * FELICA_BLOCK_SIZE;
+	}
+	free(r);
+	return ret;
+}
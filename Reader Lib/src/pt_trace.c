@@ -0,0 +1,265 @@
+/**
+ * \file	pt_trace.c
+ * \brief	通信跟踪接口函数
+ * \details	记录写入固定大小槽位的无锁环形缓存(多生产者)，
+ *			内部线程定期取出记录并按二进制格式写入跟踪文件。缓存满时丢弃新记录并计数。
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+/* 跟踪线程写文件间隔 单位毫秒 */
+#define TRACE_DRAIN_INTERVAL	10
+
+typedef struct trace_slot {
+	volatile long seq;
+	unsigned long long time_us;
+	Int32_t handle;
+	Uint8_t addr[MAX_ADDR_SIZE];
+	Uint8_t cmd;
+	Uint8_t dir;
+	card_err_t err;
+	Uint16_t len;
+	Uint16_t data_len;
+	Uint8_t data[CARD_TRACE_DATA_MAX];
+} trace_slot_t;
+
+struct card_trace {
+	trace_slot_t *slots;
+	unsigned long mask;
+	volatile long head;			/* 生产者位置 */
+	unsigned long tail;			/* 消费者位置，持有drain_lock访问 */
+	volatile long dropped;
+	unsigned long long epoch_us;	/* 系统时间与单调时钟之差 */
+	FILE *fp;
+	int stop;
+	pt_mutex_t drain_lock;
+	pt_mutex_t lock;
+	pt_cond_t cond;
+	pt_thread_t thread;
+};
+
+static void put_le(Uint8_t *p, unsigned long long v, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		p[i] = (Uint8_t)(v >> (8 * i));
+}
+
+/* 取出全部可读记录写入文件。调用时持有drain_lock */
+static void trace_drain(card_trace_t *trace)
+{
+	trace_slot_t *slot;
+	Uint8_t hdr[CARD_TRACE_RECORD_HEAD];
+	unsigned long pos;
+	int written = 0;
+
+	for (;;) {
+		pos = trace->tail;
+		slot = &trace->slots[pos & trace->mask];
+		if ((unsigned long)pt_atomic_load(&slot->seq) != pos + 1)
+			break;
+
+		put_le(hdr, slot->time_us + trace->epoch_us, 8);
+		put_le(hdr + 8, (unsigned long)slot->handle, 4);
+		memcpy(hdr + 12, slot->addr, MAX_ADDR_SIZE);
+		hdr[28] = slot->cmd;
+		hdr[29] = slot->dir;
+		put_le(hdr + 30, slot->err, 2);
+		put_le(hdr + 32, slot->len, 2);
+		put_le(hdr + 34, slot->data_len, 2);
+		fwrite(hdr, 1, sizeof(hdr), trace->fp);
+		fwrite(slot->data, 1, slot->data_len, trace->fp);
+		written = 1;
+
+		trace->tail = pos + 1;
+		pt_atomic_store(&slot->seq, (long)(pos + trace->mask + 1));
+	}
+	if (written)
+		fflush(trace->fp);
+}
+
+static void trace_worker(void *p)
+{
+	card_trace_t *trace = (card_trace_t *)p;
+
+	pt_mutex_lock(&trace->lock);
+	while (!trace->stop) {
+		pt_cond_timedwait(&trace->cond, &trace->lock, TRACE_DRAIN_INTERVAL);
+		pt_mutex_lock(&trace->drain_lock);
+		trace_drain(trace);
+		pt_mutex_unlock(&trace->drain_lock);
+	}
+	pt_mutex_unlock(&trace->lock);
+}
+
+card_err_t card_trace_create(card_trace_t **trace, Uint32_t slots, Uint8_t *path)
+{
+	card_trace_t *t;
+	Uint8_t hdr[CARD_TRACE_FILE_HEAD];
+	unsigned long n, i;
+
+	if (trace == NULL || path == NULL || slots == 0)
+		return 0x3007;
+	/* 槽位个数取2的幂 */
+	for (n = 1; n < slots; n <<= 1)
+		;
+
+	t = (card_trace_t *)calloc(1, sizeof(card_trace_t));
+	if (t == NULL)
+		return 0x4012;
+	t->slots = (trace_slot_t *)calloc(n, sizeof(trace_slot_t));
+	if (t->slots == NULL) {
+		free(t);
+		return 0x4012;
+	}
+	t->fp = fopen((const char *)path, "wb");
+	if (t->fp == NULL) {
+		free(t->slots);
+		free(t);
+		return 0x3009;
+	}
+	put_le(hdr, CARD_TRACE_MAGIC, 4);
+	put_le(hdr + 4, CARD_TRACE_VERSION, 2);
+	put_le(hdr + 6, 0, 2);
+	fwrite(hdr, 1, sizeof(hdr), t->fp);
+
+	for (i = 0; i < n; i++)
+		t->slots[i].seq = (long)i;
+	t->mask = n - 1;
+	t->epoch_us = pt_os_realtime_us() - pt_os_time_us();
+	pt_mutex_init(&t->drain_lock);
+	pt_mutex_init(&t->lock);
+	pt_cond_init(&t->cond);
+	if (pt_thread_create(&t->thread, trace_worker, t) != 0) {
+		pt_cond_destroy(&t->cond);
+		pt_mutex_destroy(&t->lock);
+		pt_mutex_destroy(&t->drain_lock);
+		fclose(t->fp);
+		free(t->slots);
+		free(t);
+		return 0x4012;
+	}
+
+	*trace = t;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_trace_destroy(card_trace_t *trace)
+{
+	if (trace == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&trace->lock);
+	trace->stop = 1;
+	pt_cond_broadcast(&trace->cond);
+	pt_mutex_unlock(&trace->lock);
+	pt_thread_join(trace->thread);
+
+	trace_drain(trace);
+	fclose(trace->fp);
+	pt_cond_destroy(&trace->cond);
+	pt_mutex_destroy(&trace->lock);
+	pt_mutex_destroy(&trace->drain_lock);
+	free(trace->slots);
+	free(trace);
+	return CARD_NO_ERR;
+}
+
+card_err_t card_trace_flush(card_trace_t *trace)
+{
+	if (trace == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&trace->drain_lock);
+	trace_drain(trace);
+	pt_mutex_unlock(&trace->drain_lock);
+	return CARD_NO_ERR;
+}
+
+Uint32_t card_trace_dropped(card_trace_t *trace)
+{
+	return trace == NULL ? 0 : (Uint32_t)pt_atomic_load(&trace->dropped);
+}
+
+void card_trace_record(card_trace_t *trace, const card_obj_t *obj, Uint8_t cmd, Uint8_t dir, card_err_t err, const Uint8_t *data, Uint16_t len)
+{
+	trace_slot_t *slot;
+	unsigned long pos;
+	long diff;
+
+	if (trace == NULL || obj == NULL)
+		return;
+
+	pos = (unsigned long)pt_atomic_load(&trace->head);
+	for (;;) {
+		slot = &trace->slots[pos & trace->mask];
+		diff = (long)((unsigned long)pt_atomic_load(&slot->seq) - pos);
+		if (diff == 0) {
+			if (pt_atomic_cas(&trace->head, (long)pos, (long)(pos + 1)))
+				break;
+			pos = (unsigned long)pt_atomic_load(&trace->head);
+		} else if (diff < 0) {
+			/* 缓存已满 */
+			pt_atomic_add(&trace->dropped, 1);
+			return;
+		} else {
+			pos = (unsigned long)pt_atomic_load(&trace->head);
+		}
+	}
+
+	slot->time_us = pt_os_time_us();
+	slot->handle = obj->handle;
+	memcpy(slot->addr, obj->addr, MAX_ADDR_SIZE);
+	slot->cmd = cmd;
+	slot->dir = dir;
+	slot->err = err;
+	slot->len = data == NULL ? 0 : len;
+	slot->data_len = slot->len < CARD_TRACE_DATA_MAX ? slot->len : CARD_TRACE_DATA_MAX;
+	if (slot->data_len > 0)
+		memcpy(slot->data, data, slot->data_len);
+	pt_atomic_store(&slot->seq, (long)(pos + 1));
+}
+
+card_err_t card_trace_pipe(card_trace_t *trace, card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen)
+{
+	card_err_t ret;
+
+	card_trace_record(trace, obj, CARD_CMD_PIPE, CARD_TRACE_DIR_TX, CARD_NO_ERR, tbuf, tlen);
+	ret = card_pipe(obj, tbuf, tlen, rbuf, rlen);
+	card_trace_record(trace, obj, CARD_CMD_PIPE, CARD_TRACE_DIR_RX, ret, rbuf, ret == CARD_NO_ERR ? *rlen : 0);
+	return ret;
+}
+
+card_err_t card_trace_reset(card_trace_t *trace, card_obj_t *obj)
+{
+	card_err_t ret;
+
+	card_trace_record(trace, obj, CARD_CMD_RESET, CARD_TRACE_DIR_TX, CARD_NO_ERR, NULL, 0);
+	ret = card_reset(obj);
+	card_trace_record(trace, obj, CARD_CMD_RESET, CARD_TRACE_DIR_RX, ret, obj->atr, ret == CARD_NO_ERR ? obj->atr_len : 0);
+	return ret;
+}
+
+card_err_t card_trace_i2c_write_read(card_trace_t *trace, card_obj_t *obj, Uint16_t address, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen)
+{
+	card_err_t ret;
+
+	card_trace_record(trace, obj, CARD_CMD_I2C_WRITE_READ, CARD_TRACE_DIR_TX, CARD_NO_ERR, tbuf, tlen);
+	ret = card_i2c_write_read(obj, address, tbuf, tlen, rbuf, rlen);
+	card_trace_record(trace, obj, CARD_CMD_I2C_WRITE_READ, CARD_TRACE_DIR_RX, ret, rbuf, ret == CARD_NO_ERR ? *rlen : 0);
+	return ret;
+}
+
+card_err_t card_trace_spi_write_read(card_trace_t *trace, card_obj_t *obj, Uint8_t *tbuf, Uint16_t tlen, Uint8_t *rbuf, Uint16_t *rlen)
+{
+	card_err_t ret;
+
+	card_trace_record(trace, obj, CARD_CMD_SPI_WRITE_READ, CARD_TRACE_DIR_TX, CARD_NO_ERR, tbuf, tlen);
+	ret = card_spi_write_read(obj, tbuf, tlen, rbuf, rlen);
+	card_trace_record(trace, obj, CARD_CMD_SPI_WRITE_READ, CARD_TRACE_DIR_RX, ret, rbuf, ret == CARD_NO_ERR ? *rlen : 0);
+	return ret;
+}
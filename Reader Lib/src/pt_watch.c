@@ -0,0 +1,342 @@
+/**
+ * \file	pt_watch.c
+ * \brief	卡片插拔监视接口函数
+ * \details	读写器不主动上报卡片状态，监视器使用一个内部线程按间隔依次探测全部卡片对象，
+ *			状态变化时产生事件，放入事件队列并通过管道/事件通知调用线程，或直接回调。
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+#define STATE_UNKNOWN	0xFF
+
+typedef struct watch_entry {
+	card_obj_t *obj;
+	void *arg;
+	Uint8_t used;
+	Uint8_t paused;
+	Uint8_t reported;			/* 上次报告的CARD_WATCH_INSERT、CARD_WATCH_REMOVE，未报告为STATE_UNKNOWN */
+	card_err_t err;				/* 上次探测的通信错误 */
+	unsigned long long next_at;
+} watch_entry_t;
+
+struct card_watch {
+	Uint32_t interval_ms;
+	card_watch_cb_t cb;
+	void *cb_arg;
+	int stop;
+	int busy;					/* 正在探测的编号，-1为无 */
+	watch_entry_t entries[CARD_WATCH_MAX];
+	card_watch_evt_t *events;	/* 环形队列 */
+	Uint16_t head;
+	Uint16_t count;
+	pt_mutex_t lock;
+	pt_cond_t cond;				/* 添加、恢复、退出或探测结束 */
+	pt_notify_t notify;
+	pt_thread_t thread;
+};
+
+/* 探测卡片是否存在，返回CARD_WATCH_INSERT或CARD_WATCH_REMOVE，通信错误时返回STATE_UNKNOWN */
+static Uint8_t watch_probe(card_obj_t *obj, card_err_t *err)
+{
+	Uint8_t inv[3] = { 0x26, 0x01, 0x00 };
+	Uint8_t atqb[256], len, val = 0, *rbuf;
+	Uint16_t atqa, rlen;
+	Uint32_t timeout = obj->timeout;
+	card_err_t ret;
+
+	/* 探测期间使用短超时，一个无应答的读写器不长时间阻塞其他对象的探测 */
+	obj->timeout = CARD_WATCH_PROBE_TIMEOUT;
+	switch (obj->model) {
+	case MODEL_P14443A:
+	case MODEL_PMIFARE:
+		/* 唤醒后立即暂停，不改变卡片下次被选择的流程 */
+		ret = card_wupa(obj, &atqa);
+		if (ret == CARD_NO_ERR)
+			card_halta(obj);
+		val = ret == CARD_NO_ERR;
+		break;
+	case MODEL_P14443B:
+		ret = card_wupb(obj, atqb, &len);
+		if (ret == CARD_NO_ERR)
+			card_haltb(obj);
+		val = ret == CARD_NO_ERR;
+		break;
+	case MODEL_P15693:
+		/* 单时隙INVENTORY，不发送STAY QUIET，卡片保持就绪状态。碰撞说明至少有一张卡片 */
+		rbuf = (Uint8_t *)malloc(CARD_APDU_RESP_MAX);
+		if (rbuf == NULL) {
+			ret = 0x4012;
+			break;
+		}
+		rlen = 0;
+		ret = card_pipe(obj, inv, sizeof(inv), rbuf, &rlen);
+		free(rbuf);
+		val = ret == CARD_NO_ERR || ret == 0x2002 || ret == 0x2003;
+		break;
+	default:
+		ret = card_getdetect(obj, &val);
+		break;
+	}
+	obj->timeout = timeout;
+
+	*err = card_err_class(ret) == CARD_ERR_CLASS_LINK ? ret : CARD_NO_ERR;
+	if (*err != CARD_NO_ERR)
+		return STATE_UNKNOWN;
+	return val != 0 ? CARD_WATCH_INSERT : CARD_WATCH_REMOVE;
+}
+
+/* 调用者持有锁，队列满时丢弃最早的事件 */
+static void event_push(card_watch_t *w, Uint16_t id, Uint8_t event, card_err_t err)
+{
+	card_watch_evt_t *e;
+
+	if (w->count == CARD_WATCH_QUEUE) {
+		w->head = (Uint16_t)((w->head + 1) % CARD_WATCH_QUEUE);
+		w->count--;
+	}
+	e = &w->events[(w->head + w->count) % CARD_WATCH_QUEUE];
+	e->id = id;
+	e->obj = w->entries[id].obj;
+	e->arg = w->entries[id].arg;
+	e->event = event;
+	e->err = err;
+	w->count++;
+	pt_notify_set(&w->notify);
+}
+
+static void watch_worker(void *p)
+{
+	card_watch_t *w = (card_watch_t *)p;
+	watch_entry_t *e;
+	card_watch_evt_t evt;
+	unsigned long long now, next;
+	Uint8_t state;
+	card_err_t err;
+	int i, due;
+
+	pt_mutex_lock(&w->lock);
+	while (!w->stop) {
+		now = pt_os_time_us();
+		next = now + (unsigned long long)w->interval_ms * 1000ULL;
+		due = -1;
+		for (i = 0; i < CARD_WATCH_MAX; i++) {
+			e = &w->entries[i];
+			if (!e->used || e->paused)
+				continue;
+			if (e->next_at <= now && (due < 0 || e->next_at < w->entries[due].next_at))
+				due = i;
+			else if (e->next_at < next)
+				next = e->next_at;
+		}
+		if (due < 0) {
+			pt_cond_timedwait(&w->cond, &w->lock, (Uint32_t)((next - now + 999) / 1000));
+			continue;
+		}
+
+		e = &w->entries[due];
+		w->busy = due;
+		pt_mutex_unlock(&w->lock);
+		state = watch_probe(e->obj, &err);
+		pt_mutex_lock(&w->lock);
+		w->busy = -1;
+		pt_cond_broadcast(&w->cond);
+		e->next_at = pt_os_time_us() + (unsigned long long)w->interval_ms * 1000ULL;
+
+		/* 通信错误只报告一次，恢复后与上次报告的状态比较，错误期间拔出的卡片也报告拔出 */
+		evt.event = 0;
+		if (err != CARD_NO_ERR) {
+			if (e->err == CARD_NO_ERR)
+				evt.event = CARD_WATCH_ERROR;
+		} else if (state != e->reported && !(e->reported == STATE_UNKNOWN && state == CARD_WATCH_REMOVE)) {
+			evt.event = state;
+			e->reported = state;
+		}
+		e->err = err;
+		if (evt.event == 0)
+			continue;
+
+		if (w->cb == NULL) {
+			event_push(w, (Uint16_t)due, evt.event, err);
+			continue;
+		}
+		evt.id = (Uint16_t)due;
+		evt.obj = e->obj;
+		evt.arg = e->arg;
+		evt.err = err;
+		pt_mutex_unlock(&w->lock);
+		w->cb(w, &evt, w->cb_arg);
+		pt_mutex_lock(&w->lock);
+	}
+	pt_mutex_unlock(&w->lock);
+}
+
+card_err_t card_watch_create(card_watch_t **w, Uint32_t interval_ms, card_watch_cb_t cb, void *arg)
+{
+	card_watch_t *c;
+
+	if (w == NULL)
+		return 0x3007;
+	if (interval_ms == 0)
+		interval_ms = CARD_WATCH_DEFAULT_INTERVAL;
+
+	c = (card_watch_t *)calloc(1, sizeof(card_watch_t));
+	if (c == NULL)
+		return 0x4012;
+	c->events = (card_watch_evt_t *)calloc(CARD_WATCH_QUEUE, sizeof(card_watch_evt_t));
+	if (c->events == NULL || pt_notify_init(&c->notify) != 0) {
+		free(c->events);
+		free(c);
+		return 0x4012;
+	}
+	c->interval_ms = interval_ms;
+	c->cb = cb;
+	c->cb_arg = arg;
+	c->busy = -1;
+	pt_mutex_init(&c->lock);
+	pt_cond_init(&c->cond);
+	if (pt_thread_create(&c->thread, watch_worker, c) != 0) {
+		pt_cond_destroy(&c->cond);
+		pt_mutex_destroy(&c->lock);
+		pt_notify_destroy(&c->notify);
+		free(c->events);
+		free(c);
+		return 0x4012;
+	}
+
+	*w = c;
+	return CARD_NO_ERR;
+}
+
+card_err_t card_watch_destroy(card_watch_t *w)
+{
+	if (w == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&w->lock);
+	w->stop = 1;
+	pt_cond_broadcast(&w->cond);
+	pt_mutex_unlock(&w->lock);
+	pt_thread_join(w->thread);
+
+	pt_cond_destroy(&w->cond);
+	pt_mutex_destroy(&w->lock);
+	pt_notify_destroy(&w->notify);
+	free(w->events);
+	free(w);
+	return CARD_NO_ERR;
+}
+
+card_err_t card_watch_add(card_watch_t *w, card_obj_t *obj, void *arg, Uint16_t *id)
+{
+	watch_entry_t *e;
+	Uint16_t i;
+
+	if (w == NULL || obj == NULL)
+		return 0x3007;
+
+	pt_mutex_lock(&w->lock);
+	for (i = 0; i < CARD_WATCH_MAX; i++) {
+		if (!w->entries[i].used)
+			break;
+	}
+	if (i == CARD_WATCH_MAX) {
+		pt_mutex_unlock(&w->lock);
+		return CARD_ERR_POOL_FULL;
+	}
+	e = &w->entries[i];
+	memset(e, 0, sizeof(*e));
+	e->obj = obj;
+	e->arg = arg;
+	e->used = 1;
+	e->reported = STATE_UNKNOWN;
+	pt_cond_broadcast(&w->cond);
+	pt_mutex_unlock(&w->lock);
+
+	if (id != NULL)
+		*id = i;
+	return CARD_NO_ERR;
+}
+
+/* 等待该对象的探测结束，调用者持有锁 */
+static void wait_idle(card_watch_t *w, Uint16_t id)
+{
+	while (w->busy == (int)id)
+		pt_cond_wait(&w->cond, &w->lock);
+}
+
+card_err_t card_watch_pause(card_watch_t *w, Uint16_t id, Uint8_t pause)
+{
+	watch_entry_t *e;
+
+	if (w == NULL || id >= CARD_WATCH_MAX)
+		return 0x3007;
+
+	pt_mutex_lock(&w->lock);
+	e = &w->entries[id];
+	if (!e->used) {
+		pt_mutex_unlock(&w->lock);
+		return 0x3007;
+	}
+	wait_idle(w, id);
+	e->paused = pause != 0;
+	/* 恢复后立即探测，状态以恢复时为准 */
+	if (!e->paused) {
+		e->next_at = 0;
+		pt_cond_broadcast(&w->cond);
+	}
+	pt_mutex_unlock(&w->lock);
+	return CARD_NO_ERR;
+}
+
+card_err_t card_watch_remove(card_watch_t *w, Uint16_t id)
+{
+	if (w == NULL || id >= CARD_WATCH_MAX)
+		return 0x3007;
+
+	pt_mutex_lock(&w->lock);
+	if (!w->entries[id].used) {
+		pt_mutex_unlock(&w->lock);
+		return 0x3007;
+	}
+	wait_idle(w, id);
+	w->entries[id].used = 0;
+	pt_mutex_unlock(&w->lock);
+	return CARD_NO_ERR;
+}
+
+#ifdef WIN32
+void *card_watch_event(card_watch_t *w)
+{
+	return w == NULL ? NULL : (void *)w->notify;
+}
+#else
+int card_watch_fd(card_watch_t *w)
+{
+	return w == NULL ? -1 : w->notify.fds[0];
+}
+#endif
+
+card_err_t card_watch_poll(card_watch_t *w, card_watch_evt_t *evts, Uint16_t max, Uint16_t *count)
+{
+	Uint16_t n = 0;
+
+	if (w == NULL || (evts == NULL && max != 0))
+		return 0x3007;
+
+	pt_notify_clear(&w->notify);
+	pt_mutex_lock(&w->lock);
+	while (n < max && w->count > 0) {
+		evts[n++] = w->events[w->head];
+		w->head = (Uint16_t)((w->head + 1) % CARD_WATCH_QUEUE);
+		w->count--;
+	}
+	if (w->count > 0)
+		pt_notify_set(&w->notify);
+	pt_mutex_unlock(&w->lock);
+
+	if (count != NULL)
+		*count = n;
+	return CARD_NO_ERR;
+}
@@ -0,0 +1,593 @@
+/**
+ * \file	pt_sim_test.c
+ * \brief	模拟器功能测试
+ * \details	在本机地址启动card_sim_create模拟器，经驱动库检查扩展接口的卡片流程和参数错误，失败时返回非0。
+ * \code
+ *  pt_sim_test [地址]
+ * \endcode
+ */
+#include <stdio.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+#define TEST_ADDR			"127.0.0.71"
+#define TEST_WATCH_MS		20
+#define TEST_WAIT_MS		300
+#define TEST_VCC			3000
+#define TEST_JOBS			32
+
+static int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+#define CHECK_ERR(expr) do { \
+	card_err_t check_err_ = (expr); \
+	if (check_err_ != CARD_NO_ERR) { \
+		fprintf(stderr, "%s:%d: %s returned 0x%04X\n", __FILE__, __LINE__, #expr, (unsigned)check_err_); \
+		failures++; \
+	} \
+} while (0)
+
+/* 盘点后卡片静默，下次盘点仍能找到 */
+static void test_15693_inventory(card_sim_t *sim, Uint8_t *addr)
+{
+	card_obj_t obj;
+	card_tag_t tags[4], again[4];
+	Uint16_t n = 0, m = 0;
+
+	CHECK_ERR(card_sim_insert(sim, CARD_SIM_15693));
+	CHECK_ERR(card_open(&obj, MODEL_P15693, addr));
+	CHECK_ERR(card_inventory(&obj, 0, 0, tags, 4, &n));
+	CHECK(n == 1);
+	CHECK(n < 1 || (tags[0].uid_len == 8 && tags[0].uid[7] == 0xE0));
+	CHECK_ERR(card_inventory(&obj, 0, 0, again, 4, &m));
+	CHECK(m == n);
+	CHECK(m < 1 || memcmp(again[0].uid, tags[0].uid, 8) == 0);
+
+	CHECK_ERR(card_sim_insert(sim, CARD_SIM_NONE));
+	CHECK_ERR(card_inventory(&obj, 0, 0, tags, 4, &n));
+	CHECK(n == 0);
+	card_close(&obj);
+}
+
+/* 寻址写入多块后读回 */
+static void test_15693_blocks(card_sim_t *sim, Uint8_t *addr)
+{
+	card_obj_t obj;
+	card_tag_t tag;
+	Uint8_t wbuf[64], rbuf[64];
+	Uint32_t len = 0;
+	Uint16_t n = 0;
+	int i;
+
+	for (i = 0; i < (int)sizeof(wbuf); i++)
+		wbuf[i] = (Uint8_t)(i * 7 + 1);
+	CHECK_ERR(card_sim_insert(sim, CARD_SIM_15693));
+	CHECK_ERR(card_open(&obj, MODEL_P15693, addr));
+	CHECK_ERR(card_inventory(&obj, 0, 0, &tag, 1, &n));
+	CHECK(n == 1);
+	if (n == 1) {
+		CHECK_ERR(card_15693_write_blocks(&obj, tag.uid, 4, 16, 4, 0, wbuf, NULL, NULL, &len));
+		CHECK(len == sizeof(wbuf));
+		memset(rbuf, 0, sizeof(rbuf));
+		CHECK_ERR(card_15693_read_blocks(&obj, tag.uid, 4, 16, 4, 0, rbuf, NULL, NULL, &len));
+		CHECK(len == sizeof(rbuf));
+		CHECK(memcmp(rbuf, wbuf, sizeof(wbuf)) == 0);
+		/* 超出标签容量 */
+		CHECK(card_15693_read_blocks(&obj, tag.uid, 60, 8, 4, 0, rbuf, NULL, NULL, &len) == CARD_ERR_SW_UNEXPECTED);
+	}
+	card_close(&obj);
+}
+
+/* 探测不使卡片静默，卡片在场时只报告一次插入 */
+static void test_15693_watch(card_sim_t *sim, Uint8_t *addr)
+{
+	card_obj_t obj;
+	card_watch_t *w = NULL;
+	card_watch_evt_t evts[8];
+	Uint16_t id, n = 0, i, inserts = 0, removes = 0;
+
+	CHECK_ERR(card_sim_insert(sim, CARD_SIM_15693));
+	CHECK_ERR(card_open(&obj, MODEL_P15693, addr));
+	CHECK_ERR(card_watch_create(&w, TEST_WATCH_MS, NULL, NULL));
+	if (w == NULL) {
+		card_close(&obj);
+		return;
+	}
+	CHECK_ERR(card_watch_add(w, &obj, NULL, &id));
+	pt_sleep_ms(TEST_WAIT_MS);
+	CHECK_ERR(card_watch_poll(w, evts, 8, &n));
+	for (i = 0; i < n; i++) {
+		inserts = (Uint16_t)(inserts + (evts[i].event == CARD_WATCH_INSERT));
+		removes = (Uint16_t)(removes + (evts[i].event == CARD_WATCH_REMOVE));
+	}
+	CHECK(inserts == 1);
+	CHECK(removes == 0);
+
+	CHECK_ERR(card_sim_insert(sim, CARD_SIM_NONE));
+	pt_sleep_ms(TEST_WAIT_MS);
+	CHECK_ERR(card_watch_poll(w, evts, 8, &n));
+	CHECK(n == 1 && evts[0].event == CARD_WATCH_REMOVE);
+
+	card_watch_destroy(w);
+	card_close(&obj);
+}
+
+/* 打开接触卡片对象并复位 */
+static int open_icc(card_sim_t *sim, Uint8_t *addr, card_sim_card_t card, card_obj_t *obj)
+{
+	card_err_t ret;
+
+	CHECK_ERR(card_sim_insert(sim, card));
+	ret = card_open(obj, MODEL_P7816, addr);
+	if (ret == CARD_NO_ERR)
+		ret = card_reset(obj);
+	if (ret != CARD_NO_ERR) {
+		fprintf(stderr, "%s:%d: open 0x%04X\n", __FILE__, __LINE__, (unsigned)ret);
+		failures++;
+		card_close(obj);
+		return -1;
+	}
+	return 0;
+}
+
+/* 状态字不符合预期时默认停止，CARD_BATCH_FLAG_CONTINUE时继续执行 */
+static void test_pipe_batch(card_sim_t *sim, Uint8_t *addr)
+{
+	card_obj_t obj;
+	Uint8_t echo[] = { 0x00, 0xD6, 0x00, 0x00, 0x04, 0x11, 0x22, 0x33, 0x44, 0x04 };
+	Uint8_t getr[] = { 0x00, 0xC0, 0x00, 0x00, 0x04 };	/* T=1卡片返回6D00 */
+	Uint8_t r[3][16];
+	card_apdu_t cmds[3];
+	card_apdu_res_t res[3];
+	int i;
+
+	if (open_icc(sim, addr, CARD_SIM_7816_T1, &obj) != 0)
+		return;
+	for (i = 0; i < 3; i++) {
+		cmds[i].tbuf = i == 1 ? getr : echo;
+		cmds[i].tlen = (Uint16_t)(i == 1 ? sizeof(getr) : sizeof(echo));
+		cmds[i].sw_expect = 0x9000;
+		cmds[i].sw_mask = 0xFFFF;
+		res[i].rbuf = r[i];
+		res[i].rsize = sizeof(r[i]);
+	}
+
+	CHECK(card_pipe_batch(&obj, cmds, 3, res, CARD_BATCH_FLAG_NONE) == CARD_ERR_SW_UNEXPECTED);
+	CHECK(res[0].err == CARD_NO_ERR && res[0].rlen == 6 && memcmp(r[0], echo + 5, 4) == 0);
+	CHECK(res[1].err == CARD_ERR_SW_UNEXPECTED && res[1].sw1 == 0x6D && res[1].sw2 == 0x00);
+	CHECK(res[2].err == CARD_ERR_NOT_EXECUTED);
+
+	CHECK(card_pipe_batch(&obj, cmds, 3, res, CARD_BATCH_FLAG_CONTINUE) == CARD_ERR_SW_UNEXPECTED);
+	CHECK(res[1].err == CARD_ERR_SW_UNEXPECTED);
+	CHECK(res[2].err == CARD_NO_ERR && res[2].rlen == 6 && r[2][4] == 0x90);
+
+	CHECK_ERR(card_pipe_batch(&obj, cmds, 3, res, CARD_BATCH_FLAG_IGNORE_SW));
+	CHECK(card_pipe_batch(&obj, cmds, 0, res, CARD_BATCH_FLAG_NONE) == 0x3007);
+	CHECK(card_pipe_batch(&obj, NULL, 3, res, CARD_BATCH_FLAG_NONE) == 0x3007);
+	card_close(&obj);
+}
+
+/* T=0卡片的6CXX重发(含case 1)和61XX拼接 */
+static void test_pipe_chain(card_sim_t *sim, Uint8_t *addr)
+{
+	card_obj_t obj;
+	Uint8_t chal1[] = { 0x00, 0x84, 0x00, 0x00 };
+	Uint8_t chal2[] = { 0x00, 0x84, 0x00, 0x00, 0x04 };
+	Uint8_t echo[] = { 0x00, 0xD6, 0x00, 0x00, 0x04, 0x11, 0x22, 0x33, 0x44, 0x04 };
+	Uint8_t r[64];
+	Uint32_t rlen = 0;
+	card_xchg_stat_t st;
+
+	if (open_icc(sim, addr, CARD_SIM_7816_T0, &obj) != 0)
+		return;
+	CHECK_ERR(card_pipe_chain(&obj, chal1, sizeof(chal1), r, sizeof(r), &rlen, 0, &st));
+	CHECK(rlen == 10 && r[8] == 0x90 && r[9] == 0x00);
+	CHECK(st.count == 2 && st.rele == 1);
+	CHECK_ERR(card_pipe_chain(&obj, chal2, sizeof(chal2), r, sizeof(r), &rlen, 0, &st));
+	CHECK(rlen == 10 && st.rele == 1);
+
+	CHECK_ERR(card_pipe_chain(&obj, echo, sizeof(echo), r, sizeof(r), &rlen, 0, &st));
+	CHECK(rlen == 6 && memcmp(r, echo + 5, 4) == 0 && r[4] == 0x90);
+	CHECK(st.count == 2 && st.resp == 1);
+	CHECK(card_pipe_chain(&obj, echo, sizeof(echo), r, sizeof(r), &rlen, 1, NULL) == CARD_ERR_XCHG_LIMIT);
+	CHECK(rlen == 2 && r[0] == 0x61 && r[1] == 0x04);
+	CHECK(card_pipe_chain(&obj, echo, sizeof(echo), r, 4, &rlen, 0, NULL) == CARD_ERR_BUF_SMALL);
+	CHECK(rlen == 6);
+	card_close(&obj);
+}
+
+/* 分段读取写入分散缓存，模拟卡片每段返回从0递增的数据 */
+static void test_read_binary(card_sim_t *sim, Uint8_t *addr)
+{
+	static Uint8_t a[300], b[300];
+	card_obj_t obj;
+	card_iov_t iov[2];
+	Uint32_t rlen = 0, i;
+
+	if (open_icc(sim, addr, CARD_SIM_7816_T1, &obj) != 0)
+		return;
+	iov[0].buf = a;
+	iov[0].len = sizeof(a);
+	iov[1].buf = b;
+	iov[1].len = sizeof(b);
+	CHECK_ERR(card_read_binary(&obj, 0x00, 0, 600, 256, iov, 2, NULL, NULL, &rlen));
+	CHECK(rlen == 600);
+	for (i = 0; i < 600 && rlen == 600; i++) {
+		if ((i < 300 ? a[i] : b[i - 300]) != (Uint8_t)(i & 0xFF)) {
+			CHECK(!"read_binary data");
+			break;
+		}
+	}
+	CHECK(card_read_binary(&obj, 0x00, 0, 600, 256, NULL, 0, NULL, NULL, &rlen) == 0x3007);
+	CHECK(card_read_binary(&obj, 0x00, 0x1000000, 16, 0, iov, 2, NULL, NULL, &rlen) == 0x3007);
+	card_close(&obj);
+}
+
+/* 扇区写入后读回，密钥错误的扇区在CARD_BATCH_FLAG_CONTINUE时不影响其他扇区 */
+static void test_mifare_sectors(card_sim_t *sim, Uint8_t *addr)
+{
+	card_obj_t obj;
+	card_mifare_key_t keys[2];
+	card_err_t errs[2];
+	Uint8_t uid[10], sak, status, wbuf[128], rbuf[128];
+	Uint16_t atqa, uid_len = 0;
+	int i;
+
+	CHECK_ERR(card_sim_insert(sim, CARD_SIM_MIFARE));
+	CHECK_ERR(card_open(&obj, MODEL_PMIFARE, addr));
+	CHECK_ERR(card_reqa(&obj, &atqa));
+	CHECK_ERR(card_anticol(&obj, uid, &uid_len, &sak, &status));
+	CHECK_ERR(card_select(&obj, uid, uid_len, &sak));
+	CHECK(card_mifare_sectors_size(1, 2) == sizeof(wbuf));
+
+	keys[0].type = CARD_MIFARE_KEYA;
+	memset(keys[0].key, 0xFF, 6);
+	for (i = 0; i < (int)sizeof(wbuf); i++)
+		wbuf[i] = (Uint8_t)(i + 3);
+	CHECK_ERR(card_mifare_write_sectors(&obj, uid, keys, 1, 1, 2, wbuf, 0, errs));
+	memset(rbuf, 0, sizeof(rbuf));
+	CHECK_ERR(card_mifare_read_sectors(&obj, uid, keys, 1, 1, 2, rbuf, 0, errs));
+	CHECK(memcmp(rbuf, wbuf, 48) == 0 && memcmp(rbuf + 64, wbuf + 64, 48) == 0);
+	/* 尾块未写入，密钥A读出为0，存取控制位不变 */
+	CHECK(rbuf[48] == 0x00 && rbuf[54] == 0xFF && rbuf[55] == 0x07 && rbuf[56] == 0x80);
+
+	keys[1] = keys[0];
+	keys[0].key[0] = 0x00;
+	CHECK(card_mifare_read_sectors(&obj, uid, keys, 2, 1, 2, rbuf, 0, errs) == 0x2007);
+	CHECK(errs[0] == 0x2007 && errs[1] == CARD_ERR_NOT_EXECUTED);
+	/* 认证失败后卡片回到空闲状态，需重新唤醒 */
+	CHECK_ERR(card_wupa(&obj, &atqa));
+	CHECK_ERR(card_select(&obj, uid, uid_len, &sak));
+	CHECK(card_mifare_read_sectors(&obj, uid, keys, 2, 1, 2, rbuf, CARD_BATCH_FLAG_CONTINUE, errs) == 0x2007);
+	CHECK(errs[0] == 0x2007 && errs[1] == CARD_NO_ERR);
+	CHECK(memcmp(rbuf + 64, wbuf + 64, 48) == 0);
+
+	CHECK(card_mifare_read_sectors(&obj, uid, keys, 1, 1, 0, rbuf, 0, NULL) == 0x3007);
+	CHECK(card_mifare_read_sectors(&obj, uid, keys, 1, 39, 2, rbuf, 0, NULL) == 0x3007);
+	CHECK(card_mifare_read_sectors(&obj, uid, keys, 2, 1, 3, rbuf, 0, NULL) == 0x3007);
+	card_close(&obj);
+}
+
+/* 跨页写入并校验，读回数据和CRC32一致 */
+static void test_i2c_eeprom(card_sim_t *sim, Uint8_t *addr)
+{
+	card_obj_t obj;
+	card_i2c_prog_t p;
+	Uint8_t wbuf[200], rbuf[200];
+	Uint32_t wcrc = 0, rcrc = 0;
+	int i;
+
+	CHECK_ERR(card_sim_insert(sim, CARD_SIM_I2C_EEPROM));
+	CHECK_ERR(card_open(&obj, MODEL_PI2C, addr));
+	CHECK_ERR(card_i2c_on(&obj, TEST_VCC));
+	memset(&p, 0, sizeof(p));
+	p.dev = 0x50;
+	p.addr_bytes = 2;
+	p.page_size = 32;
+	p.addr = 100;
+	p.flags = CARD_I2C_FLAG_VERIFY;
+	for (i = 0; i < (int)sizeof(wbuf); i++)
+		wbuf[i] = (Uint8_t)(i * 5 + 7);
+	CHECK_ERR(card_i2c_eeprom_write(&obj, &p, wbuf, sizeof(wbuf), NULL, NULL, &wcrc));
+	memset(rbuf, 0, sizeof(rbuf));
+	CHECK_ERR(card_i2c_eeprom_read(&obj, &p, rbuf, sizeof(rbuf), NULL, NULL, &rcrc));
+	CHECK(memcmp(rbuf, wbuf, sizeof(wbuf)) == 0);
+	CHECK(wcrc == rcrc && rcrc == card_crc32(0, wbuf, sizeof(wbuf)));
+
+	CHECK(card_i2c_eeprom_read(&obj, &p, rbuf, 0, NULL, NULL, NULL) == 0x3007);
+	CHECK(card_i2c_eeprom_write(&obj, NULL, wbuf, sizeof(wbuf), NULL, NULL, NULL) == 0x3007);
+	p.page_size = 24;
+	CHECK(card_i2c_eeprom_write(&obj, &p, wbuf, sizeof(wbuf), NULL, NULL, NULL) == 0x3007);
+	p.page_size = 32;
+	p.addr = 0xFFF0;
+	CHECK(card_i2c_eeprom_read(&obj, &p, rbuf, 32, NULL, NULL, NULL) == 0x3007);
+	card_close(&obj);
+}
+
+/* 擦除编程跨扇区的映像，扇区内映像以外的数据被擦除 */
+static void test_spi_flash(card_sim_t *sim, Uint8_t *addr)
+{
+	static Uint8_t wbuf[5000], rbuf[5000];
+	card_obj_t obj;
+	card_spi_flash_t f, bad;
+	Uint32_t crc = 0, i;
+
+	CHECK_ERR(card_sim_insert(sim, CARD_SIM_SPI_FLASH));
+	CHECK_ERR(card_open(&obj, MODEL_PSPI, addr));
+	CHECK_ERR(card_spi_on(&obj, TEST_VCC));
+	memset(&f, 0, sizeof(f));
+	CHECK_ERR(card_spi_flash_probe(&obj, 0, &f));
+	CHECK(f.jedec[0] == 0xEF && f.jedec[1] == 0x40 && f.jedec[2] == 0x14 && f.size == 0x100000UL);
+	if (f.size == 0) {
+		card_close(&obj);
+		return;
+	}
+
+	for (i = 0; i < sizeof(wbuf); i++)
+		wbuf[i] = (Uint8_t)(i * 3 + 1);
+	CHECK_ERR(card_spi_flash_program(&obj, &f, 0x1100, wbuf, sizeof(wbuf), CARD_SPI_FLAG_ERASE | CARD_SPI_FLAG_VERIFY,
+		NULL, NULL, &crc));
+	CHECK(crc == card_crc32(0, wbuf, sizeof(wbuf)));
+	memset(rbuf, 0, sizeof(rbuf));
+	CHECK_ERR(card_spi_flash_read(&obj, &f, 0x1100, rbuf, sizeof(rbuf), NULL, NULL, NULL));
+	CHECK(memcmp(rbuf, wbuf, sizeof(wbuf)) == 0);
+	CHECK_ERR(card_spi_flash_read(&obj, &f, 0x1000, rbuf, 0x100, NULL, NULL, NULL));
+	CHECK(rbuf[0] == 0xFF && rbuf[0xFF] == 0xFF);
+
+	bad = f;
+	bad.sector_size = 0;
+	CHECK(card_spi_flash_erase(&obj, &bad, 0x1000, 0x100, NULL, NULL) == 0x3007);
+	bad.sector_size = 3000;
+	CHECK(card_spi_flash_erase(&obj, &bad, 0x1000, 0x100, NULL, NULL) == 0x3007);
+	bad = f;
+	bad.page_size = 0;
+	CHECK(card_spi_flash_program(&obj, &bad, 0, wbuf, 16, 0, NULL, NULL, NULL) == 0x3007);
+	CHECK(card_spi_flash_read(&obj, &f, f.size, rbuf, 16, NULL, NULL, NULL) == 0x3007);
+	CHECK(card_spi_flash_read(&obj, &f, f.size - 8, rbuf, 16, NULL, NULL, NULL) == 0x3007);
+	card_close(&obj);
+}
+
+/* 序列化后读回相同，缓存不足或格式错误时失败 */
+static void test_profile(void)
+{
+	card_profile_t p, q;
+	Uint8_t buf[CARD_PROFILE_SIZE + 8];
+	Uint32_t len = 0;
+
+	memset(&p, 0, sizeof(p));
+	strcpy(p.name, "sim-t1");
+	p.fields = CARD_PROFILE_MODEL | CARD_PROFILE_VCC | CARD_PROFILE_PPS;
+	p.model = MODEL_P7816;
+	p.vcc = 3000;
+	p.pps0 = 0x10;
+	p.pps1 = 0x96;
+	CHECK_ERR(card_profile_save(&p, buf, sizeof(buf), &len));
+	CHECK(len == CARD_PROFILE_SIZE);
+	CHECK_ERR(card_profile_load(&q, buf, len));
+	CHECK(strcmp(q.name, p.name) == 0 && q.fields == p.fields && q.model == p.model);
+	CHECK(q.vcc == p.vcc && q.pps0 == p.pps0 && q.pps1 == p.pps1);
+
+	CHECK(card_profile_save(&p, buf, CARD_PROFILE_SIZE - 1, &len) == CARD_ERR_BUF_SMALL);
+	CHECK(card_profile_load(&q, buf, CARD_PROFILE_SIZE - 1) == 0x3007);
+	buf[0] ^= 0xFF;
+	CHECK(card_profile_load(&q, buf, CARD_PROFILE_SIZE) == 0x3007);
+}
+
+/* 记录的命令次数和字节数出现在统计和导出文本中 */
+static void test_metrics(card_sim_t *sim, Uint8_t *addr)
+{
+	static Uint8_t text[8192];
+	card_obj_t obj;
+	card_metrics_t *m = NULL;
+	card_stats_t st;
+	Uint8_t echo[] = { 0x00, 0xD6, 0x00, 0x00, 0x04, 0x11, 0x22, 0x33, 0x44, 0x04 };
+	Uint8_t r[16];
+	Uint16_t rlen;
+	Uint32_t len = 0;
+	int i;
+
+	if (open_icc(sim, addr, CARD_SIM_7816_T1, &obj) != 0)
+		return;
+	CHECK_ERR(card_metrics_create(&m, 4));
+	if (m == NULL) {
+		card_close(&obj);
+		return;
+	}
+	for (i = 0; i < 3; i++) {
+		rlen = sizeof(r);
+		CHECK_ERR(card_metrics_pipe(m, &obj, echo, sizeof(echo), r, &rlen));
+	}
+	CHECK_ERR(card_get_stats(m, &obj, &st));
+	CHECK(st.cmds[CARD_CMD_PIPE].count == 3 && st.cmds[CARD_CMD_PIPE].errors == 0);
+	CHECK(st.tx_bytes == 3 * sizeof(echo) && st.rx_bytes == 3 * 6);
+
+	CHECK_ERR(card_metrics_export(m, CARD_METRICS_FMT_JSON, text, sizeof(text), &len));
+	CHECK(len == strlen((char *)text) && strstr((char *)text, "\"tx_bytes\":30") != NULL);
+	CHECK_ERR(card_metrics_export(m, CARD_METRICS_FMT_PROM, text, sizeof(text), &len));
+	CHECK(strstr((char *)text, "card_bytes_sent_total") != NULL);
+	CHECK(card_metrics_export(m, CARD_METRICS_FMT_PROM, text, 16, &len) == CARD_ERR_BUF_SMALL);
+
+	CHECK_ERR(card_metrics_remove(m, &obj));
+	CHECK(card_get_stats(m, &obj, &st) == 0x3007);
+	card_metrics_destroy(m);
+	card_close(&obj);
+}
+
+/* 同一地址的会话共用连接，连接用满时获取失败 */
+static void test_pool(card_sim_t *sim, Uint8_t *addr)
+{
+	card_pool_t *pool = NULL;
+	card_obj_t a, b, c;
+	Uint8_t echo[] = { 0x00, 0xD6, 0x00, 0x00, 0x04, 0x11, 0x22, 0x33, 0x44, 0x04 };
+	Uint8_t r[16];
+	Uint16_t rlen = sizeof(r);
+
+	CHECK_ERR(card_sim_insert(sim, CARD_SIM_7816_T1));
+	CHECK_ERR(card_pool_create(&pool, 1, 0));
+	if (pool == NULL)
+		return;
+	CHECK_ERR(card_pool_acquire(pool, addr, MODEL_P7816, &a));
+	CHECK_ERR(card_pool_acquire(pool, addr, MODEL_P7816, &b));
+	CHECK(a.handle == b.handle);
+	CHECK(card_pool_acquire(pool, (Uint8_t *)"127.0.0.254", MODEL_P7816, &c) == CARD_ERR_POOL_FULL);
+
+	CHECK_ERR(card_pool_lock(pool, &a));
+	CHECK_ERR(card_reset(&a));
+	CHECK_ERR(card_pipe(&a, echo, sizeof(echo), r, &rlen));
+	CHECK(rlen == 6 && memcmp(r, echo + 5, 4) == 0);
+	CHECK_ERR(card_pool_unlock(pool, &a));
+
+	CHECK_ERR(card_pool_release(pool, &a));
+	CHECK_ERR(card_pool_release(pool, &b));
+	CHECK(card_pool_release(pool, &b) == 0x4003);
+	CHECK(card_pool_acquire(pool, NULL, MODEL_P7816, &c) == 0x3007);
+	card_pool_destroy(pool);
+}
+
+static card_err_t station_job(card_obj_t *obj, void *arg)
+{
+	Uint8_t echo[] = { 0x00, 0xD6, 0x00, 0x00, 0x01, 0x00, 0x01 };
+	Uint8_t r[8];
+	Uint16_t rlen = sizeof(r);
+	card_err_t ret;
+
+	echo[5] = (Uint8_t)(size_t)arg;
+	ret = card_reset(obj);
+	if (ret == CARD_NO_ERR)
+		ret = card_pipe(obj, echo, sizeof(echo), r, &rlen);
+	if (ret == CARD_NO_ERR && (rlen != 3 || r[0] != echo[5]))
+		ret = 0x2006;
+	return ret;
+}
+
+static void station_done(card_station_t *st, card_req_t job, Uint16_t reader, card_err_t err, void *arg)
+{
+	(void)st;
+	(void)job;
+	(void)reader;
+	if (err == CARD_NO_ERR)
+		pt_atomic_add((volatile long *)arg, 1);
+}
+
+/* 提交到任意读写器的任务全部在唯一的读写器上完成 */
+static void test_station(card_sim_t *sim, Uint8_t *addr)
+{
+	card_station_t *st = NULL;
+	card_reader_stat_t rs;
+	volatile long ok = 0;
+	Uint16_t reader = 0xFFFF;
+	size_t i;
+
+	CHECK_ERR(card_sim_insert(sim, CARD_SIM_7816_T1));
+	CHECK_ERR(card_station_create(&st, MODEL_P7816, TEST_JOBS));
+	if (st == NULL)
+		return;
+	CHECK(card_station_submit(st, CARD_STATION_ANY, station_job, NULL, NULL, NULL, NULL) == 0x4003);
+	CHECK_ERR(card_station_add(st, addr, &reader));
+	CHECK(reader == 0);
+	for (i = 0; i < TEST_JOBS; i++)
+		CHECK_ERR(card_station_submit(st, CARD_STATION_ANY, station_job, (void *)i, station_done, (void *)&ok, NULL));
+	CHECK(card_station_submit(st, 5, station_job, NULL, NULL, NULL, NULL) == 0x3007);
+	CHECK(card_station_submit(st, 0, NULL, NULL, NULL, NULL, NULL) == 0x3007);
+	CHECK_ERR(card_station_wait(st, 10000));
+	CHECK(pt_atomic_load(&ok) == TEST_JOBS);
+	CHECK_ERR(card_station_stat(st, 0, &rs));
+	CHECK(rs.state == CARD_READER_ONLINE && rs.done == TEST_JOBS && rs.errors == 0);
+	card_station_destroy(st);
+}
+
+/* 默认只恢复不重试，CARD_RETRY_FLAG_REPLAY时按次数重试 */
+static void test_retry(card_sim_t *sim, Uint8_t *addr)
+{
+	card_obj_t obj;
+	card_retry_t *r = NULL;
+	card_retry_policy_t pol;
+	card_retry_stat_t st;
+	card_sim_cfg_t cfg;
+	Uint8_t echo[] = { 0x00, 0xD6, 0x00, 0x00, 0x04, 0x11, 0x22, 0x33, 0x44, 0x04 };
+	Uint8_t rbuf[16];
+	Uint16_t rlen;
+
+	if (open_icc(sim, addr, CARD_SIM_7816_T1, &obj) != 0)
+		return;
+	memset(&pol, 0, sizeof(pol));
+	pol.card_retries = 2;
+	pol.flags = CARD_RETRY_FLAG_RESET;
+	CHECK_ERR(card_retry_create(&r, &pol));
+	if (r == NULL) {
+		card_close(&obj);
+		return;
+	}
+	/* 每条接触卡片命令都返回0x1009 */
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.err_ppm = 1000000;
+	CHECK_ERR(card_sim_config(sim, &cfg));
+	rlen = sizeof(rbuf);
+	CHECK(card_retry_pipe(r, &obj, echo, sizeof(echo), rbuf, &rlen) == 0x1009);
+	CHECK_ERR(card_retry_stat(r, &st));
+	CHECK(st.calls == 1 && st.card_retries == 0 && st.resets == 1 && st.failed == 1);
+	card_retry_destroy(r);
+
+	pol.flags = CARD_RETRY_FLAG_RESET | CARD_RETRY_FLAG_REPLAY;
+	CHECK_ERR(card_retry_create(&r, &pol));
+	if (r == NULL) {
+		card_close(&obj);
+		return;
+	}
+	rlen = sizeof(rbuf);
+	CHECK(card_retry_pipe(r, &obj, echo, sizeof(echo), rbuf, &rlen) == 0x1009);
+	CHECK_ERR(card_retry_stat(r, &st));
+	CHECK(st.card_retries == 2 && st.failed == 1);
+
+	cfg.err_ppm = 0;
+	CHECK_ERR(card_sim_config(sim, &cfg));
+	CHECK_ERR(card_reset(&obj));
+	rlen = sizeof(rbuf);
+	CHECK_ERR(card_retry_pipe(r, &obj, echo, sizeof(echo), rbuf, &rlen));
+	CHECK(rlen == 6);
+	CHECK(card_retry_call(r, &obj, NULL, NULL) == 0x3007);
+	card_retry_destroy(r);
+	card_close(&obj);
+}
+
+int main(int argc, char *argv[])
+{
+	card_sim_t *sim = NULL;
+	Uint8_t *addr = (Uint8_t *)(argc > 1 ? argv[1] : TEST_ADDR);
+	card_err_t ret;
+
+	ret = card_sim_create(&sim, addr, NULL);
+	if (ret != CARD_NO_ERR) {
+		fprintf(stderr, "card_sim_create %s failed: 0x%04X\n", (char *)addr, (unsigned)ret);
+		return 1;
+	}
+	test_15693_inventory(sim, addr);
+	test_15693_blocks(sim, addr);
+	test_15693_watch(sim, addr);
+	test_pipe_batch(sim, addr);
+	test_pipe_chain(sim, addr);
+	test_read_binary(sim, addr);
+	test_mifare_sectors(sim, addr);
+	test_i2c_eeprom(sim, addr);
+	test_spi_flash(sim, addr);
+	test_profile();
+	test_metrics(sim, addr);
+	test_pool(sim, addr);
+	test_station(sim, addr);
+	test_retry(sim, addr);
+	card_sim_destroy(sim);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * \file	pt_stress_test.c
+ * \brief	多线程并发测试
+ * \details	N个线程各自用card_open_mt同时打开一个卡片对象，连接同一个card_sim_create模拟器，
+ *			反复复位并交换带线程编号和序号的回显APDU，应答必须是本线程发送的数据。
+ * \code
+ *  pt_stress_test [线程数] [次数] [地址]
+ * \endcode
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pt_card_ext.h"
+#include "pt_os.h"
+
+#define TEST_ADDR			"127.0.0.72"
+#define TEST_THREADS		8
+#define TEST_ITERS			200
+#define TEST_DATA_LEN		32
+
+typedef struct worker {
+	Uint8_t *addr;
+	int id;
+	int iters;
+	int failures;
+	card_err_t err;				/* 第一个错误 */
+	pt_thread_t thread;
+} worker_t;
+
+static void worker_fail(worker_t *w, card_err_t err, const char *what, int iter)
+{
+	if (w->failures++ == 0) {
+		w->err = err;
+		fprintf(stderr, "thread %d iteration %d: %s 0x%04X\n", w->id, iter, what, (unsigned)err);
+	}
+}
+
+static void worker_run(void *p)
+{
+	worker_t *w = (worker_t *)p;
+	card_obj_t obj;
+	Uint8_t t[5 + TEST_DATA_LEN + 1], r[TEST_DATA_LEN + 2];
+	Uint16_t rlen;
+	card_err_t ret;
+	int i, j;
+
+	ret = card_open_mt(&obj, MODEL_P7816, w->addr);
+	if (ret != CARD_NO_ERR) {
+		worker_fail(w, ret, "card_open_mt", -1);
+		return;
+	}
+	for (i = 0; i < w->iters; i++) {
+		/* 其他线程的复位不影响本对象的应答 */
+		if ((i % 16) == 0) {
+			ret = card_reset(&obj);
+			if (ret != CARD_NO_ERR) {
+				worker_fail(w, ret, "card_reset", i);
+				continue;
+			}
+		}
+		/* 00 D6 线程编号 序号 Lc 数据 Le，模拟卡片回显数据 */
+		t[0] = 0x00;
+		t[1] = 0xD6;
+		t[2] = (Uint8_t)w->id;
+		t[3] = (Uint8_t)i;
+		t[4] = TEST_DATA_LEN;
+		for (j = 0; j < TEST_DATA_LEN; j++)
+			t[5 + j] = (Uint8_t)(w->id * 31 + i * 7 + j);
+		t[5 + TEST_DATA_LEN] = TEST_DATA_LEN;
+		rlen = 0;
+		ret = card_pipe(&obj, t, sizeof(t), r, &rlen);
+		if (ret != CARD_NO_ERR) {
+			worker_fail(w, ret, "card_pipe", i);
+			continue;
+		}
+		if (rlen != TEST_DATA_LEN + 2 || memcmp(r, t + 5, TEST_DATA_LEN) != 0
+			|| r[TEST_DATA_LEN] != 0x90 || r[TEST_DATA_LEN + 1] != 0x00)
+			worker_fail(w, 0x2006, "card_pipe reply mismatch", i);
+	}
+	card_close(&obj);
+}
+
+int main(int argc, char *argv[])
+{
+	card_sim_t *sim = NULL;
+	worker_t workers[CARD_SIM_MAX_CONNS];
+	int threads = argc > 1 ? atoi(argv[1]) : TEST_THREADS;
+	int iters = argc > 2 ? atoi(argv[2]) : TEST_ITERS;
+	Uint8_t *addr = (Uint8_t *)(argc > 3 ? argv[3] : TEST_ADDR);
+	int i, started = 0, failures = 0;
+	card_err_t ret;
+
+	if (threads < 1 || threads > CARD_SIM_MAX_CONNS || iters < 1) {
+		fprintf(stderr, "usage: %s [threads 1-%d] [iterations] [addr]\n", argv[0], CARD_SIM_MAX_CONNS);
+		return 2;
+	}
+	ret = card_sim_create(&sim, addr, NULL);
+	if (ret == CARD_NO_ERR)
+		ret = card_sim_insert(sim, CARD_SIM_7816_T1);
+	if (ret != CARD_NO_ERR) {
+		fprintf(stderr, "card_sim %s failed: 0x%04X\n", (char *)addr, (unsigned)ret);
+		if (sim != NULL)
+			card_sim_destroy(sim);
+		return 1;
+	}
+
+	memset(workers, 0, sizeof(workers));
+	for (i = 0; i < threads; i++) {
+		workers[i].addr = addr;
+		workers[i].id = i;
+		workers[i].iters = iters;
+		if (pt_thread_create(&workers[i].thread, worker_run, &workers[i]) != 0) {
+			fprintf(stderr, "thread %d: create failed\n", i);
+			failures++;
+			break;
+		}
+		started++;
+	}
+	for (i = 0; i < started; i++) {
+		pt_thread_join(workers[i].thread);
+		failures += workers[i].failures;
+	}
+	card_sim_destroy(sim);
+
+	if (failures != 0) {
+		fprintf(stderr, "%d failure(s)\n", failures);
+		return 1;
+	}
+	printf("ok: %d threads x %d iterations\n", threads, iters);
+	return 0;
+}
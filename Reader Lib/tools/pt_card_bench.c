@@ -0,0 +1,631 @@
+/**
+ * \file	pt_card_bench.c
+ * \brief	读写器命令性能测试工具
+ * \details	测量各接口函数的延时(p50/p99/p999)和每秒命令数，结果输出为JSON，用于比较不同版本驱动库和读写器固件。
+ *			读写器个数从1按2的幂增加到N，每个读写器一个线程同时执行。
+ *			使用-S时在各地址启动card_sim_create模拟器，并按测试项放入对应卡片。
+ * \code
+ *  pt_card_bench [-a 地址[,地址...]] [-n 读写器个数] [-t 测试项[,测试项...]] [-z APDU长度[,长度...]]
+ *                [-i 次数] [-w 预热次数] [-L 标签] [-o 输出文件] [-S] [-l 模拟延时us]
+ * \endcode
+ *
+ * -------------------------------------------------------------------------
+ *    测试项        |        每次操作
+ * -----------------|-------------------------------------------------------
+ *	  pipe         |	card_pipe，按-z长度发送APDU，超过261字节使用扩展长度
+ *	  reset        |	card_reset
+ *	  activate     |	card_reqa + card_anticol + card_select
+ *	  mifare_read  |	card_mifare_read 块4，预先验证密钥全FF
+ *	  mifare_write |	card_mifare_write 块4，会修改卡片数据
+ *	  i2c          |	card_i2c_write_read 设备0x50，从地址0读32字节
+ *	  spi          |	card_spi_write_read 读命令03，从地址0读256字节
+ *	  swd          |	card_swd_dap_read DPIDR，模拟器不支持，-S时跳过
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#include "pt_card_ext.h"
+
+#define BENCH_MAX_READERS	64
+#define BENCH_MAX_SIZES		32
+#define BENCH_BUF_SIZE		0x10002
+#define BENCH_VCC			3000
+
+typedef struct bench_ctx bench_ctx_t;
+
+typedef struct bench_test {
+	const char *name;
+	card_mod_t model;
+	card_sim_card_t sim_card;
+	Uint16_t size;					/* 每次操作的数据长度，pipe为APDU长度 */
+	card_err_t (*setup)(bench_ctx_t *ctx);
+	card_err_t (*op)(bench_ctx_t *ctx);
+} bench_test_t;
+
+struct bench_ctx {
+	card_obj_t obj;
+	const bench_test_t *test;
+	Uint8_t uid[10];
+	Uint16_t uid_len;
+	Uint8_t *tbuf;
+	Uint16_t tlen;
+	Uint8_t *rbuf;
+	Uint32_t *lat;
+	unsigned long iters;
+	unsigned long warmup;
+	unsigned long ok;
+	unsigned long err;
+	card_err_t last_err;
+	unsigned long long start_us;
+	unsigned long long end_us;
+	int started;					/* 线程已启动 */
+#ifdef _WIN32
+	HANDLE thread;
+#else
+	pthread_t thread;
+#endif
+};
+
+typedef struct bench_result {
+	unsigned long ok;
+	unsigned long err;
+	card_err_t last_err;
+	double seconds;
+	double mean_us;
+	Uint32_t min_us;
+	Uint32_t p50_us;
+	Uint32_t p99_us;
+	Uint32_t p999_us;
+	Uint32_t max_us;
+} bench_result_t;
+
+static unsigned long long bench_time_us(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, cnt;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&cnt);
+	return (unsigned long long)(cnt.QuadPart / freq.QuadPart) * 1000000ULL
+		+ (unsigned long long)(cnt.QuadPart % freq.QuadPart) * 1000000ULL / (unsigned long long)freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL;
+#endif
+}
+
+/*---------------------------------------------------------
+			测试项
+ ---------------------------------------------------------*/
+static card_err_t setup_reset(bench_ctx_t *ctx)
+{
+	return card_reset(&ctx->obj);
+}
+
+/* 按长度生成APDU: 4字节以下只有命令头，5字节为情况2(Le=256)，6~260字节为情况3，
+   261字节为情况4，更长为扩展长度情况3 */
+static card_err_t setup_pipe(bench_ctx_t *ctx)
+{
+	Uint32_t size = ctx->test->size, lc, i;
+
+	ctx->tbuf[0] = 0x00;
+	ctx->tbuf[1] = 0xD6;
+	ctx->tbuf[2] = 0x00;
+	ctx->tbuf[3] = 0x00;
+	if (size == 261) {
+		ctx->tbuf[4] = 0xFF;
+		for (i = 5; i < 260; i++)
+			ctx->tbuf[i] = (Uint8_t)i;
+		ctx->tbuf[260] = 0x00;
+	} else if (size > 261) {
+		lc = size - 7;
+		ctx->tbuf[4] = 0x00;
+		ctx->tbuf[5] = (Uint8_t)(lc >> 8);
+		ctx->tbuf[6] = (Uint8_t)lc;
+		for (i = 7; i < size; i++)
+			ctx->tbuf[i] = (Uint8_t)i;
+	} else if (size >= 5) {
+		ctx->tbuf[4] = (Uint8_t)(size - 5);
+		for (i = 5; i < size; i++)
+			ctx->tbuf[i] = (Uint8_t)i;
+	}
+	ctx->tlen = (Uint16_t)size;
+	return card_reset(&ctx->obj);
+}
+
+static card_err_t op_pipe(bench_ctx_t *ctx)
+{
+	Uint16_t rlen = 0xFFFF;
+
+	return card_pipe(&ctx->obj, ctx->tbuf, ctx->tlen, ctx->rbuf, &rlen);
+}
+
+static card_err_t op_activate(bench_ctx_t *ctx)
+{
+	Uint16_t atqa;
+	Uint8_t sak, status;
+	card_err_t ret;
+
+	ret = card_reqa(&ctx->obj, &atqa);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	ret = card_anticol(&ctx->obj, ctx->uid, &ctx->uid_len, &sak, &status);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	return card_select(&ctx->obj, ctx->uid, ctx->uid_len, &sak);
+}
+
+static card_err_t setup_mifare(bench_ctx_t *ctx)
+{
+	Uint8_t key[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+	card_err_t ret;
+
+	ret = op_activate(ctx);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	return card_authenticate(&ctx->obj, 4, CARD_MIFARE_KEYA, key, ctx->uid);
+}
+
+static card_err_t op_mifare_read(bench_ctx_t *ctx)
+{
+	return card_mifare_read(&ctx->obj, 4, ctx->rbuf);
+}
+
+static card_err_t op_mifare_write(bench_ctx_t *ctx)
+{
+	return card_mifare_write(&ctx->obj, 4, ctx->tbuf);
+}
+
+static card_err_t setup_i2c(bench_ctx_t *ctx)
+{
+	return card_i2c_on(&ctx->obj, BENCH_VCC);
+}
+
+static card_err_t op_i2c(bench_ctx_t *ctx)
+{
+	Uint8_t addr[2] = { 0x00, 0x00 };
+	Uint16_t rlen = ctx->test->size;
+
+	return card_i2c_write_read(&ctx->obj, 0x50, addr, sizeof(addr), ctx->rbuf, &rlen);
+}
+
+static card_err_t setup_spi(bench_ctx_t *ctx)
+{
+	return card_spi_on(&ctx->obj, BENCH_VCC);
+}
+
+static card_err_t op_spi(bench_ctx_t *ctx)
+{
+	Uint8_t cmd[4] = { 0x03, 0x00, 0x00, 0x00 };
+	Uint16_t rlen = ctx->test->size;
+
+	return card_spi_write_read(&ctx->obj, cmd, sizeof(cmd), ctx->rbuf, &rlen);
+}
+
+static card_err_t setup_swd(bench_ctx_t *ctx)
+{
+	card_err_t ret;
+
+	ret = card_swd_on(&ctx->obj, BENCH_VCC);
+	if (ret != CARD_NO_ERR)
+		return ret;
+	return card_swd_connect(&ctx->obj);
+}
+
+static card_err_t op_swd(bench_ctx_t *ctx)
+{
+	Uint32_t val;
+
+	return card_swd_dap_read(&ctx->obj, 0x00, &val);
+}
+
+static const bench_test_t bench_tests[] = {
+	{ "pipe", MODEL_P7816, CARD_SIM_7816_T1, 0, setup_pipe, op_pipe },
+	{ "reset", MODEL_P7816, CARD_SIM_7816_T1, 0, NULL, setup_reset },
+	{ "activate", MODEL_P14443A, CARD_SIM_14443_4, 0, NULL, op_activate },
+	{ "mifare_read", MODEL_PMIFARE, CARD_SIM_MIFARE, 16, setup_mifare, op_mifare_read },
+	{ "mifare_write", MODEL_PMIFARE, CARD_SIM_MIFARE, 16, setup_mifare, op_mifare_write },
+	{ "i2c", MODEL_PI2C, CARD_SIM_I2C_EEPROM, 32, setup_i2c, op_i2c },
+	{ "spi", MODEL_PSPI, CARD_SIM_SPI_FLASH, 256, setup_spi, op_spi },
+	{ "swd", MODEL_PSWD, CARD_SIM_NONE, 4, setup_swd, op_swd },
+};
+#define BENCH_TEST_COUNT	((int)(sizeof(bench_tests) / sizeof(bench_tests[0])))
+
+/*---------------------------------------------------------
+			执行
+ ---------------------------------------------------------*/
+static void bench_run(bench_ctx_t *ctx)
+{
+	unsigned long i;
+	unsigned long long t;
+	card_err_t ret;
+
+	for (i = 0; i < ctx->warmup; i++)
+		ctx->test->op(ctx);
+
+	ctx->start_us = bench_time_us();
+	for (i = 0; i < ctx->iters; i++) {
+		t = bench_time_us();
+		ret = ctx->test->op(ctx);
+		if (ret == CARD_NO_ERR) {
+			ctx->lat[ctx->ok++] = (Uint32_t)(bench_time_us() - t);
+			continue;
+		}
+		ctx->err++;
+		ctx->last_err = ret;
+		/* 出错后卡片状态未知，重新准备(不计时) */
+		if (ctx->test->setup != NULL) {
+			t = bench_time_us();
+			ctx->test->setup(ctx);
+			ctx->start_us += bench_time_us() - t;
+		}
+	}
+	ctx->end_us = bench_time_us();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI bench_entry(LPVOID p)
+{
+	bench_run((bench_ctx_t *)p);
+	return 0;
+}
+#else
+static void *bench_entry(void *p)
+{
+	bench_run((bench_ctx_t *)p);
+	return NULL;
+}
+#endif
+
+static int cmp_u32(const void *a, const void *b)
+{
+	Uint32_t x = *(const Uint32_t *)a, y = *(const Uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* 最近秩百分位 */
+static Uint32_t percentile(const Uint32_t *v, unsigned long n, double p)
+{
+	unsigned long k = (unsigned long)(p * (double)n + 0.999999);
+
+	if (k == 0)
+		k = 1;
+	return v[(k > n ? n : k) - 1];
+}
+
+static int bench_measure(bench_ctx_t *ctxs, int readers, char addrs[][MAX_ADDR_SIZE], const bench_test_t *test,
+	unsigned long iters, unsigned long warmup, bench_result_t *res)
+{
+	unsigned long long first = 0, last = 0;
+	unsigned long n = 0, i;
+	Uint32_t *all;
+	double sum = 0;
+	card_err_t ret;
+	int r, opened = 0, rc = 0;
+
+	memset(res, 0, sizeof(*res));
+	for (r = 0; r < readers; r++) {
+		bench_ctx_t *ctx = &ctxs[r];
+
+		ctx->test = test;
+		ctx->iters = iters;
+		ctx->warmup = warmup;
+		ctx->ok = 0;
+		ctx->err = 0;
+		ctx->last_err = CARD_NO_ERR;
+		ctx->uid_len = 0;
+		memset(ctx->tbuf, 0x5A, 16);
+		ret = card_open(&ctx->obj, test->model, (Uint8_t *)addrs[r]);
+		if (ret == CARD_NO_ERR) {
+			opened++;
+			if (test->setup != NULL)
+				ret = test->setup(ctx);
+		}
+		if (ret != CARD_NO_ERR) {
+			fprintf(stderr, "%s: %s setup failed, ErrCode=%04X\n", addrs[r], test->name, ret);
+			res->last_err = ret;
+			rc = -1;
+			goto out;
+		}
+	}
+
+	for (r = 0; r < readers; r++) {
+#ifdef _WIN32
+		ctxs[r].thread = CreateThread(NULL, 0, bench_entry, &ctxs[r], 0, NULL);
+		ctxs[r].started = ctxs[r].thread != NULL;
+#else
+		ctxs[r].started = pthread_create(&ctxs[r].thread, NULL, bench_entry, &ctxs[r]) == 0;
+#endif
+		if (!ctxs[r].started) {
+			fprintf(stderr, "%s: %s thread create failed\n", addrs[r], test->name);
+			rc = -1;
+		}
+	}
+	for (r = 0; r < readers; r++) {
+		if (!ctxs[r].started)
+			continue;
+#ifdef _WIN32
+		WaitForSingleObject(ctxs[r].thread, INFINITE);
+		CloseHandle(ctxs[r].thread);
+#else
+		pthread_join(ctxs[r].thread, NULL);
+#endif
+	}
+
+	all = (Uint32_t *)malloc((iters * readers + 1) * sizeof(Uint32_t));
+	if (all == NULL) {
+		rc = -1;
+		goto out;
+	}
+	for (r = 0; r < readers; r++) {
+		if (!ctxs[r].started)
+			continue;
+		memcpy(all + n, ctxs[r].lat, ctxs[r].ok * sizeof(Uint32_t));
+		n += ctxs[r].ok;
+		res->err += ctxs[r].err;
+		if (ctxs[r].err > 0)
+			res->last_err = ctxs[r].last_err;
+		if (first == 0 || ctxs[r].start_us < first)
+			first = ctxs[r].start_us;
+		if (ctxs[r].end_us > last)
+			last = ctxs[r].end_us;
+	}
+	res->ok = n;
+	res->seconds = (double)(last - first) / 1e6;
+	if (n > 0) {
+		qsort(all, n, sizeof(Uint32_t), cmp_u32);
+		for (i = 0; i < n; i++)
+			sum += all[i];
+		res->mean_us = sum / (double)n;
+		res->min_us = all[0];
+		res->p50_us = percentile(all, n, 0.50);
+		res->p99_us = percentile(all, n, 0.99);
+		res->p999_us = percentile(all, n, 0.999);
+		res->max_us = all[n - 1];
+	}
+	free(all);
+
+out:
+	for (r = 0; r < opened; r++)
+		card_close(&ctxs[r].obj);
+	return rc;
+}
+
+/* 输出JSON字符串，转义引号、反斜杠、控制字符和非ASCII字节 */
+static void json_string(FILE *out, const char *s)
+{
+	const unsigned char *p;
+
+	fputc('"', out);
+	for (p = (const unsigned char *)s; *p != '\0'; p++) {
+		if (*p == '"' || *p == '\\')
+			fprintf(out, "\\%c", *p);
+		else if (*p < 0x20 || *p >= 0x7F)
+			fprintf(out, "\\u%04x", *p);
+		else
+			fputc(*p, out);
+	}
+	fputc('"', out);
+}
+
+/*---------------------------------------------------------
+			参数
+ ---------------------------------------------------------*/
+/* 地址不足时按最后一个地址递增末段，如127.0.0.1 -> 127.0.0.2 */
+static int make_addrs(const char *list, int n, char addrs[][MAX_ADDR_SIZE])
+{
+	char buf[256], *p, *tok;
+	unsigned a, b, c, d;
+	int cnt = 0;
+
+	strncpy(buf, list, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = '\0';
+	for (p = buf; cnt < BENCH_MAX_READERS && (tok = strtok(p, ",")) != NULL; p = NULL) {
+		strncpy(addrs[cnt], tok, MAX_ADDR_SIZE - 1);
+		addrs[cnt][MAX_ADDR_SIZE - 1] = '\0';
+		cnt++;
+	}
+	if (cnt == 0)
+		return -1;
+	if (sscanf(addrs[cnt - 1], "%u.%u.%u.%u", &a, &b, &c, &d) != 4)
+		return cnt >= n ? 0 : -1;
+	while (cnt < n) {
+		d++;
+		if (d > 254)
+			return -1;
+		sprintf(addrs[cnt++], "%u.%u.%u.%u", a, b, c, d);
+	}
+	return 0;
+}
+
+static int parse_sizes(const char *list, Uint16_t *sizes)
+{
+	const char *p = list;
+	char *end;
+	unsigned long v;
+	int n = 0;
+
+	while (*p != '\0' && n < BENCH_MAX_SIZES) {
+		v = strtoul(p, &end, 0);
+		if (end == p || v == 0 || v > 0xFFFF)
+			return -1;
+		sizes[n++] = (Uint16_t)v;
+		p = *end == ',' ? end + 1 : end;
+		if (*end != ',' && *end != '\0')
+			return -1;
+	}
+	return n;
+}
+
+static int test_selected(const char *list, const char *name)
+{
+	size_t len = strlen(name);
+	const char *p = list;
+
+	if (list == NULL)
+		return 1;
+	while ((p = strstr(p, name)) != NULL) {
+		if ((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+			return 1;
+		p += len;
+	}
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-a addr[,addr...]] [-n readers] [-t test[,test...]] [-z size[,size...]]\n"
+		"       [-i iterations] [-w warmup] [-L label] [-o output.json] [-S] [-l sim_latency_us]\n"
+		"tests: pipe reset activate mifare_read mifare_write i2c spi swd\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	static char addrs[BENCH_MAX_READERS][MAX_ADDR_SIZE];
+	static bench_ctx_t ctxs[BENCH_MAX_READERS];
+	static card_sim_t *sims[BENCH_MAX_READERS];
+	const char *addr_list = "127.0.0.1", *tests = NULL, *label = "", *out_path = NULL;
+	Uint16_t sizes[BENCH_MAX_SIZES] = { 4, 5, 16, 64, 128, 261, 512, 4096 };
+	int size_count = 8, max_readers = 1, simulate = 0, first = 1;
+	unsigned long iters = 1000, warmup = 50;
+	card_sim_cfg_t sim_cfg;
+	bench_test_t test;
+	bench_result_t res;
+	char info[64 + 1];
+	FILE *out = stdout;
+	int i, t, s, readers, rc = 0;
+
+	memset(&sim_cfg, 0, sizeof(sim_cfg));
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-S") == 0) {
+			simulate = 1;
+			continue;
+		}
+		if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' || i + 1 >= argc) {
+			usage(argv[0]);
+			return 1;
+		}
+		i++;
+		switch (argv[i - 1][1]) {
+		case 'a': addr_list = argv[i]; break;
+		case 'n': max_readers = atoi(argv[i]); break;
+		case 't': tests = argv[i]; break;
+		case 'z':
+			size_count = parse_sizes(argv[i], sizes);
+			if (size_count <= 0) {
+				fprintf(stderr, "bad size list %s\n", argv[i]);
+				return 1;
+			}
+			break;
+		case 'i': iters = strtoul(argv[i], NULL, 0); break;
+		case 'w': warmup = strtoul(argv[i], NULL, 0); break;
+		case 'L': label = argv[i]; break;
+		case 'o': out_path = argv[i]; break;
+		case 'l': sim_cfg.latency_us = (Uint32_t)strtoul(argv[i], NULL, 0); break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (max_readers < 1 || max_readers > BENCH_MAX_READERS || iters == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (make_addrs(addr_list, max_readers, addrs) != 0) {
+		fprintf(stderr, "need %d reader addresses\n", max_readers);
+		return 1;
+	}
+
+	for (i = 0; i < max_readers; i++) {
+		ctxs[i].tbuf = (Uint8_t *)malloc(BENCH_BUF_SIZE);
+		ctxs[i].rbuf = (Uint8_t *)malloc(BENCH_BUF_SIZE);
+		ctxs[i].lat = (Uint32_t *)malloc(iters * sizeof(Uint32_t));
+		if (ctxs[i].tbuf == NULL || ctxs[i].rbuf == NULL || ctxs[i].lat == NULL) {
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+		if (simulate && card_sim_create(&sims[i], (Uint8_t *)addrs[i], &sim_cfg) != CARD_NO_ERR) {
+			fprintf(stderr, "start simulator on %s failed\n", addrs[i]);
+			return 1;
+		}
+	}
+
+	/* 记录读写器版本，用于区分测试环境 */
+	memset(info, 0, sizeof(info));
+	if (card_open(&ctxs[0].obj, MODEL_NULL, (Uint8_t *)addrs[0]) == CARD_NO_ERR) {
+		card_getinfo(&ctxs[0].obj, (Uint8_t *)info);
+		card_close(&ctxs[0].obj);
+	}
+
+	if (out_path != NULL) {
+		out = fopen(out_path, "w");
+		if (out == NULL) {
+			fprintf(stderr, "open %s failed\n", out_path);
+			return 1;
+		}
+	}
+	fprintf(out, "{\n  \"label\": ");
+	json_string(out, label);
+	fprintf(out, ",\n  \"reader\": ");
+	json_string(out, info);
+	fprintf(out, ",\n  \"time\": %lu,\n  \"iterations\": %lu,\n  \"warmup\": %lu,\n  \"simulated\": %s,\n  \"results\": [",
+		(unsigned long)time(NULL), iters, warmup, simulate ? "true" : "false");
+	fprintf(stderr, "%-13s %6s %4s %9s %7s %8s %8s %8s %8s\n",
+		"test", "size", "rdr", "ops/s", "errors", "p50us", "p99us", "p999us", "maxus");
+
+	for (t = 0; t < BENCH_TEST_COUNT; t++) {
+		if (!test_selected(tests, bench_tests[t].name))
+			continue;
+		/* 模拟器没有对应的卡片 */
+		if (simulate && bench_tests[t].sim_card == CARD_SIM_NONE) {
+			fprintf(stderr, "%-13s skipped: not supported by the simulator\n", bench_tests[t].name);
+			continue;
+		}
+		for (s = 0; s < (bench_tests[t].op == op_pipe ? size_count : 1); s++) {
+			test = bench_tests[t];
+			if (test.op == op_pipe)
+				test.size = sizes[s];
+			for (readers = 1; ; readers = readers * 2 < max_readers ? readers * 2 : max_readers) {
+				if (simulate) {
+					for (i = 0; i < readers; i++)
+						card_sim_insert(sims[i], test.sim_card);
+				}
+				if (bench_measure(ctxs, readers, addrs, &test, iters, warmup, &res) != 0)
+					rc = 1;
+				fprintf(out, "%s\n    {\"test\": \"%s\", \"size\": %u, \"readers\": %d, \"ok\": %lu, \"errors\": %lu, "
+					"\"last_err\": %u, \"seconds\": %.6f, \"ops_per_sec\": %.1f, \"mean_us\": %.1f, \"min_us\": %lu, "
+					"\"p50_us\": %lu, \"p99_us\": %lu, \"p999_us\": %lu, \"max_us\": %lu}",
+					first ? "" : ",", test.name, test.size, readers, res.ok, res.err, res.last_err, res.seconds,
+					res.seconds > 0 ? (double)res.ok / res.seconds : 0.0, res.mean_us, (unsigned long)res.min_us,
+					(unsigned long)res.p50_us, (unsigned long)res.p99_us, (unsigned long)res.p999_us, (unsigned long)res.max_us);
+				first = 0;
+				fprintf(stderr, "%-13s %6u %4d %9.1f %7lu %8lu %8lu %8lu %8lu\n", test.name, test.size, readers,
+					res.seconds > 0 ? (double)res.ok / res.seconds : 0.0, res.err, (unsigned long)res.p50_us,
+					(unsigned long)res.p99_us, (unsigned long)res.p999_us, (unsigned long)res.max_us);
+				if (readers == max_readers)
+					break;
+			}
+		}
+	}
+	fprintf(out, "\n  ]\n}\n");
+
+	if (out != stdout)
+		fclose(out);
+	for (i = 0; i < max_readers; i++) {
+		if (sims[i] != NULL)
+			card_sim_destroy(sims[i]);
+		free(ctxs[i].tbuf);
+		free(ctxs[i].rbuf);
+		free(ctxs[i].lat);
+	}
+	return rc;
+}
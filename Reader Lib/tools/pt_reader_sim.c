@@ -0,0 +1,128 @@
+/**
+ * \file	pt_reader_sim.c
+ * \brief	读写器模拟器工具
+ * \details	在本机运行card_sim_create创建的读写器模拟器，直到收到中断信号，退出时输出已处理的命令个数。
+ * \code
+ *  pt_reader_sim [-a 地址] [-p 端口] [-c none|t0|t1|mifare|14443|i2c|spi|15693]
+ *                [-l 延时us] [-j 抖动us] [-b 每字节ns] [-e 概率ppm[:错误码]]
+ *                [-r CRC错误ppm] [-m 不应答ppm] [-d 断开ppm] [-s 种子]
+ * \endcode
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include "pt_card_ext.h"
+
+static const char *card_names[] = { "none", "t0", "t1", "mifare", "14443", "i2c", "spi", "15693" };
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-a addr] [-p port] [-c none|t0|t1|mifare|14443|i2c|spi|15693]\n"
+		"       [-l latency_us] [-j jitter_us] [-b byte_ns] [-e err_ppm[:code]]\n"
+		"       [-r crc_ppm] [-m mute_ppm] [-d drop_ppm] [-s seed]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	card_sim_t *sim;
+	card_sim_cfg_t cfg;
+	card_sim_card_t card = CARD_SIM_7816_T0;
+	char *addr = NULL, *opt, *end;
+	unsigned long v;
+	card_err_t ret;
+	int i, j;
+#ifndef _WIN32
+	struct timespec ts;
+
+	ts.tv_sec = 0;
+	ts.tv_nsec = 100000000L;
+#endif
+
+	memset(&cfg, 0, sizeof(cfg));
+	for (i = 1; i < argc; i++) {
+		opt = argv[i];
+		if (opt[0] != '-' || opt[1] == '\0' || opt[2] != '\0' || i + 1 >= argc) {
+			usage(argv[0]);
+			return 1;
+		}
+		i++;
+		if (opt[1] == 'a') {
+			addr = argv[i];
+			continue;
+		}
+		if (opt[1] == 'c') {
+			for (j = 0; j < (int)(sizeof(card_names) / sizeof(card_names[0])); j++) {
+				if (strcmp(argv[i], card_names[j]) == 0)
+					break;
+			}
+			if (j == (int)(sizeof(card_names) / sizeof(card_names[0]))) {
+				fprintf(stderr, "unknown card %s\n", argv[i]);
+				return 1;
+			}
+			card = (card_sim_card_t)j;
+			continue;
+		}
+
+		v = strtoul(argv[i], &end, 0);
+		if (end == argv[i] || (*end != '\0' && !(opt[1] == 'e' && *end == ':'))) {
+			usage(argv[0]);
+			return 1;
+		}
+		switch (opt[1]) {
+		case 'p': cfg.port = (Uint16_t)v; break;
+		case 'l': cfg.latency_us = (Uint32_t)v; break;
+		case 'j': cfg.jitter_us = (Uint32_t)v; break;
+		case 'b': cfg.byte_ns = (Uint32_t)v; break;
+		case 'e':
+			cfg.err_ppm = (Uint32_t)v;
+			if (*end == ':')
+				cfg.err_code = (card_err_t)strtoul(end + 1, NULL, 16);
+			break;
+		case 'r': cfg.crc_ppm = (Uint32_t)v; break;
+		case 'm': cfg.mute_ppm = (Uint32_t)v; break;
+		case 'd': cfg.drop_ppm = (Uint32_t)v; break;
+		case 's': cfg.seed = (Uint32_t)v; break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	ret = card_sim_create(&sim, (Uint8_t *)addr, &cfg);
+	if (ret != CARD_NO_ERR) {
+		fprintf(stderr, "create simulator failed, ErrCode=%04X\n", ret);
+		return 1;
+	}
+	card_sim_insert(sim, card);
+	printf("listening on %s:%u, card %s\n", addr != NULL ? addr : "127.0.0.1",
+		cfg.port != 0 ? cfg.port : CARD_SIM_PORT, card_names[card]);
+	fflush(stdout);
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	while (!stop) {
+#ifdef _WIN32
+		Sleep(100);
+#else
+		nanosleep(&ts, NULL);
+#endif
+	}
+
+	printf("%lu commands\n", (unsigned long)card_sim_count(sim));
+	card_sim_destroy(sim);
+	return 0;
+}
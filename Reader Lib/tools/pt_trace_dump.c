@@ -0,0 +1,121 @@
+/**
+ * \file	pt_trace_dump.c
+ * \brief	跟踪文件转换工具
+ * \details	将card_trace_create生成的二进制跟踪文件转换为与驱动库通信日志相同格式的文本。
+ * \code
+ *  pt_trace_dump 跟踪文件 [输出文件]
+ * \endcode
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "pt_card_ext.h"
+
+static const char *cmd_names[CARD_CMD_MAX] = {
+	"card_other",
+	"card_pipe",
+	"card_reset",
+	"card_warm_reset",
+	"card_off",
+	"card_reqa",
+	"card_wupa",
+	"card_anticol",
+	"card_select",
+	"card_rats",
+	"card_mifare_read",
+	"card_mifare_write",
+	"card_i2c_write_read",
+	"card_spi_write_read",
+	"card_swd_dap_read",
+	"card_swd_dap_write",
+	"ea_card_runpre",
+};
+
+static unsigned long long get_le(const Uint8_t *p, int n)
+{
+	unsigned long long v = 0;
+	int i;
+
+	for (i = n - 1; i >= 0; i--)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+static void dump_record(FILE *out, const Uint8_t *hdr, const Uint8_t *data)
+{
+	unsigned long long time_us = get_le(hdr, 8);
+	Int32_t handle = (Int32_t)get_le(hdr + 8, 4);
+	char addr[MAX_ADDR_SIZE + 1];
+	Uint8_t cmd = hdr[28];
+	Uint8_t dir = hdr[29];
+	card_err_t err = (card_err_t)get_le(hdr + 30, 2);
+	Uint16_t len = (Uint16_t)get_le(hdr + 32, 2);
+	Uint16_t data_len = (Uint16_t)get_le(hdr + 34, 2);
+	time_t sec = (time_t)(time_us / 1000000ULL);
+	char stamp[32];
+	Uint16_t i;
+
+	memcpy(addr, hdr + 12, MAX_ADDR_SIZE);
+	addr[MAX_ADDR_SIZE] = '\0';
+	strftime(stamp, sizeof(stamp), "%Y/%m/%d %X", localtime(&sec));
+
+	fprintf(out, "%s.%06lu|%s|[%s][%s]", stamp, (unsigned long)(time_us % 1000000ULL),
+		err != CARD_NO_ERR ? "ERROR" : "INFO", addr, cmd < CARD_CMD_MAX ? cmd_names[cmd] : cmd_names[0]);
+	if (dir == CARD_TRACE_DIR_TX)
+		fprintf(out, "handle=%ld, tx_len=%u, tx_data=", (long)handle, len);
+	else
+		fprintf(out, "ErrCode=%02x, rx_len=%u, rx_data=", err, len);
+	for (i = 0; i < data_len; i++)
+		fprintf(out, "%02X", data[i]);
+	if (data_len < len)
+		fputs("...", out);
+	fputc('\n', out);
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *in, *out = stdout;
+	Uint8_t hdr[CARD_TRACE_RECORD_HEAD];
+	Uint8_t data[CARD_TRACE_DATA_MAX];
+	Uint16_t data_len;
+	unsigned long count = 0;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s trace_file [output_file]\n", argv[0]);
+		return 1;
+	}
+	in = fopen(argv[1], "rb");
+	if (in == NULL) {
+		fprintf(stderr, "open %s failed\n", argv[1]);
+		return 1;
+	}
+	if (fread(hdr, 1, CARD_TRACE_FILE_HEAD, in) != CARD_TRACE_FILE_HEAD
+		|| get_le(hdr, 4) != CARD_TRACE_MAGIC || get_le(hdr + 4, 2) != CARD_TRACE_VERSION) {
+		fprintf(stderr, "%s is not a trace file\n", argv[1]);
+		fclose(in);
+		return 1;
+	}
+	if (argc > 2) {
+		out = fopen(argv[2], "w");
+		if (out == NULL) {
+			fprintf(stderr, "open %s failed\n", argv[2]);
+			fclose(in);
+			return 1;
+		}
+	}
+
+	while (fread(hdr, 1, sizeof(hdr), in) == sizeof(hdr)) {
+		data_len = (Uint16_t)get_le(hdr + 34, 2);
+		if (data_len > CARD_TRACE_DATA_MAX || fread(data, 1, data_len, in) != data_len) {
+			fprintf(stderr, "truncated record %lu\n", count);
+			break;
+		}
+		dump_record(out, hdr, data);
+		count++;
+	}
+
+	fclose(in);
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}